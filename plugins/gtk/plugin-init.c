@@ -42,7 +42,7 @@ EXPORT void syx_g_closure_marshal (GClosure *closure,
                                    gpointer invocation_hint,
                                    gpointer marshal_data)
 {
-  syx_memory_gc_begin ();
+  SyxMemoryHandleScope scope = syx_memory_handle_scope_open ();
   SyxOop array = syx_array_new_size (n_param_values);
   SyxOop context;
   SyxOop callback = (SyxOop) closure->data;
@@ -110,7 +110,7 @@ EXPORT void syx_g_closure_marshal (GClosure *closure,
   context = syx_send_binary_message (callback, "invoke:", array);
   syx_interp_enter_context (_syx_gtk_process, context);
   syx_semaphore_signal (_syx_gtk_semaphore);
-  syx_memory_gc_end ();
+  syx_memory_handle_scope_close (scope);
 
   while (syx_scheduler_iterate () && SYX_IS_FALSE (SYX_PROCESS_SUSPENDED (_syx_gtk_process)));
 
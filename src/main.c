@@ -46,7 +46,29 @@ _help (void)
   printf ("  -c\t\t\tContinue startup process after loading files\n"
           "\t\t\tor evaluating code.\n\n"
           "  -e CODE\t\tEvaluate one line of code.\n"
-          "  --recovery=IMAGEFILE\tLoad the default image and save the recovered copy\n"
+          "  --gc-pause=USECS\tCollect garbage incrementally, pausing at most\n"
+          "\t\t\tUSECS microseconds at once.\n");
+
+  printf ("  --heap-max=OBJECTS\tLet the object memory grow up to OBJECTS objects.\n"
+          "  --heap-grow=PERCENT\tGrow the object memory when more than PERCENT\n"
+          "\t\t\tof it is used after a collection (default: 75).\n"
+          "  --heap-shrink=PERCENT\tShrink the object memory when less than PERCENT\n"
+          "\t\t\tof it is used after a collection (default: 20).\n"
+          "  --gc-log=FILE\t\tAppend a line to FILE for each garbage collection.\n");
+
+  printf ("  --image-format=FORMAT\tSave images in the portable format, loadable\n"
+          "\t\t\tby any host (default), or in the mapped format,\n"
+          "\t\t\tfaster to load by hosts of the same kind.\n"
+          "  --export=IMAGEFILE\tLoad the image and save a copy of it to IMAGEFILE\n"
+          "\t\t\tin the format given by --image-format.\n"
+          "  --compact\t\tLoad the image and save it again, folding the deltas\n"
+          "\t\t\tappended by ObjectMemory deltaSnapshot into it.\n");
+
+  printf ("  --sources=FILE\tMove the source code of the methods into FILE\n"
+          "\t\t\tand save the image, built from scratch or loaded,\n"
+          "\t\t\twhich gets smaller and faster to load.\n");
+
+  printf ("  --recovery=IMAGEFILE\tLoad the default image and save the recovered copy\n"
 	  "\t\t\tof it to IMAGEFILE.\n\n"
 	  "  -v --version\t\tPrint version information and then exit.\n"
 	  "  -h --help\t\tPrint this message.\n\n"
@@ -95,7 +117,16 @@ enum OptArgument
   ARG_VERSION,
   ARG_RECOVERY,
   ARG_HELP,
-  ARG_CONTINUE_STARTUP
+  ARG_CONTINUE_STARTUP,
+  ARG_GC_PAUSE,
+  ARG_HEAP_MAX,
+  ARG_HEAP_GROW,
+  ARG_HEAP_SHRINK,
+  ARG_GC_LOG,
+  ARG_IMAGE_FORMAT,
+  ARG_EXPORT,
+  ARG_COMPACT,
+  ARG_SOURCES
 };
 
 struct
@@ -105,11 +136,20 @@ struct
   int need_param;
 } arg_defs[] = {
   {"--root", ARG_ROOT, TRUE},
+  {"--image-format", ARG_IMAGE_FORMAT, TRUE},
   {"--image", ARG_IMAGE, TRUE},
   {"--scratch", ARG_SCRATCH, 0},
   {"--version", ARG_VERSION, 0},
   {"--recovery", ARG_RECOVERY, TRUE},
   {"--help", ARG_HELP, 0},
+  {"--gc-pause", ARG_GC_PAUSE, TRUE},
+  {"--heap-max", ARG_HEAP_MAX, TRUE},
+  {"--heap-grow", ARG_HEAP_GROW, TRUE},
+  {"--heap-shrink", ARG_HEAP_SHRINK, TRUE},
+  {"--gc-log", ARG_GC_LOG, TRUE},
+  {"--export", ARG_EXPORT, TRUE},
+  {"--compact", ARG_COMPACT, 0},
+  {"--sources", ARG_SOURCES, TRUE},
   {"-r", ARG_ROOT, TRUE},
   {"-i", ARG_IMAGE, TRUE},
   {"-s", ARG_SCRATCH, 0},
@@ -173,8 +213,11 @@ _parse_args (int argc, char **argv)
   syx_string root_path = NULL;
   syx_string image_path = NULL;
   syx_symbol recovery = NULL;
+  syx_symbol export_path = NULL;
+  syx_symbol sources_path = NULL;
   syx_bool scratch = FALSE;
   syx_bool quit = FALSE;
+  syx_bool compact = FALSE;
 
   while (curr_arg < argc)
     {
@@ -200,6 +243,62 @@ _parse_args (int argc, char **argv)
 	case ARG_RECOVERY:
 	  recovery = arg_val;
 	  break;
+	case ARG_GC_PAUSE:
+	  if (atoi (arg_val) <= 0)
+	    {
+	      _help ();
+	      exit (EXIT_FAILURE);
+	    }
+	  syx_memory_gc_set_incremental (TRUE);
+	  syx_memory_gc_set_pause_budget (atoi (arg_val));
+	  break;
+	case ARG_HEAP_MAX:
+	  if (atoi (arg_val) <= 0)
+	    {
+	      _help ();
+	      exit (EXIT_FAILURE);
+	    }
+	  syx_memory_set_max_size (atoi (arg_val));
+	  break;
+	case ARG_HEAP_GROW:
+	case ARG_HEAP_SHRINK:
+	  if (atoi (arg_val) < 0 || atoi (arg_val) > 100)
+	    {
+	      _help ();
+	      exit (EXIT_FAILURE);
+	    }
+	  if (arg_enum == ARG_HEAP_GROW)
+	    syx_memory_set_grow_threshold (atoi (arg_val));
+	  else
+	    syx_memory_set_shrink_threshold (atoi (arg_val));
+	  break;
+	case ARG_GC_LOG:
+	  if (!syx_memory_set_log (arg_val))
+	    {
+	      printf ("Can't open %s for logging.\n", arg_val);
+	      exit (EXIT_FAILURE);
+	    }
+	  break;
+	case ARG_IMAGE_FORMAT:
+	  if (!strcmp (arg_val, "portable"))
+	    syx_memory_set_image_format (SYX_MEMORY_IMAGE_PORTABLE);
+	  else if (!strcmp (arg_val, "mapped"))
+	    syx_memory_set_image_format (SYX_MEMORY_IMAGE_MAPPED);
+	  else
+	    {
+	      _help ();
+	      exit (EXIT_FAILURE);
+	    }
+	  break;
+	case ARG_EXPORT:
+	  export_path = arg_val;
+	  break;
+	case ARG_COMPACT:
+	  compact = TRUE;
+	  break;
+	case ARG_SOURCES:
+	  sources_path = arg_val;
+	  break;
 	case ARG_ERROR:
 	case ARG_HELP:
 	  _help ();
@@ -232,6 +331,9 @@ _parse_args (int argc, char **argv)
     {
       syx_build_basic ();
 
+      if (sources_path && !syx_memory_externalize_sources (sources_path))
+        syx_warning ("Can't write the sources at %s\n", sources_path);
+
       if (!syx_memory_save_image (NULL))
         syx_warning ("Can't save the image\n");
 
@@ -251,6 +353,26 @@ _parse_args (int argc, char **argv)
       if (recovery)
         _do_recovery (recovery);
 
+      /* saving the image where it has been loaded from folds its deltas into it */
+      if (compact || (sources_path && !export_path))
+        export_path = syx_get_image_path ();
+
+      if (export_path)
+        {
+          if (sources_path && !syx_memory_externalize_sources (sources_path))
+            {
+              printf ("Can't write the sources at %s.\n", sources_path);
+              exit (EXIT_FAILURE);
+            }
+          if (!syx_memory_save_image (export_path))
+            {
+              printf ("Can't save the image at %s.\n", export_path);
+              exit (EXIT_FAILURE);
+            }
+          syx_quit ();
+          exit (EXIT_SUCCESS);
+        }
+
       /* Force WinWorkspace startup on WinCE */
 #ifdef WINCE
       SYX_OBJECT_VARS(syx_globals)[4] = syx_globals_at ("WinWorkspace");
@@ -47,17 +47,17 @@ syx_bytecode_new (void)
 }
 
 /*!
-  Contains common unary messages avoiding them to be inserted into method literals.
+  Contains unary messages that the interpreter can answer without a method lookup.
+  The order must match SyxBytecodeUnaryMessage.
 */
-syx_symbol syx_bytecode_unary_messages[] = {"isNil", "notNil", "value", "new", "class", "superclass",
-                                            "print", "printNl", "printString", "unity", NULL};
+syx_symbol syx_bytecode_unary_messages[] = {"isNil", "notNil", NULL};
 
 /*!
-  Same as syx_bytecode_unary_messages but contains binary messages and keyword messages with a single argument
+  Same as syx_bytecode_unary_messages but contains binary messages and keyword messages with a single argument.
+  The order must match SyxBytecodeBinaryMessage.
 */
-syx_symbol syx_bytecode_binary_messages[] = {"+", "-", "<", ">", "<=", ">=", "=", "~=", "at:",
-                                             "do:", "value:", "valueWithArguments:",
-                                             "new:", "to:", "basicAt:", NULL};
+syx_symbol syx_bytecode_binary_messages[] = {"+", "-", "<", ">", "<=", ">=", "=", "~=",
+                                             "*", "//", "\\\\", "bitAnd:", "==", NULL};
 
 /*!
   Manually generate an instruction.
@@ -88,7 +88,9 @@ syx_bytecode_gen_instruction (SyxBytecode *bytecode, syx_uint8 high, syx_uint16
   Generate a message instruction.
 
   If the message shouldn't be sent to super and the selector is known to be a common unary or binary message,
-  send SYX_BYTECODE_SEND_UNARY or SYX_BYTECODE_SEND_BINARY with its relative index into syx_bytecode_unary_messages or syx_bytecode_binary_messages.
+  send SYX_BYTECODE_SEND_UNARY or SYX_BYTECODE_SEND_BINARY. The argument holds the index of the message
+  into syx_bytecode_unary_messages or syx_bytecode_binary_messages in the lower SYX_BYTECODE_SPECIAL_MESSAGE_BITS,
+  and the index of the VariableBinding literal used when the message must be really sent.
 
   If it's a non-specific message, then specify the number of arguments with the SYX_BYTECODE_MARK_ARGUMENTS instruction and generate a SYX_BYTECODE_SEND_MESSAGE or SYX_BYTECODE_SEND_SUPER instruction.
 
@@ -100,48 +102,43 @@ void
 syx_bytecode_gen_message (SyxBytecode *bytecode, syx_bool to_super, syx_uint32 argument_count, syx_symbol selector)
 {
   SyxOop binding;
-  /*
-  syx_int16 i;
-  SyxOop selbinding;
-  if (!to_super)
+  syx_symbol *messages = NULL;
+  syx_uint8 command = 0;
+  syx_uint32 literal;
+  syx_int32 i;
+
+  binding = syx_variable_binding_new (syx_symbol_new (selector), 0, syx_nil);
+  literal = syx_bytecode_gen_literal (bytecode, binding);
+
+  if (!to_super && argument_count == 0)
+    {
+      messages = syx_bytecode_unary_messages;
+      command = SYX_BYTECODE_SEND_UNARY;
+    }
+  else if (!to_super && argument_count == 1)
+    {
+      messages = syx_bytecode_binary_messages;
+      command = SYX_BYTECODE_SEND_BINARY;
+    }
+
+  if (messages && literal <= (SYX_BYTECODE_MAX >> SYX_BYTECODE_SPECIAL_MESSAGE_BITS))
     {
-      for (i=0; syx_bytecode_unary_messages[i]; i++)
+      for (i=0; messages[i]; i++)
         {
-          if (!strcmp (syx_bytecode_unary_messages[i], selector))
+          if (!strcmp (messages[i], selector))
             {
-              binding = syx_variable_binding_new (syx_symbol_new (selector), 0, syx_nil);
-              selbinding = syx_object_new (syx_globals_at ("Association"));
-              SYX_ASSOCIATION_KEY (selbinding) = syx_small_integer_new (i);
-              SYX_ASSOCIATION_VALUE (selbinding) = binding;
-              syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_UNARY,
-                                            syx_bytecode_gen_literal (bytecode, selbinding));
+              syx_bytecode_gen_instruction (bytecode, command,
+                                            (literal << SYX_BYTECODE_SPECIAL_MESSAGE_BITS) + i);
               return;
             }
         }
-      
-      for (i=0; syx_bytecode_binary_messages[i]; i++)
-        {
-          if (!strcmp (syx_bytecode_binary_messages[i], selector))
-            {
-              binding = syx_variable_binding_new (syx_symbol_new (selector), 0, syx_nil);
-              selbinding = syx_object_new (syx_globals_at ("Association"));
-              SYX_ASSOCIATION_KEY (selbinding) = syx_small_integer_new (i);
-              SYX_ASSOCIATION_VALUE (selbinding) = binding;
-              syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_BINARY,
-                                            syx_bytecode_gen_literal (bytecode, selbinding));
-              return;
-            }
-        } 
     }
-  */
-  binding = syx_variable_binding_new (syx_symbol_new (selector), 0, syx_nil);
+
   syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_MARK_ARGUMENTS, argument_count);
   if (to_super)
-    syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_SUPER,
-                                  syx_bytecode_gen_literal (bytecode, binding));
+    syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_SUPER, literal);
   else
-    syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_MESSAGE,
-                                  syx_bytecode_gen_literal (bytecode, binding));
+    syx_bytecode_gen_instruction (bytecode, SYX_BYTECODE_SEND_MESSAGE, literal);
 }
 
 /*!
@@ -168,3 +165,98 @@ syx_bytecode_gen_literal (SyxBytecode *bytecode, SyxOop literal)
   bytecode->literals[bytecode->literals_top++] = literal;
   return bytecode->literals_top - 1;
 }
+
+/*!
+  Does SYX_BYTECODE_DUPLICATE at a given code array position.
+
+  This operation moves the code by 1 entry on the right, increases the code_top and the stack_size.
+  Branches in the moved code are relocated.
+
+  \param index the position of the new instruction
+*/
+void
+syx_bytecode_duplicate_at (SyxBytecode *bytecode, syx_int32 index)
+{
+  syx_uint16 instruction = (SYX_BYTECODE_DO_SPECIAL << SYX_BYTECODE_ARGUMENT_BITS) + SYX_BYTECODE_DUPLICATE;
+  syx_uint16 byte, command, argument, jump;
+  syx_int32 i;
+
+  memmove (bytecode->code + index + 1, bytecode->code + index,
+           (bytecode->code_top - index) * sizeof (syx_uint16));
+  bytecode->code[index] = SYX_COMPAT_SWAP_16 (instruction);
+  bytecode->code_top++;
+  bytecode->stack_size++;
+
+  for (i=index + 1; i < bytecode->code_top; i++)
+    {
+      byte = SYX_COMPAT_SWAP_16 (bytecode->code[i]);
+      command = byte >> SYX_BYTECODE_ARGUMENT_BITS;
+      argument = byte & SYX_BYTECODE_ARGUMENT_MASK;
+
+      if (command == SYX_BYTECODE_EXTENDED)
+        i++;
+      else if (command == SYX_BYTECODE_DO_SPECIAL
+               && (argument == SYX_BYTECODE_BRANCH
+                   || argument == SYX_BYTECODE_BRANCH_IF_TRUE
+                   || argument == SYX_BYTECODE_BRANCH_IF_FALSE
+                   || argument == SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN
+                   || argument == SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER))
+        {
+          i++;
+          jump = SYX_COMPAT_SWAP_16 (bytecode->code[i]);
+          /* a zero jump means no jump at all */
+          if (jump >= index && jump)
+            bytecode->code[i] = SYX_COMPAT_SWAP_16 (jump + 1);
+        }
+    }
+}
+
+/*!
+  Decode portable bytecodes into the native form executed by the interpreter.
+
+  Each decoded instruction is stored at the same index of its portable instruction.
+  The second word of wide instructions is never executed and holds the same decoded instruction.
+
+  \param code the portable 16-bit bytecodes
+  \param count the number of words in code
+  \param decoded an array of at least count words
+*/
+void
+syx_bytecode_decode (syx_uint16 *code, syx_varsize count, syx_uint32 *decoded)
+{
+  syx_varsize i;
+  syx_uint32 command, argument, flags;
+  syx_uint16 byte;
+
+  for (i=0; i < count; i++)
+    {
+      byte = SYX_COMPAT_SWAP_16 (code[i]);
+      command = byte >> SYX_BYTECODE_ARGUMENT_BITS;
+      argument = byte & SYX_BYTECODE_ARGUMENT_MASK;
+      flags = 0;
+
+      if (command == SYX_BYTECODE_EXTENDED && i + 1 < count)
+        {
+          command = argument;
+          argument = SYX_COMPAT_SWAP_16 (code[i + 1]);
+          flags = SYX_BYTECODE_DECODED_WIDE;
+        }
+      else if (command == SYX_BYTECODE_DO_SPECIAL && i + 1 < count
+               && (argument == SYX_BYTECODE_BRANCH
+                   || argument == SYX_BYTECODE_BRANCH_IF_TRUE
+                   || argument == SYX_BYTECODE_BRANCH_IF_FALSE
+                   || argument == SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN
+                   || argument == SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER))
+        {
+          argument += SYX_COMPAT_SWAP_16 (code[i + 1]) << SYX_BYTECODE_DECODED_SPECIAL_BITS;
+          flags = SYX_BYTECODE_DECODED_WIDE;
+        }
+
+      decoded[i] = (argument << SYX_BYTECODE_DECODED_ARGUMENT_SHIFT) | flags | command;
+      if (flags)
+        {
+          i++;
+          decoded[i] = decoded[i - 1];
+        }
+    }
+}
@@ -58,6 +58,42 @@ SYX_BEGIN_DECLS
 /*! A mask to be used with bit-wise AND to retrieve the command from a bytecode */
 #define SYX_BYTECODE_ARGUMENT_MASK (SYX_BYTECODE_ARGUMENT_MAX)
 
+/*! Bits of the argument of push and assign of arguments and temporaries used for the index of the variable
+  within its scope. The remaining bits hold the number of outer scopes to go through */
+#define SYX_BYTECODE_SCOPE_INDEX_BITS 8
+/*! A mask to be used with bit-wise AND to retrieve the index of the variable within its scope */
+#define SYX_BYTECODE_SCOPE_INDEX_MASK ((1 << SYX_BYTECODE_SCOPE_INDEX_BITS) - 1)
+
+/*! Bits of the argument of SYX_BYTECODE_SEND_UNARY and SYX_BYTECODE_SEND_BINARY
+  used for the index of the message. The remaining bits hold the index of the VariableBinding literal */
+#define SYX_BYTECODE_SPECIAL_MESSAGE_BITS 4
+/*! A mask to be used with bit-wise AND to retrieve the index of the message */
+#define SYX_BYTECODE_SPECIAL_MESSAGE_MASK ((1 << SYX_BYTECODE_SPECIAL_MESSAGE_BITS) - 1)
+
+/*
+  Decoded representation of a bytecode, as executed by the interpreter.
+  Every 16-bit word of the portable bytecodes has a native 32-bit word at the same index,
+  so that instruction pointers are valid for both the forms.
+  Command is b, w tells whether the instruction spans two words, argument is k.
+
+  kkkkkkkk kkkkkkkk kkkkkkkk 00wbbbbb
+
+  Extended instructions are decoded to their real command with the wide argument,
+  while branches hold the jump position in the argument beside the special operation.
+*/
+
+/*! A mask to be used with bit-wise AND to retrieve the command from a decoded bytecode */
+#define SYX_BYTECODE_DECODED_COMMAND_MASK SYX_BYTECODE_COMMAND_MAX
+/*! Set when the decoded instruction also took the next word of the portable bytecodes */
+#define SYX_BYTECODE_DECODED_WIDE (1 << SYX_BYTECODE_COMMAND_BITS)
+/*! Shift to retrieve the argument from a decoded bytecode */
+#define SYX_BYTECODE_DECODED_ARGUMENT_SHIFT 8
+/*! Bits of the argument of a decoded SYX_BYTECODE_DO_SPECIAL holding the special operation.
+  The remaining bits hold the jump position of branches */
+#define SYX_BYTECODE_DECODED_SPECIAL_BITS 4
+/*! A mask to be used with bit-wise AND to retrieve the special operation */
+#define SYX_BYTECODE_DECODED_SPECIAL_MASK ((1 << SYX_BYTECODE_DECODED_SPECIAL_BITS) - 1)
+
 extern syx_symbol syx_bytecode_unary_messages[];
 extern syx_symbol syx_bytecode_binary_messages[];
 
@@ -95,6 +131,8 @@ syx_bytecode_free (SyxBytecode *bytecode)
 EXPORT void syx_bytecode_gen_instruction (SyxBytecode *bytecode, syx_uint8 high, syx_uint16 low);
 EXPORT void syx_bytecode_gen_message (SyxBytecode *bytecode, syx_bool to_super, syx_uint32 argument_count, syx_symbol selector);
 EXPORT syx_uint32 syx_bytecode_gen_literal (SyxBytecode *bytecode, SyxOop literal);
+EXPORT void syx_bytecode_duplicate_at (SyxBytecode *bytecode, syx_int32 index);
+EXPORT void syx_bytecode_decode (syx_uint16 *code, syx_varsize count, syx_uint32 *decoded);
 
 /*! Puts the bytecode into the code array and increment the code top. It's automatically called from syx_bytecode_gen_instruction */
 SYX_FUNC_BYTECODE (gen_code, syx_uint16 value)
@@ -187,20 +225,6 @@ SYX_FUNC_BYTECODE (assign_binding_variable, SyxOop link)
 				syx_bytecode_gen_literal (bytecode, link));
 }
 
-/*!
-  Does SYX_BYTECODE_DUPLICATE at a given code array position.
-
-  This operation moves the code by 1 entry on the right, increases the code_top and the stack_size
-*/
-SYX_FUNC_BYTECODE (duplicate_at, syx_int32 index)
-{
-  syx_uint16 instruction = (SYX_BYTECODE_DO_SPECIAL << SYX_BYTECODE_ARGUMENT_BITS) + SYX_BYTECODE_DUPLICATE;
-  memmove (bytecode->code + index + 1, bytecode->code + index, SYX_BYTECODE_MAX - index);
-  bytecode->code[index] = SYX_COMPAT_SWAP_16 (instruction);
-  bytecode->code_top++;
-  bytecode->stack_size++;
-}
-
 /*! Does SYX_BYTECODE_POP_TOP */
 INLINE void
 syx_bytecode_pop_top (SyxBytecode *bytecode)
@@ -88,6 +88,7 @@ typedef enum
     SYX_VARS_CODE_STACK_SIZE,
     SYX_VARS_CODE_TEXT,
     SYX_VARS_CODE_CLASS,
+    SYX_VARS_CODE_DECODED_BYTECODES,
     SYX_VARS_CODE_ALL,
 
     SYX_VARS_METHOD_SELECTOR = SYX_VARS_CODE_ALL,
@@ -189,7 +190,11 @@ typedef enum
     SYX_BYTECODE_DUPLICATE,
     SYX_BYTECODE_BRANCH,
     SYX_BYTECODE_BRANCH_IF_TRUE,
-    SYX_BYTECODE_BRANCH_IF_FALSE
+    SYX_BYTECODE_BRANCH_IF_FALSE,
+    /* jump if the object on top of the stack is not a Boolean, leaving it there */
+    SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN,
+    /* jump if the object on top of the stack is not a SmallInteger, leaving it there */
+    SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER
   } SyxBytecodeSpecial;
 
 /*! Constants pushed by SYX_BYTECODE_PUSH_CONSTANT */
@@ -203,6 +208,46 @@ typedef enum
     SYX_BYTECODE_CONST_CONTEXT
   } SyxBytecodeConstant;
 
+/*! Unary messages sent by SYX_BYTECODE_SEND_UNARY. Must match syx_bytecode_unary_messages */
+typedef enum
+  {
+    SYX_BYTECODE_UNARY_IS_NIL,
+    SYX_BYTECODE_UNARY_NOT_NIL
+  } SyxBytecodeUnaryMessage;
+
+/*! Binary messages sent by SYX_BYTECODE_SEND_BINARY. Must match syx_bytecode_binary_messages */
+typedef enum
+  {
+    SYX_BYTECODE_BINARY_PLUS,
+    SYX_BYTECODE_BINARY_MINUS,
+    SYX_BYTECODE_BINARY_LT,
+    SYX_BYTECODE_BINARY_GT,
+    SYX_BYTECODE_BINARY_LE,
+    SYX_BYTECODE_BINARY_GE,
+    SYX_BYTECODE_BINARY_EQ,
+    SYX_BYTECODE_BINARY_NE,
+    SYX_BYTECODE_BINARY_MUL,
+    SYX_BYTECODE_BINARY_INT_DIV,
+    SYX_BYTECODE_BINARY_MOD,
+    SYX_BYTECODE_BINARY_BIT_AND,
+    SYX_BYTECODE_BINARY_IDENTITY
+  } SyxBytecodeBinaryMessage;
+
+/*! Kinds of methods that the interpreter answers without creating a frame */
+typedef enum
+  {
+    /*! Answer the receiver */
+    SYX_METHOD_QUICK_SELF,
+    /*! Answer a SyxBytecodeConstant */
+    SYX_METHOD_QUICK_CONSTANT,
+    /*! Answer a literal of the method */
+    SYX_METHOD_QUICK_LITERAL,
+    /*! Answer an instance variable of the receiver */
+    SYX_METHOD_QUICK_INSTANCE,
+    /*! Assign the argument to an instance variable and answer the receiver */
+    SYX_METHOD_QUICK_SETTER
+  } SyxMethodQuick;
+
 
 /*!
   Type of signals emitted in the Smalltalk environment.
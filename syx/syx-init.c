@@ -213,8 +213,9 @@ syx_build_basic (void)
 
   syx_globals = syx_dictionary_new (200);
   /* hold SystemDictionary instance variables */
-  syx_free (SYX_OBJECT_VARS(syx_globals));
-  SYX_OBJECT_VARS(syx_globals) = (SyxOop *) syx_calloc (SYX_VARS_DICTIONARY_ALL + 4, sizeof (SyxOop));
+  syx_object_free_body (syx_globals);
+  syx_object_alloc_body (syx_globals, SYX_VARS_DICTIONARY_ALL + 4, 400);
+  SYX_DICTIONARY_TALLY (syx_globals) = syx_small_integer_new (0);
 
   syx_symbols = syx_dictionary_new (1000);
   syx_globals_at_put (syx_symbol_new ("Smalltalk"), syx_globals);
@@ -249,9 +250,9 @@ syx_build_basic (void)
   _syx_file_in_basic_decl ();
 
   syx_object_set_class (syx_globals, syx_globals_at ("SystemDictionary"));
-  SYX_OBJECT(syx_nil)->klass = syx_globals_at ("UndefinedObject");
-  SYX_OBJECT(syx_true)->klass = syx_globals_at ("True");
-  SYX_OBJECT(syx_false)->klass = syx_globals_at ("False");
+  syx_object_set_class (syx_nil, syx_globals_at ("UndefinedObject"));
+  syx_object_set_class (syx_true, syx_globals_at ("True"));
+  syx_object_set_class (syx_false, syx_globals_at ("False"));
 
   syx_fetch_basic ();
   
@@ -292,7 +293,9 @@ syx_fetch_basic (void)
   syx_character_class = syx_globals_at ("Character");
   syx_byte_array_class = syx_globals_at ("ByteArray");
   syx_array_class = syx_globals_at ("Array");
+  syx_weak_array_class = syx_globals_at ("WeakArray");
   syx_variable_binding_class = syx_globals_at ("VariableBinding");
+  syx_ephemeron_class = syx_globals_at ("Ephemeron");
   syx_dictionary_class = syx_globals_at ("Dictionary");
   syx_cpointer_class = syx_globals_at ("CPointer");
 
@@ -25,6 +25,7 @@
 /*! \page syx_interpreter Syx Interpreter
 
   The stack pointer points to arguments, temporaries and the method local stack.
+  The arguments of a message are left where the sender pushed them, and the new frame starts right after.
   
   * When a context is needed from the Smalltalk-side (e.g. thisContext, Processor activeProcess context,
   context parent), a MethodContext or BlockContext is created on the fly, or returned the existing one.
@@ -43,6 +44,7 @@
 #include "syx-profile.h"
 
 #include <assert.h>
+#include <stddef.h>
 
 #ifdef SYX_DEBUG_FULL
 
@@ -52,16 +54,26 @@
 
 #endif /* SYX_DEBUG_FULL */
 
+/* Threaded dispatch skips the handlers of the most common instructions, so it can't trace them */
+#if defined(SYX_THREADED_DISPATCH) && !defined(SYX_DEBUG_BYTECODE) && !defined(SYX_DEBUG_TRACE_IP)
+#define SYX_INTERP_THREADED
+#endif
+
 #define _SYX_INTERP_IN_BLOCK (_syx_interp_state.frame->outer_frame != NULL)
 
 SyxInterpState _syx_interp_state = SYX_INTERP_STATE_NEW;
+syx_uint32 _syx_interp_quick_method_calls = 0;
 
 #ifdef SYX_DEBUG_CONTEXT
 syx_int32 _frame_depth;
 #endif
 
-static syx_uint16 _syx_interp_get_next_byte (void);
-static syx_bool _syx_interp_execute_byte (syx_uint16 byte);
+#ifdef SYX_INTERP_THREADED
+static void _syx_interp_execute_threaded (syx_bool scheduled);
+#else
+static syx_uint32 _syx_interp_get_next_byte (void);
+static syx_bool _syx_interp_execute_byte (syx_uint32 byte);
+#endif
 
 /*! Saves the current execution state into the active Process */
 void
@@ -81,10 +93,10 @@ _syx_interp_state_update (SyxInterpState *state, SyxInterpFrame *frame)
   state->frame = frame;
 
   bytecodes = SYX_CODE_BYTECODES (method);
-  state->arguments = &frame->local;
-  state->temporaries = state->arguments + SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (method));
+  state->arguments = frame->arguments;
+  state->temporaries = &frame->local;
   state->method_literals = SYX_OBJECT_DATA (SYX_CODE_LITERALS (method));
-  state->method_bytecodes = (syx_uint16 *)SYX_OBJECT_DATA (bytecodes);
+  state->method_bytecodes = syx_code_get_decoded (method);
   state->method_bytecodes_count = SYX_OBJECT_DATA_SIZE (bytecodes);
 }
 
@@ -112,11 +124,21 @@ _syx_interp_frame_prepare_new (SyxInterpState *state, SyxOop method)
 {
   SyxInterpFrame *frame;
   SyxInterpFrame *parent_frame;
+  SyxOop *arguments;
+  syx_int32 arguments_count;
   syx_int32 temporaries_count;
   
   parent_frame = state->frame;
-  /* we need the next position of our frame, the stack pointer is a good point in the process stack */
-  frame = (SyxInterpFrame *)parent_frame->stack;
+  /* we need the next position of our frame, the stack pointer is a good point in the process stack.
+     Skip the slot of the receiver, then the arguments are already there if they've been pushed by a send */
+  arguments = parent_frame->stack + 1;
+  arguments_count = SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (method));
+  if (state->message_arguments != arguments)
+    memmove (arguments, state->message_arguments, state->message_arguments_count * sizeof (SyxOop));
+  if (state->message_arguments_count < arguments_count)
+    memset (arguments + state->message_arguments_count, '\0',
+            (arguments_count - state->message_arguments_count) * sizeof (SyxOop));
+  frame = (SyxInterpFrame *)(arguments + arguments_count);
 
 #ifdef SYX_DEBUG_CONTEXT
   syx_debug ("CONTEXT - New frame %p - Depth: %d\n", frame, ++_frame_depth);
@@ -130,14 +152,13 @@ _syx_interp_frame_prepare_new (SyxInterpState *state, SyxOop method)
   frame->method = method;
   frame->closure = syx_nil;
   frame->next_instruction = 0;
+  frame->arguments = arguments;
 
   _syx_interp_state_update (state, frame);
 
   temporaries_count = SYX_SMALL_INTEGER (SYX_CODE_TEMPORARIES_COUNT (method));
   frame->stack = state->temporaries + temporaries_count;
   frame->receiver = state->message_receiver;
-  memcpy (state->arguments, state->message_arguments,
-          state->message_arguments_count * sizeof (SyxOop));
   memset (state->temporaries, '\0', temporaries_count * sizeof (SyxOop));
 }
 
@@ -160,6 +181,33 @@ _syx_interp_frame_prepare_new_closure (SyxInterpState *state, SyxOop closure)
     frame->stack_return_frame = frame->outer_frame->stack_return_frame;
 }
 
+/*!
+  Create the outer frame shared by the clean blocks of a method.
+
+  Clean blocks don't refer to the receiver nor to any outer variable,
+  so the frame has no arguments and temporaries and can't be returned to.
+  It has no receiver either, tracebacks take the class from the method instead.
+
+  \param method the CompiledMethod containing the blocks
+  \return an Array holding the frame
+*/
+SyxOop
+syx_interp_clean_frame_new (SyxOop method)
+{
+  SyxInterpFrame *frame;
+  SyxOop frame_oop;
+
+  frame_oop = syx_array_new_size (offsetof (SyxInterpFrame, local) / sizeof (SyxOop));
+  frame = (SyxInterpFrame *)SYX_OBJECT_DATA (frame_oop);
+  frame->this_context = syx_nil;
+  frame->detached_frame = frame_oop;
+  frame->method = method;
+  frame->closure = syx_nil;
+  frame->arguments = &frame->local;
+  frame->receiver = syx_nil;
+  return frame_oop;
+}
+
 /*! Returns the frame associated to the given context */
 SyxInterpFrame *
 syx_interp_context_to_frame (SyxOop context)
@@ -180,6 +228,7 @@ syx_interp_frame_to_context (SyxOop stack, SyxInterpFrame *frame)
 {
   SyxOop context;
   SyxOop arguments;
+  SyxMemoryHandleScope scope;
 
   if (!frame)
     return syx_nil;
@@ -187,7 +236,7 @@ syx_interp_frame_to_context (SyxOop stack, SyxInterpFrame *frame)
   if (!SYX_IS_NIL (frame->this_context))
     return frame->this_context; 
   
-  syx_memory_gc_begin ();
+  scope = syx_memory_handle_scope_open ();
   /* FIXME: they're not accessible for GC troubles.
      Do we need to access them with primitives or do we need to detach the frame when
      created using enter_context? */
@@ -205,7 +254,9 @@ syx_interp_frame_to_context (SyxOop stack, SyxInterpFrame *frame)
     }
   SYX_CONTEXT_PART_FRAME_POINTER (context) = SYX_POINTER_CAST_OOP (frame);
   frame->this_context = context;
-  syx_memory_gc_end ();
+  if (!SYX_IS_NIL (frame->detached_frame))
+    syx_memory_write_barrier (frame->detached_frame, context);
+  syx_memory_handle_scope_close (scope);
 
   return context;
 }
@@ -298,7 +349,7 @@ syx_interp_enter_context (SyxOop process, SyxOop context)
   else
     {
       state->message_arguments_count = SYX_OBJECT_DATA_SIZE (arguments);
-      memcpy (state->message_arguments, SYX_OBJECT_DATA (arguments), state->message_arguments_count * sizeof (SyxOop));
+      state->message_arguments = SYX_OBJECT_DATA (arguments);
     }
 
   if (SYX_OOP_EQ (syx_object_get_class (context), syx_block_context_class))
@@ -336,6 +387,7 @@ syx_interp_leave_and_answer (SyxOop return_object, syx_bool use_stack_return)
   SyxInterpFrame *return_frame = (use_stack_return
                                   ? _syx_interp_state.frame->stack_return_frame
                                   : _syx_interp_state.frame->parent_frame);
+  SyxInterpFrame *frame;
 
 #ifdef SYX_DEBUG_CONTEXT
   syx_debug ("CONTEXT - Leave frame %p for %p - Depth: %d - %s\n", _syx_interp_state.frame, return_frame, --_frame_depth,
@@ -349,6 +401,12 @@ syx_interp_leave_and_answer (SyxOop return_object, syx_bool use_stack_return)
   _syx_interp_state.frame = return_frame;
   if (!return_frame)
     {
+      /* The process is terminated, reset its stack like a new process.
+         The garbage collector must not walk frames that have been left */
+      frame = (SyxInterpFrame *) SYX_OBJECT_DATA (SYX_PROCESS_STACK (_syx_interp_state.process));
+      memset (frame, '\0', sizeof (SyxInterpFrame));
+      frame->stack = (SyxOop *) frame;
+      SYX_PROCESS_FRAME_POINTER(_syx_interp_state.process) = SYX_POINTER_CAST_OOP (frame);
       syx_scheduler_remove_process (syx_processor_active_process);
       return FALSE;
     }
@@ -367,10 +425,15 @@ syx_interp_leave_and_answer (SyxOop return_object, syx_bool use_stack_return)
 void
 syx_process_execute_scheduled (SyxOop process)
 {
-  syx_uint16 byte;
+#ifndef SYX_INTERP_THREADED
+  syx_uint32 byte;
+#endif
 
   _syx_interp_switch_process (&_syx_interp_state, process);
 
+#ifdef SYX_INTERP_THREADED
+  _syx_interp_execute_threaded (TRUE);
+#else
   while (_syx_interp_state.frame && _syx_interp_state.byteslice >= 0)
     {
       byte = _syx_interp_get_next_byte ();
@@ -379,6 +442,7 @@ syx_process_execute_scheduled (SyxOop process)
         break;
       _syx_interp_state.byteslice--;
     }
+#endif
 
   _syx_interp_save_process_state (&_syx_interp_state);
 }
@@ -391,7 +455,9 @@ syx_process_execute_blocking (SyxOop process)
 {
   SyxInterpState orig_state;
   SyxOop orig_process;
-  syx_uint16 byte;
+#ifndef SYX_INTERP_THREADED
+  syx_uint32 byte;
+#endif
 
   SYX_START_PROFILE;
 
@@ -409,11 +475,15 @@ syx_process_execute_blocking (SyxOop process)
 
   syx_processor_active_process = process;
 
+#ifdef SYX_INTERP_THREADED
+  _syx_interp_execute_threaded (FALSE);
+#else
   while (_syx_interp_state.frame)
     {
       byte = _syx_interp_get_next_byte ();
       _syx_interp_execute_byte (byte);
     }
+#endif
   _syx_interp_save_process_state (&_syx_interp_state);
 
   syx_processor_active_process = orig_process;
@@ -427,6 +497,7 @@ syx_process_execute_blocking (SyxOop process)
 
 /* Bytecode intepreter */
 
+#ifndef SYX_INTERP_THREADED
 static SyxInterpreterFunc handlers[] =
   {
     syx_interp_push_instance,
@@ -451,45 +522,56 @@ static SyxInterpreterFunc handlers[] =
     syx_interp_do_special,
     syx_interp_do_extended
   };
+#endif /* !SYX_INTERP_THREADED */
 
+/* The address created by the parser holds the number of outer frames to go through
+   and the index of the argument within the frame, look at SYX_BYTECODE_SCOPE_INDEX_BITS */
 static SyxOop *
-_syx_interp_find_argument (syx_uint16 argument)
+_syx_interp_find_argument (syx_uint32 argument)
 {
   SyxInterpFrame *frame = _syx_interp_state.frame;
-  /* The argument index created by the parser is the totally index of all outer arguments.
-     So we need to find the right scope by looping trough outer frames and their arguments. */
-  while (frame)
-    {
-      syx_int32 count = SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (frame->method));
-      if (count > argument)
-        return ((SyxOop *)&frame->local) + argument;
-      argument -= count;
-      frame = frame->outer_frame;
-    }
-  
-  /* this shouldn't be reached, maybe a parser fault? */
-  assert (FALSE);
-  return NULL;
+  syx_uint32 depth = argument >> SYX_BYTECODE_SCOPE_INDEX_BITS;
+
+  if (!depth)
+    return _syx_interp_state.arguments + argument;
+
+  while (depth--)
+    frame = frame->outer_frame;
+
+  return frame->arguments + (argument & SYX_BYTECODE_SCOPE_INDEX_MASK);
 }
 
+/* Same as _syx_interp_find_argument, but temporaries are placed right after the frame */
 static SyxOop *
-_syx_interp_find_temporary (syx_uint16 temporary)
+_syx_interp_find_temporary (syx_uint32 temporary)
 {
   SyxInterpFrame *frame = _syx_interp_state.frame;
-  /* The temporary index created by the parser is the totally index of all outer temporaries.
-     So we need to find the right scope by looping trough outer frames and their arguments. */
-  while (frame)
-    {
-      syx_int32 count = SYX_SMALL_INTEGER (SYX_CODE_TEMPORARIES_COUNT (frame->method));
-      if (count > temporary)
-        return ((SyxOop *)&frame->local + SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (frame->method))) + temporary;
-      temporary -= count;
-      frame = frame->outer_frame;
-    }
+  syx_uint32 depth = temporary >> SYX_BYTECODE_SCOPE_INDEX_BITS;
+
+  if (!depth)
+    return _syx_interp_state.temporaries + temporary;
+
+  while (depth--)
+    frame = frame->outer_frame;
+
+  return &frame->local + (temporary & SYX_BYTECODE_SCOPE_INDEX_MASK);
+}
+
+/* Store into a temporary. Frames referred by blocks are detached into objects which might be old,
+   and the blocks can still write into them once the frame has returned */
+static void
+_syx_interp_store_temporary (syx_uint32 temporary, SyxOop value)
+{
+  SyxInterpFrame *frame = _syx_interp_state.frame;
+  syx_uint32 depth = temporary >> SYX_BYTECODE_SCOPE_INDEX_BITS;
+
+  *(_syx_interp_find_temporary (temporary)) = value;
 
-  /* this shouldn't be reached, maybe a parser fault? */
-  assert (FALSE);
-  return NULL;
+  while (depth--)
+    frame = frame->outer_frame;
+
+  if (!SYX_IS_NIL (frame->detached_frame))
+    syx_memory_write_barrier (frame->detached_frame, value);
 }
 
 SYX_FUNC_INTERPRETER (syx_interp_push_instance)
@@ -604,6 +686,7 @@ SYX_FUNC_INTERPRETER (syx_interp_assign_instance)
   syx_debug ("BYTECODE - Assign instance at %d\n", argument);
 #endif
   SYX_OBJECT_VARS(_syx_interp_state.frame->receiver)[argument] = syx_interp_stack_peek ();
+  syx_memory_write_barrier (_syx_interp_state.frame->receiver, syx_interp_stack_peek ());
   return TRUE;
 }
 
@@ -612,7 +695,7 @@ SYX_FUNC_INTERPRETER (syx_interp_assign_temporary)
 #ifdef SYX_DEBUG_BYTECODE
   syx_debug ("BYTECODE - Assign temporary at %d\n", argument);
 #endif
-  *(_syx_interp_find_temporary (argument)) = syx_interp_stack_peek ();
+  _syx_interp_store_temporary (argument, syx_interp_stack_peek ());
   return TRUE;
 }
 
@@ -640,11 +723,12 @@ SYX_FUNC_INTERPRETER (syx_interp_mark_arguments)
   syx_debug ("BYTECODE - Mark arguments %d + receiver\n", argument);
 #endif
 
+  syx_memory_gc_young_safepoint ();
+
+  /* Arguments are left into the stack, the new frame will be built around them */
   _syx_interp_state.message_arguments_count = argument;
   _syx_interp_state.frame->stack -= argument;
-  memcpy (_syx_interp_state.message_arguments,
-          _syx_interp_state.frame->stack,
-          argument * sizeof(SyxOop));
+  _syx_interp_state.message_arguments = _syx_interp_state.frame->stack;
 
   _syx_interp_state.message_receiver = syx_interp_stack_pop ();
   _syx_interp_state.byteslice++; /* be sure we send the message */
@@ -652,6 +736,124 @@ SYX_FUNC_INTERPRETER (syx_interp_mark_arguments)
   return TRUE;
 }
 
+/* Fill the inline cache of a send site, see _syx_interp_lookup_send_site */
+static SyxOop
+_syx_interp_fill_send_site (SyxOop klass, SyxOop binding)
+{
+  SyxOop *cache;
+  SyxOop method;
+  syx_varsize i;
+
+  cache = SYX_OBJECT_DATA (binding);
+  if (SYX_OBJECT_DATA_SIZE (binding) == SYX_INLINE_CACHE_SIZE)
+    {
+      if (SYX_IS_TRUE (cache[0]))
+        return syx_class_lookup_method_binding (klass, binding);
+    }
+  else
+    {
+      SYX_OBJECT_HAS_REFS (binding) = TRUE;
+      syx_object_resize (binding, SYX_INLINE_CACHE_SIZE);
+      cache = SYX_OBJECT_DATA (binding);
+      for (i=0; i < SYX_INLINE_CACHE_SIZE; i++)
+        cache[i] = syx_nil;
+    }
+
+  for (i=1; i < SYX_INLINE_CACHE_SIZE && !SYX_IS_NIL (cache[i]); i += 2)
+    {
+      if (cache[i] == klass)
+        return cache[i+1];
+    }
+
+  method = syx_class_lookup_method_binding (klass, binding);
+  if (SYX_IS_NIL (method))
+    return method;
+
+  if (i < SYX_INLINE_CACHE_SIZE)
+    {
+      cache[i] = klass;
+      cache[i+1] = method;
+      syx_memory_write_barrier (binding, klass);
+      syx_memory_write_barrier (binding, method);
+    }
+  else
+    cache[0] = syx_true;
+
+  return method;
+}
+
+/*
+  Lookup a method using the inline cache of a send site.
+
+  The cache lives in the indexed slots of the VariableBinding literal of the send:
+  the first slot is true if the site is megamorphic, the others hold pairs of receiver class and method.
+  syx_method_cache_invalidate clears the caches of all send sites.
+  A site starts monomorphic, becomes polymorphic when it sees more classes, and falls back
+  to the global method cache once all the entries have been used.
+
+  Caches are reset once the image is loaded, so filling them doesn't make the binding dirty.
+*/
+static SyxOop
+_syx_interp_lookup_send_site (SyxOop klass, SyxOop binding)
+{
+  SyxOop *cache;
+  SyxOop method;
+  syx_bool dirty;
+
+  /* monomorphic hit */
+  cache = SYX_OBJECT_DATA (binding);
+  if (SYX_OBJECT_DATA_SIZE (binding) == SYX_INLINE_CACHE_SIZE
+      && cache[1] == klass)
+    return cache[2];
+
+  dirty = SYX_OBJECT_IS_DIRTY (binding);
+  method = _syx_interp_fill_send_site (klass, binding);
+  SYX_OBJECT_IS_DIRTY (binding) = dirty;
+
+  return method;
+}
+
+/* Answer a quick method in place of the message, without creating a frame.
+   Look at SYX_METHOD_QUICK_FIRST */
+static syx_bool
+_syx_interp_call_quick_method (syx_int32 primitive, SyxOop method)
+{
+  syx_int32 argument = SYX_METHOD_QUICK_ARGUMENT (primitive);
+  SyxOop receiver = _syx_interp_state.message_receiver;
+
+#ifdef SYX_DEBUG_BYTECODE
+  syx_debug ("BYTECODE - Quick method %d argument %d\n", SYX_METHOD_QUICK_KIND (primitive), argument);
+#endif
+
+  _syx_interp_quick_method_calls++;
+
+  switch (SYX_METHOD_QUICK_KIND (primitive))
+    {
+    case SYX_METHOD_QUICK_SELF:
+      syx_interp_stack_push (receiver);
+      break;
+    case SYX_METHOD_QUICK_CONSTANT:
+      if (argument == SYX_BYTECODE_CONST_NIL)
+        syx_interp_stack_push (syx_nil);
+      else
+        syx_interp_stack_push (syx_boolean_new (argument == SYX_BYTECODE_CONST_TRUE));
+      break;
+    case SYX_METHOD_QUICK_LITERAL:
+      syx_interp_stack_push (SYX_OBJECT_DATA (SYX_CODE_LITERALS (method))[argument]);
+      break;
+    case SYX_METHOD_QUICK_INSTANCE:
+      syx_interp_stack_push (SYX_OBJECT_VARS (receiver)[argument]);
+      break;
+    case SYX_METHOD_QUICK_SETTER:
+      SYX_OBJECT_VARS (receiver)[argument] = _syx_interp_state.message_arguments[0];
+      syx_memory_write_barrier (receiver, _syx_interp_state.message_arguments[0]);
+      syx_interp_stack_push (receiver);
+      break;
+    }
+
+  return TRUE;
+}
+
 SYX_FUNC_INTERPRETER (syx_interp_send_message)
 {
   SyxOop binding;
@@ -665,7 +867,7 @@ SYX_FUNC_INTERPRETER (syx_interp_send_message)
 
   binding = _syx_interp_state.method_literals[argument];
   klass = syx_object_get_class (_syx_interp_state.message_receiver); 
-  method = syx_class_lookup_method_binding (klass, binding);
+  method = _syx_interp_lookup_send_site (klass, binding);
   SYX_END_PROFILE(send_message);
 #ifdef SYX_DEBUG_BYTECODE
 #ifdef SYX_DEBUG_CONTEXT
@@ -696,6 +898,8 @@ SYX_FUNC_INTERPRETER (syx_interp_send_message)
     return syx_interp_call_primitive (primitive, method);
   else if (primitive == -2)
     return syx_plugin_call_interp (&_syx_interp_state, method);
+  else if (SYX_METHOD_QUICK_IS_QUICK (primitive))
+    return _syx_interp_call_quick_method (primitive, method);
 
   _syx_interp_frame_prepare_new (&_syx_interp_state, method);
   return TRUE;
@@ -709,7 +913,7 @@ SYX_FUNC_INTERPRETER (syx_interp_send_super)
 
   binding = _syx_interp_state.method_literals[argument];
   klass = SYX_CLASS_SUPERCLASS (SYX_CODE_CLASS (_syx_interp_state.frame->method));
-  method = syx_class_lookup_method_binding (klass, binding);
+  method = _syx_interp_lookup_send_site (klass, binding);
 
 #ifdef SYX_DEBUG_BYTECODE
   syx_debug ("BYTECODE - Send message #%s to super\n", SYX_OBJECT_SYMBOL (SYX_ASSOCIATION_KEY (binding)));
@@ -728,6 +932,8 @@ SYX_FUNC_INTERPRETER (syx_interp_send_super)
     return syx_interp_call_primitive (primitive, method);
   else if (primitive == -2)
     return syx_plugin_call_interp (&_syx_interp_state, method);
+  else if (SYX_METHOD_QUICK_IS_QUICK (primitive))
+    return _syx_interp_call_quick_method (primitive, method);
 
   _syx_interp_frame_prepare_new (&_syx_interp_state, method);
   return TRUE;
@@ -735,71 +941,48 @@ SYX_FUNC_INTERPRETER (syx_interp_send_super)
 
 SYX_FUNC_INTERPRETER (syx_interp_send_unary)
 {
-  /*
-  SyxOop klass, method, context;
-  syx_int32 primitive;
-  syx_int32 index;
-  SyxOop binding;
-  syx_symbol selector;
-  
-  _syx_exec_state->message_receiver = syx_interp_stack_pop ();
-  index = SYX_SMALL_INTEGER (SYX_ASSOCIATION_KEY (_syx_exec_state->literals[argument]));
-  binding = SYX_ASSOCIATION_VALUE (_syx_exec_state->literals[argument]);
-  selector = SYX_OBJECT_SYMBOL (SYX_ASSOCIATION_KEY (binding));
-
-  switch (index)
-    {
-    case 0:
-      #ifdef SYX_DEBUG_BYTECODE
-      syx_debug ("BYTECODE - Send unary message isNil\n");
-      #endif
-      syx_interp_stack_push (syx_boolean_new (SYX_IS_NIL (_syx_exec_state->message_receiver)));
-      return TRUE;
-    case 1:
-      #ifdef SYX_DEBUG_BYTECODE
-      syx_debug ("BYTECODE - Send unary message notNil\n");
-      #endif
-      syx_interp_stack_push (syx_boolean_new (!SYX_IS_NIL (_syx_exec_state->message_receiver)));
-      return TRUE;
-    }
-
-  klass = syx_object_get_class (_syx_exec_state->message_receiver);
-  method = syx_class_lookup_method_binding (klass, binding);  
+  SyxOop receiver = syx_interp_stack_peek ();
 
 #ifdef SYX_DEBUG_BYTECODE
-  syx_debug ("BYTECODE - Send unary message #%s\n", selector);
+  syx_debug ("BYTECODE - Send unary message #%s\n",
+             syx_bytecode_unary_messages[argument & SYX_BYTECODE_SPECIAL_MESSAGE_MASK]);
 #endif
 
-  if (SYX_IS_NIL (method))
+  switch (argument & SYX_BYTECODE_SPECIAL_MESSAGE_MASK)
     {
-#ifdef SYX_DEBUG_BYTECODE
-      syx_debug ("BYTECODE - NOT UNDERSTOOD unary #%s\n", selector);
-#endif
-      return syx_signal_does_not_understand (_syx_exec_state->message_receiver, syx_symbol_new (selector));
+    case SYX_BYTECODE_UNARY_IS_NIL:
+      _syx_interp_state.frame->stack[-1] = syx_boolean_new (SYX_IS_NIL (receiver));
+      return TRUE;
+    case SYX_BYTECODE_UNARY_NOT_NIL:
+      _syx_interp_state.frame->stack[-1] = syx_boolean_new (!SYX_IS_NIL (receiver));
+      return TRUE;
     }
 
-  primitive = SYX_SMALL_INTEGER (SYX_METHOD_PRIMITIVE (method));
-  if (primitive >= 0 && primitive < SYX_PRIMITIVES_MAX)
-    return syx_interp_call_primitive (primitive, method);
-  else if (primitive == -2)
-    return syx_plugin_call_interp (_syx_exec_state, method);
-
-    context = syx_method_context_new (_syx_exec_state->context, method, _syx_exec_state->message_receiver, syx_nil);
-
-    return syx_interp_enter_context (context);*/
-  return 0;
+  syx_interp_mark_arguments (0);
+  return syx_interp_send_message (argument >> SYX_BYTECODE_SPECIAL_MESSAGE_BITS);
 }
 
 SYX_FUNC_INTERPRETER (syx_interp_push_block_closure)
 {
   SyxInterpFrame *frame;
   syx_int32 frame_size;
+  syx_int32 arguments_count;
   SyxOop frame_oop;
   SyxOop closure;
+  SyxMemoryHandleScope scope;
 
-  syx_memory_gc_begin ();
+  closure = _syx_interp_state.method_literals[argument];
 
-  closure = syx_object_copy (_syx_interp_state.method_literals[argument]);
+  /* Clean blocks already own their outer frame */
+  if (!SYX_IS_NIL (SYX_BLOCK_CLOSURE_OUTER_FRAME (closure)))
+    {
+      syx_interp_stack_push (closure);
+      return TRUE;
+    }
+
+  scope = syx_memory_handle_scope_open ();
+
+  closure = syx_object_copy (closure);
 
 #ifdef SYX_DEBUG_BYTECODE
   syx_debug ("BYTECODE - Push block closure %d -> %p\n", argument, SYX_OOP_CAST_POINTER (closure));
@@ -811,12 +994,16 @@ SYX_FUNC_INTERPRETER (syx_interp_push_block_closure)
     SYX_BLOCK_CLOSURE_OUTER_FRAME(closure) = _syx_interp_state.frame->detached_frame;
   else
     {
-      /* Copy up to temporaries */
+      /* Copy up to temporaries, then put the arguments after them */
+      arguments_count = SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (_syx_interp_state.frame->method));
       frame_size = SYX_POINTERS_OFFSET (&_syx_interp_state.frame->local, _syx_interp_state.frame) +
-        SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (_syx_interp_state.frame->method)) +
         SYX_SMALL_INTEGER (SYX_CODE_TEMPORARIES_COUNT (_syx_interp_state.frame->method));
-      frame_oop = syx_array_new_ref (frame_size, (SyxOop *)_syx_interp_state.frame);
+      frame_oop = syx_array_new_size (frame_size + arguments_count);
       frame = (SyxInterpFrame *)SYX_OBJECT_DATA (frame_oop);
+      memcpy (frame, _syx_interp_state.frame, frame_size * sizeof (SyxOop));
+      memcpy (SYX_OBJECT_DATA (frame_oop) + frame_size, _syx_interp_state.arguments,
+              arguments_count * sizeof (SyxOop));
+      frame->arguments = SYX_OBJECT_DATA (frame_oop) + frame_size;
       frame->detached_frame = frame_oop;
       /* Detach this frame from the process stack.
          The stack pointer will still refer to the process stack */
@@ -825,107 +1012,117 @@ SYX_FUNC_INTERPRETER (syx_interp_push_block_closure)
       if (!SYX_IS_NIL (frame->this_context))
         {
           SYX_CONTEXT_PART_STACK (frame->this_context) = frame_oop;
+          syx_memory_write_barrier (frame->this_context, frame_oop);
           SYX_CONTEXT_PART_FRAME_POINTER (frame->this_context) = SYX_POINTER_CAST_OOP (frame);
         }
       SYX_BLOCK_CLOSURE_OUTER_FRAME(closure) = frame_oop;
     }
 
-  syx_memory_gc_end ();
+  syx_memory_handle_scope_close (scope);
   
   return TRUE;
 }
 
-SYX_FUNC_INTERPRETER (syx_interp_send_binary)
+/* Answer the result of a binary message between two SmallIntegers, or 0 if the message must be sent */
+static SyxOop
+_syx_interp_small_integer_binary (syx_uint16 message, syx_nint a, syx_nint b)
 {
-  /*
-  SyxOop klass, method, context, first_argument;
-  syx_int32 primitive;
-  SyxOop binding;
-  syx_int32 index;
-  syx_symbol selector;
-
-  first_argument = syx_interp_stack_pop ();
-  _syx_exec_state->message_receiver = syx_interp_stack_pop ();
-  index = SYX_SMALL_INTEGER (SYX_ASSOCIATION_KEY (_syx_exec_state->literals[argument]));
-  binding = SYX_ASSOCIATION_VALUE (_syx_exec_state->literals[argument]);
-  selector = SYX_OBJECT_SYMBOL (SYX_ASSOCIATION_KEY (binding));
+  syx_nint result;
 
-  if (index < 8 && SYX_IS_SMALL_INTEGER(_syx_exec_state->message_receiver) && SYX_IS_SMALL_INTEGER(first_argument))
+  switch (message)
     {
-      switch (index)
-        {
-        case 0:
-          syx_interp_stack_push (syx_small_integer_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) + SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 1:
-          syx_interp_stack_push (syx_small_integer_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) - SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 2:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) < SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 3:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) > SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 4:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) <= SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 5:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) >= SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 6:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) == SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        case 7:
-          syx_interp_stack_push (syx_boolean_new (SYX_SMALL_INTEGER(_syx_exec_state->message_receiver) != SYX_SMALL_INTEGER(first_argument)));
-          return TRUE;
-        }
+    case SYX_BYTECODE_BINARY_PLUS:
+      result = a + b;
+      break;
+    case SYX_BYTECODE_BINARY_MINUS:
+      result = a - b;
+      break;
+    case SYX_BYTECODE_BINARY_MUL:
+      if (SYX_SMALL_INTEGER_MUL_OVERFLOW (a, b))
+        return 0;
+      result = a * b;
+      break;
+    case SYX_BYTECODE_BINARY_INT_DIV:
+      if (SYX_SMALL_INTEGER_DIV_OVERFLOW (a, b))
+        return 0;
+      /* round towards negative infinity */
+      result = a / b;
+      if ((a % b) && ((a < 0) != (b < 0)))
+        result--;
+      break;
+    case SYX_BYTECODE_BINARY_MOD:
+      if (!b)
+        return 0;
+      /* the sign follows the divisor */
+      result = a % b;
+      if (result && ((result < 0) != (b < 0)))
+        result += b;
+      break;
+    case SYX_BYTECODE_BINARY_BIT_AND:
+      result = a & b;
+      break;
+    case SYX_BYTECODE_BINARY_LT:
+      return syx_boolean_new (a < b);
+    case SYX_BYTECODE_BINARY_GT:
+      return syx_boolean_new (a > b);
+    case SYX_BYTECODE_BINARY_LE:
+      return syx_boolean_new (a <= b);
+    case SYX_BYTECODE_BINARY_GE:
+      return syx_boolean_new (a >= b);
+    case SYX_BYTECODE_BINARY_EQ:
+    case SYX_BYTECODE_BINARY_IDENTITY:
+      return syx_boolean_new (a == b);
+    case SYX_BYTECODE_BINARY_NE:
+      return syx_boolean_new (a != b);
+    default:
+      return 0;
     }
 
-  klass = syx_object_get_class (_syx_exec_state->message_receiver);
-  method = syx_class_lookup_method_binding (klass, binding);
+  if (!SYX_SMALL_INTEGER_CAN_EMBED (result))
+    return 0;
+
+  return syx_small_integer_new (result);
+}
+
+SYX_FUNC_INTERPRETER (syx_interp_send_binary)
+{
+  syx_uint16 message = argument & SYX_BYTECODE_SPECIAL_MESSAGE_MASK;
+  SyxOop first = _syx_interp_state.frame->stack[-2];
+  SyxOop second = _syx_interp_state.frame->stack[-1];
+  SyxOop result = 0;
 
 #ifdef SYX_DEBUG_BYTECODE
-  syx_debug ("BYTECODE - Send binary message #%s\n", selector);
+  syx_debug ("BYTECODE - Send binary message #%s\n", syx_bytecode_binary_messages[message]);
 #endif
 
-  if (SYX_IS_NIL (method))
+  if (SYX_IS_SMALL_INTEGER (first) && SYX_IS_SMALL_INTEGER (second))
+    result = _syx_interp_small_integer_binary (message, SYX_SMALL_INTEGER (first), SYX_SMALL_INTEGER (second));
+  else if (message == SYX_BYTECODE_BINARY_IDENTITY
+           && (SYX_IS_NIL (first) || SYX_IS_BOOLEAN (first) || SYX_IS_NIL (second) || SYX_IS_BOOLEAN (second)))
     {
-#ifdef SYX_DEBUG_BYTECODE
-      syx_debug ("BYTECODE - NOT UNDERSTOOD binary #%s\n", selector);
-#endif
-      return syx_signal_does_not_understand (_syx_exec_state->message_receiver, syx_symbol_new (selector));
+      /* numbers and characters compare by value with #==, but never equal nil, true or false */
+      result = syx_boolean_new (first == second);
     }
 
-  if (_syx_exec_state->message_arguments)
-    syx_free (_syx_exec_state->message_arguments);
-  
-  _syx_exec_state->message_arguments = (SyxOop *) syx_calloc (1, sizeof (SyxOop));
-  _syx_exec_state->message_arguments[0] = first_argument;
-
-  primitive = SYX_SMALL_INTEGER (SYX_METHOD_PRIMITIVE (method));
-  if (primitive >= 0 && primitive < SYX_PRIMITIVES_MAX)
-    return syx_interp_call_primitive (primitive, method);
-  else if (primitive == -2)
-    return syx_plugin_call_interp (_syx_exec_state, method);
-
-  syx_memory_gc_begin ();
-  context = syx_method_context_new (_syx_exec_state->context, method, _syx_exec_state->message_receiver,
-    syx_array_new (1, _syx_exec_state->message_arguments));
-  syx_memory_gc_end ();
-  _syx_exec_state->message_arguments = NULL;
+  if (result)
+    {
+      _syx_interp_state.frame->stack--;
+      _syx_interp_state.frame->stack[-1] = result;
+      return TRUE;
+    }
 
-  return syx_interp_enter_context (context);*/
-  return 0;
+  syx_interp_mark_arguments (1);
+  return syx_interp_send_message (argument >> SYX_BYTECODE_SPECIAL_MESSAGE_BITS);
 }
 
 SYX_FUNC_INTERPRETER (syx_interp_do_special)
 {
   SyxOop returned_object;
   SyxOop condition;
-  syx_uint16 jump;
+  syx_uint32 jump;
   SyxOop ensure_block;
 
-  switch (argument)
+  switch (argument & SYX_BYTECODE_DECODED_SPECIAL_MASK)
     {
     case SYX_BYTECODE_POP_TOP:
 #ifdef SYX_DEBUG_BYTECODE
@@ -1012,23 +1209,40 @@ SYX_FUNC_INTERPRETER (syx_interp_do_special)
       syx_debug ("BYTECODE - Conditional\n");
 #endif
       condition = syx_interp_stack_pop ();
-      jump = _syx_interp_get_next_byte ();
+      jump = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
       if (!SYX_IS_BOOLEAN (condition))
         syx_signal (SYX_ERROR_INTERP, syx_string_new ("Condition must be boolean"));
 
       /* Check for jump to the other conditional branch */
-      if ((argument == SYX_BYTECODE_BRANCH_IF_TRUE ? SYX_IS_FALSE (condition) : SYX_IS_TRUE (condition)))
+      if (((argument & SYX_BYTECODE_DECODED_SPECIAL_MASK) == SYX_BYTECODE_BRANCH_IF_TRUE
+           ? SYX_IS_FALSE (condition) : SYX_IS_TRUE (condition)))
         {
           syx_interp_stack_push (syx_nil);
           _syx_interp_state.frame->next_instruction = jump;
         }
 
+      return TRUE;
+    case SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN:
+#ifdef SYX_DEBUG_BYTECODE
+      syx_debug ("BYTECODE - Branch if not boolean\n");
+#endif
+      if (!SYX_IS_BOOLEAN (syx_interp_stack_peek ()))
+        _syx_interp_state.frame->next_instruction = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
+
+      return TRUE;
+    case SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER:
+#ifdef SYX_DEBUG_BYTECODE
+      syx_debug ("BYTECODE - Branch if not small integer\n");
+#endif
+      if (!SYX_IS_SMALL_INTEGER (syx_interp_stack_peek ()))
+        _syx_interp_state.frame->next_instruction = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
+
       return TRUE;
     case SYX_BYTECODE_BRANCH:
 #ifdef SYX_DEBUG_BYTECODE
       syx_debug ("BYTECODE - Branch\n");
 #endif
-      jump = _syx_interp_get_next_byte ();
+      jump = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
       if (jump)
         _syx_interp_state.frame->next_instruction = jump;
 
@@ -1053,32 +1267,275 @@ SYX_FUNC_INTERPRETER (syx_interp_do_special)
 
 SYX_FUNC_INTERPRETER (syx_interp_do_extended)
 {
-  SyxInterpreterFunc handler;
-  syx_uint16 command = argument;
-  argument = _syx_interp_get_next_byte ();
-  handler = handlers[command];
-  return handler (argument);
+  /* Extended instructions are decoded to their real command,
+     only a truncated one at the end of the bytecodes can be left */
+#ifdef SYX_DEBUG_BYTECODE
+  syx_debug ("BYTECODE ------- TRUNCATED EXTENDED --------\n");
+#endif
+  syx_signal (SYX_ERROR_INTERP, syx_string_new ("Truncated extended bytecode: %p", argument));
+  return FALSE;
 }
 
-static syx_uint16
+#ifndef SYX_INTERP_THREADED
+
+/* Fetch the next decoded instruction, skipping the word taken by wide instructions */
+static syx_uint32
 _syx_interp_get_next_byte (void)
 {
+  syx_uint32 byte = _syx_interp_state.method_bytecodes[_syx_interp_state.frame->next_instruction];
+
 #ifdef SYX_DEBUG_TRACE_IP
-  syx_debug ("TRACE IP - Fetch at ip %d bytecode: %u - %p\n", _syx_interp_state.frame->next_instruction, _syx_interp_state.method_bytecodes[_syx_interp_state.frame->next_instruction], _syx_interp_state.frame);
+  syx_debug ("TRACE IP - Fetch at ip %d bytecode: %u - %p\n", _syx_interp_state.frame->next_instruction, byte, _syx_interp_state.frame);
 #endif
 
-  return SYX_COMPAT_SWAP_16 (_syx_interp_state.method_bytecodes[_syx_interp_state.frame->next_instruction++]);
+  _syx_interp_state.frame->next_instruction += (byte & SYX_BYTECODE_DECODED_WIDE) ? 2 : 1;
+  return byte;
 }
 
 static syx_bool
-_syx_interp_execute_byte (syx_uint16 byte)
+_syx_interp_execute_byte (syx_uint32 byte)
 {
-  syx_uint16 command, argument;
+  syx_uint32 command, argument;
   SyxInterpreterFunc handler;
 
-  command = (byte & SYX_BYTECODE_COMMAND_MASK) >> SYX_BYTECODE_ARGUMENT_BITS;
-  argument = byte & SYX_BYTECODE_ARGUMENT_MASK;
+  command = byte & SYX_BYTECODE_DECODED_COMMAND_MASK;
+  argument = byte >> SYX_BYTECODE_DECODED_ARGUMENT_SHIFT;
   handler = handlers[command];
 
   return handler (argument);
 }
+
+#endif /* !SYX_INTERP_THREADED */
+
+#ifdef SYX_INTERP_THREADED
+
+/* Labels as values are a GCC extension */
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/*
+  Direct threaded interpreter.
+
+  The instruction pointer, the stack pointer and the literals are cached into local variables.
+  Simple instructions are executed in place, the others are given to their handler
+  after the cached registers have been saved into the frame.
+*/
+
+/* Save the cached registers into the active frame */
+#define _SYX_INTERP_STORE                                               \
+  frame->next_instruction = ip - bytecodes;                             \
+  frame->stack = sp
+
+/* Load the registers from the active frame. Handlers can change the frame or the process */
+#define _SYX_INTERP_LOAD                                                \
+  frame = _syx_interp_state.frame;                                      \
+  if (!frame)                                                           \
+    return;                                                             \
+  bytecodes = _syx_interp_state.method_bytecodes;                       \
+  literals = _syx_interp_state.method_literals;                         \
+  ip = bytecodes + frame->next_instruction;                             \
+  sp = frame->stack
+
+/* Fetch the next instruction and jump to the code executing its command */
+#define _SYX_INTERP_DISPATCH                                            \
+  byte = *ip;                                                           \
+  ip += 1 + ((byte & SYX_BYTECODE_DECODED_WIDE) >> SYX_BYTECODE_COMMAND_BITS); \
+  argument = byte >> SYX_BYTECODE_DECODED_ARGUMENT_SHIFT;               \
+  goto *commands[byte & SYX_BYTECODE_DECODED_COMMAND_MASK]
+
+/* Go on with the next instruction unless the byteslice is over */
+#define _SYX_INTERP_NEXT                                                \
+  if (scheduled && --_syx_interp_state.byteslice < 0)                   \
+    goto leave;                                                         \
+  _SYX_INTERP_DISPATCH
+
+/* Execute the instruction using its handler.
+   Somebody wants to yield control to other processes if the handler returns FALSE */
+#define _SYX_INTERP_CALL(handler)                                       \
+  _SYX_INTERP_STORE;                                                    \
+  result = (handler) (argument) ? syx_true : syx_false;                 \
+  _SYX_INTERP_LOAD;                                                     \
+  if (scheduled && SYX_IS_FALSE (result))                               \
+    goto leave;                                                         \
+  _SYX_INTERP_NEXT
+
+static void
+_syx_interp_execute_threaded (syx_bool scheduled)
+{
+  /* Must match SyxBytecodeCommand */
+  static void *commands[] =
+    {
+      __extension__ &&push_instance,
+      __extension__ &&push_argument,
+      __extension__ &&push_temporary,
+      __extension__ &&push_literal,
+      __extension__ &&push_constant,
+      __extension__ &&push_binding_variable,
+      __extension__ &&push_array,
+      __extension__ &&push_block_closure,
+
+      __extension__ &&assign_instance,
+      __extension__ &&assign_temporary,
+      __extension__ &&assign_binding_variable,
+
+      __extension__ &&mark_arguments,
+      __extension__ &&send_message,
+      __extension__ &&send_super,
+      __extension__ &&send_unary,
+      __extension__ &&send_binary,
+
+      __extension__ &&do_special,
+      __extension__ &&do_extended
+    };
+  SyxInterpFrame *frame;
+  syx_uint32 *bytecodes;
+  syx_uint32 *ip;
+  SyxOop *sp;
+  SyxOop *literals;
+  syx_uint32 byte, argument;
+  SyxOop result;
+
+  _SYX_INTERP_LOAD;
+  if (scheduled && _syx_interp_state.byteslice < 0)
+    return;
+  _SYX_INTERP_DISPATCH;
+
+ push_instance:
+  *sp++ = SYX_OBJECT_VARS(frame->receiver)[argument];
+  _SYX_INTERP_NEXT;
+
+ push_argument:
+  if (argument == 0)
+    *sp++ = frame->receiver;
+  else
+    *sp++ = *_syx_interp_find_argument (argument - 1);
+  _SYX_INTERP_NEXT;
+
+ push_temporary:
+  *sp++ = *_syx_interp_find_temporary (argument);
+  _SYX_INTERP_NEXT;
+
+ push_literal:
+  *sp++ = literals[argument];
+  _SYX_INTERP_NEXT;
+
+ push_constant:
+  switch (argument)
+    {
+    case SYX_BYTECODE_CONST_NIL:
+      *sp++ = syx_nil;
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_CONST_TRUE:
+      *sp++ = syx_true;
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_CONST_FALSE:
+      *sp++ = syx_false;
+      _SYX_INTERP_NEXT;
+    }
+  _SYX_INTERP_CALL (syx_interp_push_constant);
+
+ push_binding_variable:
+  _SYX_INTERP_CALL (syx_interp_push_binding_variable);
+
+ push_array:
+  _SYX_INTERP_CALL (syx_interp_push_array);
+
+ push_block_closure:
+  _SYX_INTERP_CALL (syx_interp_push_block_closure);
+
+ assign_instance:
+  SYX_OBJECT_VARS(frame->receiver)[argument] = sp[-1];
+  syx_memory_write_barrier (frame->receiver, sp[-1]);
+  _SYX_INTERP_NEXT;
+
+ assign_temporary:
+  _syx_interp_store_temporary (argument, sp[-1]);
+  _SYX_INTERP_NEXT;
+
+ assign_binding_variable:
+  _SYX_INTERP_CALL (syx_interp_assign_binding_variable);
+
+ mark_arguments:
+  _SYX_INTERP_CALL (syx_interp_mark_arguments);
+
+ send_message:
+  _SYX_INTERP_CALL (syx_interp_send_message);
+
+ send_super:
+  _SYX_INTERP_CALL (syx_interp_send_super);
+
+ send_unary:
+  switch (argument & SYX_BYTECODE_SPECIAL_MESSAGE_MASK)
+    {
+    case SYX_BYTECODE_UNARY_IS_NIL:
+      sp[-1] = syx_boolean_new (SYX_IS_NIL (sp[-1]));
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_UNARY_NOT_NIL:
+      sp[-1] = syx_boolean_new (!SYX_IS_NIL (sp[-1]));
+      _SYX_INTERP_NEXT;
+    }
+  _SYX_INTERP_CALL (syx_interp_send_unary);
+
+ send_binary:
+  if (SYX_IS_SMALL_INTEGER (sp[-2]) && SYX_IS_SMALL_INTEGER (sp[-1]))
+    {
+      result = _syx_interp_small_integer_binary (argument & SYX_BYTECODE_SPECIAL_MESSAGE_MASK,
+                                                 SYX_SMALL_INTEGER (sp[-2]),
+                                                 SYX_SMALL_INTEGER (sp[-1]));
+      if (result)
+        {
+          sp--;
+          sp[-1] = result;
+          _SYX_INTERP_NEXT;
+        }
+    }
+  _SYX_INTERP_CALL (syx_interp_send_binary);
+
+ do_special:
+  switch (argument & SYX_BYTECODE_DECODED_SPECIAL_MASK)
+    {
+    case SYX_BYTECODE_POP_TOP:
+      sp--;
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_DUPLICATE:
+      *sp = sp[-1];
+      sp++;
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_BRANCH:
+      byte = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
+      if (byte)
+        ip = bytecodes + byte;
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN:
+      if (!SYX_IS_BOOLEAN (sp[-1]))
+        ip = bytecodes + (argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS);
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER:
+      if (!SYX_IS_SMALL_INTEGER (sp[-1]))
+        ip = bytecodes + (argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS);
+      _SYX_INTERP_NEXT;
+    case SYX_BYTECODE_BRANCH_IF_TRUE:
+    case SYX_BYTECODE_BRANCH_IF_FALSE:
+      /* let the handler signal the error */
+      if (!SYX_IS_BOOLEAN (sp[-1]))
+        break;
+
+      result = *--sp;
+      byte = argument >> SYX_BYTECODE_DECODED_SPECIAL_BITS;
+      if (((argument & SYX_BYTECODE_DECODED_SPECIAL_MASK) == SYX_BYTECODE_BRANCH_IF_TRUE
+           ? SYX_IS_FALSE (result) : SYX_IS_TRUE (result)))
+        {
+          *sp++ = syx_nil;
+          ip = bytecodes + byte;
+        }
+      _SYX_INTERP_NEXT;
+    }
+  _SYX_INTERP_CALL (syx_interp_do_special);
+
+ do_extended:
+  _SYX_INTERP_CALL (syx_interp_do_extended);
+
+ leave:
+  _SYX_INTERP_STORE;
+}
+
+#endif /* SYX_INTERP_THREADED */
@@ -32,12 +32,15 @@
 
 SYX_BEGIN_DECLS
 
-#define SYX_INTERP_STATE_NEW {0, 0, 0, 0, 0, 0, 0, 0, 0, {0}, 0}
+#define SYX_INTERP_STATE_NEW {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
 
 /*
   Remember SyxOop has the same size of a pointer.
   All the pointers and native ints, in the image will be transformed to an index, to be cross-platform compatible.
   When reading the image, the indexes will be transformed back into pointers.
+
+  The arguments pushed by the sender are not copied: they're left right below the frame in the process stack,
+  followed by the temporaries and the local stack. Detached frames hold their arguments after the temporaries.
 */
 typedef struct SyxInterpFrame SyxInterpFrame;
 struct SyxInterpFrame
@@ -51,8 +54,9 @@ struct SyxInterpFrame
   SyxOop closure;
   syx_nint next_instruction;
   SyxOop *stack;
+  SyxOop *arguments;
   SyxOop receiver;
-  SyxOop local; /* used to point to arguments */
+  SyxOop local; /* used to point to temporaries */
 };
 
 typedef struct SyxInterpState SyxInterpState;
@@ -63,11 +67,11 @@ struct SyxInterpState
   SyxOop *arguments;
   SyxOop *temporaries;
   SyxOop *method_literals;
-  syx_uint16 *method_bytecodes;
+  syx_uint32 *method_bytecodes;
   syx_int32 method_bytecodes_count;
   syx_int32 byteslice;
   syx_int32 message_arguments_count;
-  SyxOop message_arguments[0xFF];
+  SyxOop *message_arguments;
   SyxOop message_receiver;
 };
 
@@ -75,6 +79,10 @@ struct SyxInterpState
 EXPORT SyxInterpFrame *syx_interp_context_to_frame (SyxOop context);
 EXPORT SyxOop syx_interp_frame_to_context (SyxOop stack, SyxInterpFrame *frame);
 EXPORT void _syx_interp_frame_prepare_new (SyxInterpState *state, SyxOop method);
+EXPORT SyxOop syx_interp_clean_frame_new (SyxOop method);
+
+/*! TRUE if the frame is the outer frame shared by the clean blocks of a method, which has no stack */
+#define SYX_INTERP_FRAME_IS_CLEAN(frame) (!(frame)->stack)
 
 /* Primitives */
 
@@ -101,7 +109,27 @@ EXPORT void _syx_interp_frame_prepare_new (SyxInterpState *state, SyxOop method)
     }
 
 /*! The number of primitives */
-#define SYX_PRIMITIVES_MAX 117
+#define SYX_PRIMITIVES_MAX 145
+
+/*!
+  Quick methods are tagged with a primitive lower than -2,
+  holding a SyxMethodQuick and its argument like an index of an instance variable.
+*/
+#define SYX_METHOD_QUICK_FIRST (-3)
+/*! Bits of the quick primitive holding the SyxMethodQuick */
+#define SYX_METHOD_QUICK_KIND_BITS 3
+/*! A mask to be used with bit-wise AND to retrieve the SyxMethodQuick */
+#define SYX_METHOD_QUICK_KIND_MASK ((1 << SYX_METHOD_QUICK_KIND_BITS) - 1)
+
+/*! Create the primitive of a quick method */
+#define SYX_METHOD_QUICK_NEW(kind, argument) \
+  (SYX_METHOD_QUICK_FIRST - (((argument) << SYX_METHOD_QUICK_KIND_BITS) + (kind)))
+/*! TRUE if the primitive of a method tells that it's a quick method */
+#define SYX_METHOD_QUICK_IS_QUICK(primitive) ((primitive) <= SYX_METHOD_QUICK_FIRST)
+/*! Retrieve the SyxMethodQuick from the primitive of a quick method */
+#define SYX_METHOD_QUICK_KIND(primitive) ((SYX_METHOD_QUICK_FIRST - (primitive)) & SYX_METHOD_QUICK_KIND_MASK)
+/*! Retrieve the argument from the primitive of a quick method */
+#define SYX_METHOD_QUICK_ARGUMENT(primitive) ((SYX_METHOD_QUICK_FIRST - (primitive)) >> SYX_METHOD_QUICK_KIND_BITS)
 
 typedef syx_bool (* SyxPrimitiveFunc) (SyxInterpState *es, SyxOop method);
 #define SYX_FUNC_PRIMITIVE(name)                          \
@@ -136,10 +164,13 @@ EXPORT syx_int32 syx_primitive_get_index (syx_symbol name);
 
 EXPORT SyxInterpState _syx_interp_state;
 
-typedef syx_bool (* SyxInterpreterFunc) (syx_uint16 argument);
+/*! How many times a quick method has been answered without creating a frame */
+EXPORT syx_uint32 _syx_interp_quick_method_calls;
+
+typedef syx_bool (* SyxInterpreterFunc) (syx_uint32 argument);
 #define SYX_FUNC_INTERPRETER(name)        \
   syx_bool                                \
-  name (syx_uint16 argument)
+  name (syx_uint32 argument)
 
 EXPORT void syx_interp_init (void);
 EXPORT void syx_interp_quit (void);
@@ -44,7 +44,7 @@ struct SyxToken {
   SyxTokenType type;
   union SyxTokenValue
   {
-    syx_int32 integer;
+    syx_nint integer;
 #ifdef HAVE_LIBGMP
     mpz_t *large_integer;
 #endif
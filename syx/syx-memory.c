@@ -22,6 +22,10 @@
    DEALINGS IN THE SOFTWARE.
 */
 
+/* for fileno and anonymous mappings */
+#define _DEFAULT_SOURCE 1
+#define _BSD_SOURCE 1
+
 #include "syx-config.h"
 #include "syx-memory.h"
 #include "syx-object.h"
@@ -42,6 +46,20 @@
 #include <gmp.h>
 #endif
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define SYX_MEMORY_MMAP
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H) && defined(HAVE_UNISTD_H)
+#include <sys/types.h>
+#include <sys/wait.h>
+#define SYX_MEMORY_FORK
+#endif
+
 #ifdef SYX_DEBUG_INFO
 #define SYX_DEBUG_GC
 #endif
@@ -55,6 +73,25 @@ static syx_bool _syx_memory_initialized = FALSE;
 
 #define SYX_MEMORY_TOP (&syx_memory[_syx_memory_size - 1])
 
+/* The default maximum number of objects */
+#define SYX_MEMORY_DEFAULT_MAX_SIZE 0x200000
+
+/* Object headers refer to their classes by index, which limits the size of the table */
+#define SYX_MEMORY_LIMIT (1 << SYX_OBJECT_CLASS_BITS)
+
+/* Oops are addresses into the table, so it can't be moved once allocated.
+   The whole capacity is reserved at once and the table grows in place, up to the maximum size */
+static syx_int32 _syx_memory_capacity = 0;
+static syx_int32 _syx_memory_max_size = SYX_MEMORY_DEFAULT_MAX_SIZE;
+
+/* The table doesn't shrink below the size it has been initialized with */
+static syx_int32 _syx_memory_initial_size = 0;
+
+/* Grow the table when more than this percentage of objects is still used after a full collection,
+   shrink it when less than this other percentage is used. Zero disables either of them */
+static syx_int32 _syx_memory_grow_threshold = 75;
+static syx_int32 _syx_memory_shrink_threshold = 20;
+
 typedef enum
 {
   SYX_MEMORY_TYPE_IMMEDIATE,
@@ -65,7 +102,9 @@ typedef enum
   SYX_MEMORY_TYPE_LARGE_INTEGER,
   
   SYX_MEMORY_TYPE_BOF, /* Beginning of frame */
-  SYX_MEMORY_TYPE_EOS  /* End of stack */
+  SYX_MEMORY_TYPE_EOS, /* End of stack */
+
+  SYX_MEMORY_TYPE_WIDE_INTEGER /* SmallInteger not fitting 32 bits, stored by value */
 } SyxMemoryType;
 
 typedef struct SyxMemoryLazyPointer SyxMemoryLazyPointer;
@@ -79,15 +118,196 @@ struct SyxMemoryLazyPointer
 /* Lazy pointers to be fixed once the image is loaded */
 static SyxMemoryLazyPointer *_syx_memory_lazy_pointers = NULL;
 static syx_int32 _syx_memory_lazy_pointers_top = 0;
+static syx_int32 _syx_memory_lazy_pointers_size = 0;
+
+typedef struct SyxMemoryWideInteger SyxMemoryWideInteger;
+struct SyxMemoryWideInteger
+{
+  syx_int32 high;
+  syx_uint32 low;
+  SyxOop *entry;
+};
+
+/* SmallIntegers saved by 64-bit hosts which don't fit this host, to become LargeIntegers once the image is loaded */
+static SyxMemoryWideInteger *_syx_memory_wide_integers = NULL;
+static syx_int32 _syx_memory_wide_integers_top = 0;
+static syx_int32 _syx_memory_wide_integers_size = 0;
+
+/* The number of allocations after which young objects are collected */
+#define SYX_MEMORY_NURSERY_SIZE(memory_size) ((memory_size) / 8)
+
+/* Young objects in order of allocation. An oop can appear twice if it has been freed and reused */
+static SyxOop *_syx_memory_nursery = NULL;
+static syx_int32 _syx_memory_nursery_top = 0;
+static syx_int32 _syx_memory_nursery_size = 0;
+
+/* Old objects that may refer to young objects */
+static SyxOop *_syx_memory_remembered = NULL;
+static syx_int32 _syx_memory_remembered_top = 0;
+static syx_int32 _syx_memory_remembered_size = 0;
+
+syx_bool _syx_memory_gc_young_requested = FALSE;
+static syx_bool _syx_memory_gc_running = FALSE;
+
+/* Marked objects whose references have still to be marked */
+static SyxOop *_syx_memory_mark_stack = NULL;
+static syx_int32 _syx_memory_mark_stack_top = 0;
+static syx_int32 _syx_memory_mark_stack_size = 0;
+
+typedef enum
+{
+  SYX_MEMORY_GC_IDLE,
+  SYX_MEMORY_GC_MARKING,
+  SYX_MEMORY_GC_SWEEPING
+} SyxMemoryGCPhase;
+
+/* An incremental collection starts once free objects are less than this number */
+#define SYX_MEMORY_INCREMENTAL_THRESHOLD(memory_size) ((memory_size) / 4)
+
+/* The number of objects to mark or sweep before looking at the clock */
+#define SYX_MEMORY_SLICE_CHECK 0x100
+
+/* State of the incremental collection */
+syx_bool _syx_memory_gc_marking = FALSE;
+static SyxMemoryGCPhase _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+static syx_int32 _syx_memory_gc_sweep_index = 0;
+static syx_bool _syx_memory_gc_incremental = FALSE;
+static syx_uint32 _syx_memory_gc_pause_budget = 1000;
+static syx_uint64 _syx_memory_gc_slice_end = 0;
+
+/* A growable array of oops */
+typedef struct SyxMemoryList SyxMemoryList;
+struct SyxMemoryList
+{
+  SyxOop *oops;
+  syx_int32 top;
+  syx_int32 size;
+};
+
+/* Objects whose class requests finalization, not yet collected */
+static SyxMemoryList _syx_memory_finalizable = {NULL, 0, 0};
+
+/* Collected objects waiting for the finalizer process, from the head on */
+static SyxMemoryList _syx_memory_finalization_queue = {NULL, 0, 0};
+static syx_int32 _syx_memory_finalization_head = 0;
+static syx_bool _syx_memory_finalization_pending = FALSE;
+
+/* Weak arrays found while marking, and ephemerons whose keys were not reached yet */
+static SyxMemoryList _syx_memory_weak_arrays = {NULL, 0, 0};
+static SyxMemoryList _syx_memory_ephemerons = {NULL, 0, 0};
+
+/* Objects allocated while a handle scope is open, and objects saved with syx_memory_handle */
+static SyxMemoryList _syx_memory_handles = {NULL, 0, 0};
+syx_int32 _syx_memory_handle_scopes = 0;
+
+/* Locations of C variables holding objects, see syx_memory_root_add */
+static SyxOop **_syx_memory_roots = NULL;
+static syx_int32 _syx_memory_roots_top = 0;
+static syx_int32 _syx_memory_roots_size = 0;
 
-/* Holds temporary objects that must not be freed during a transaction */
-SyxOop _syx_memory_gc_trans[0x100];
-syx_int32 _syx_memory_gc_trans_top = 0;
-syx_int32 _syx_memory_gc_trans_running = 0;
+/* Pause times in microseconds */
+static syx_uint64 _syx_memory_gc_pause_max = 0;
+static syx_uint64 _syx_memory_gc_pause_total = 0;
+static syx_uint32 _syx_memory_gc_pauses = 0;
+
+/* Counters since the memory has been initialized, see syx_memory_get_stats */
+static SyxMemoryStats _syx_memory_stats;
+
+/* Pauses and reclaimed objects of the running incremental collection */
+static syx_uint64 _syx_memory_gc_cycle_pause = 0;
+static syx_int32 _syx_memory_gc_cycle_reclaimed = 0;
+
+/* A line is written here for each collection, see syx_memory_set_log */
+static FILE *_syx_memory_log = NULL;
+
+/* The size of each arena of the object space */
+#define SYX_MEMORY_ARENA_SIZE 0x10000
+#define SYX_MEMORY_BODY_CLASSES (SYX_MEMORY_BODY_MAX / sizeof (SyxMemoryChunk) + 1)
+
+/* Free bodies of the object space, one list for each size */
+static SyxMemoryChunk *_syx_memory_body_free_lists[SYX_MEMORY_BODY_CLASSES];
+
+/* Arenas of the object space, bodies are carved from the last one */
+static syx_int8 **_syx_memory_arenas = NULL;
+static syx_int32 _syx_memory_arenas_top = 0;
+static syx_int8 *_syx_memory_arena_ptr = NULL;
+static syx_int8 *_syx_memory_arena_end = NULL;
+
+/* The format written by syx_memory_save_image */
+static SyxMemoryImageFormat _syx_memory_image_format = SYX_MEMORY_IMAGE_PORTABLE;
+
+/* Mapped images start with this string */
+#define SYX_MEMORY_MAPPED_MAGIC "SyxMap01"
+
+/* Sections of mapped images start at multiples of this offset, which suits the pages of any host */
+#define SYX_MEMORY_MAPPED_ALIGN 0x10000
+#define SYX_MEMORY_MAPPED_ALIGNED(size) (((size) + SYX_MEMORY_MAPPED_ALIGN - 1) & ~(syx_nint)(SYX_MEMORY_MAPPED_ALIGN - 1))
+
+typedef struct SyxMemoryMappedHeader SyxMemoryMappedHeader;
+
+/* The header of mapped images. Oops refer to the table at its address when it has been saved,
+   instance variables and data to the space at the given base */
+struct SyxMemoryMappedHeader
+{
+  char magic[8];
+  syx_int32 byte_order;
+  syx_int32 oop_size;
+  syx_int32 object_size;
+  syx_int32 memory_size;
+  syx_int32 freed_top;
+  syx_int32 large_integers_top;
+  syx_int32 globals;
+  syx_int32 symbols;
+  SyxOop table_base;
+  SyxOop space_base;
+  syx_nint space_size;
+  /* file offsets of the table, of the indexes of freed entries and large integers, and of the space */
+  syx_nint table_offset;
+  syx_nint indexes_offset;
+  syx_nint space_offset;
+};
+
+/* Bodies of objects loaded from a mapped image, laid out as a single block */
+static syx_int8 *_syx_memory_space = NULL;
+static syx_int8 *_syx_memory_space_end = NULL;
+static syx_bool _syx_memory_space_mapped = FALSE;
+static syx_bool _syx_memory_table_mapped = FALSE;
+
+#ifdef SYX_MEMORY_FORK
+/* The child process writing an image in background, and the pipe to read its result from */
+static pid_t _syx_memory_save_pid = 0;
+static int _syx_memory_save_fd = -1;
+/* The path of that image, and the objects which were dirty when the child has been forked.
+   Their changes are forgotten once the child reports success */
+static char *_syx_memory_save_path = NULL;
+static SyxMemoryList _syx_memory_save_dirty = {NULL, 0, 0};
+static syx_int32 _syx_memory_save_size = 0;
+#endif
+
+/* The image the memory has been loaded from or saved to last, deltas are appended to it */
+static char *_syx_memory_image_path = NULL;
+/* The number of objects of that image. The table of a loaded image is reserved for it,
+   so deltas must not need more */
+static syx_int32 _syx_memory_image_size = 0;
+
+/* Begins a delta appended to an image, in place of the index of the next object */
+#define SYX_MEMORY_DELTA_MARK (-1)
+
+typedef struct SyxMemoryBuffer SyxMemoryBuffer;
+
+/* Portable images are built and parsed in memory, then written or read with a single call */
+struct SyxMemoryBuffer
+{
+  syx_int8 *data;
+  syx_nint size;
+  syx_nint top;
+};
 
 void _syx_interp_save_process_state (SyxInterpState *state);
-static syx_bool _syx_memory_read_process_stack (SyxOop *oop, FILE *image);
-static syx_bool _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image);
+static void _syx_memory_init_state (void);
+static void _syx_memory_release (void);
+static syx_bool _syx_memory_read_process_stack (SyxOop *oop, SyxMemoryBuffer *image);
+static syx_bool _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, SyxMemoryBuffer *image);
 
 /*! \page syx_memory Syx Memory
     
@@ -102,28 +322,199 @@ static syx_bool _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize
 
     Take a look at syx-memory.c for more detailed informations.
     \note the SyxObject::data field, containing SyxObject pointers, is allocated outside this memory.
+
+    Instance variables and data of an object are allocated as a single body, data following the variables.
+    Small bodies are carved from arenas and recycled by size, larger ones are allocated with syx_malloc.
+    Data moves out of the body once the object grows, see syx_object_resize.
+
+    Objects never move, but they are split in two generations.
+    New objects are young and are logged into the nursery in order of allocation.
+    Once the nursery is full, the interpreter runs a young collection at the next message send:
+    only young objects are marked, starting from the remembered set, and the nursery is swept.
+    Survivors are promoted to the old generation, which is collected only by syx_memory_gc.
+
+    The remembered set holds old objects that may refer to young objects.
+    Stores into objects that might be old must call syx_memory_write_barrier.
+    Processes are always remembered, because the interpreter writes into their stacks without barriers.
+
+    In incremental mode, syx_memory_gc_step collects the old generation in slices run by the scheduler
+    between processes, each slice lasting no more than the pause budget.
+    Objects are marked first, then swept lazily. While marking, the write barrier marks stored objects
+    and new objects are allocated marked, so that the running processes can't hide an unmarked object.
+    Process stacks are written without barriers, so processes are marked again before sweeping.
+    Young collections wait for the incremental collection to end.
+
+    Collected objects whose class requests finalization are not freed. The collector keeps them alive
+    in a queue instead, then syx_memory_gc_step schedules a process sending #finalize to them.
+    Elements of a WeakArray and values of an Ephemeron whose key is not reachable otherwise
+    don't keep objects alive, and they are set to nil once the objects are collected.
+
+    Oops are addresses into the table, so the table is never moved. Its maximum size is reserved
+    up front and it grows in place: by half of its size when it's full, or when too many objects
+    survive a full collection. When few objects survive, free entries at its end are released.
+    See syx_memory_set_max_size, syx_memory_set_grow_threshold and syx_memory_set_shrink_threshold.
+
+    Images are portable by default: objects are written field by field, references as indexes.
+    Mapped images hold instead the table and all the bodies as they're laid out in memory.
+    Loading maps them privately from the file at the addresses they've been saved for, so that
+    pages are read once touched and copied once written. If those addresses are taken, references
+    are moved to the actual addresses. Methods are decoded lazily, large integers are rebuilt.
+    See syx_memory_set_image_format.
+
+    Where processes can be forked, syx_memory_save_image_background lets a child process collect
+    and write its copy-on-write view of the memory, while the interpreter keeps running.
+
+    Objects are marked dirty once they're allocated, freed or stored into by the write barrier.
+    syx_memory_save_image_delta appends only dirty objects and freed entries to the image
+    the memory has been loaded from or saved to, together with processes, contexts and closures
+    which the interpreter changes without barriers. Deltas are applied when loading the image,
+    saving the whole image folds them into it.
 */
 
-/*! Initialize or realloc the memory according to the given size */
+/* Append an oop to a list */
+static void
+_syx_memory_list_append (SyxMemoryList *list, SyxOop oop)
+{
+  if (list->top == list->size)
+    {
+      list->size = (list->size ? list->size * 2 : 0x100);
+      list->oops = (SyxOop *) syx_realloc (list->oops, list->size * sizeof (SyxOop));
+    }
+  list->oops[list->top++] = oop;
+}
+
+static void
+_syx_memory_list_free (SyxMemoryList *list)
+{
+  if (list->oops)
+    syx_free (list->oops);
+  list->oops = NULL;
+  list->top = list->size = 0;
+}
+
+/* Make room for new objects, up to the given size. The table grows in place within its capacity.
+   Returns FALSE if the table can't grow */
+static syx_bool
+_syx_memory_grow (syx_int32 size)
+{
+  SyxObject *object;
+
+  if (size > _syx_memory_capacity)
+    size = _syx_memory_capacity;
+  if (size <= _syx_memory_size)
+    return FALSE;
+
+  _syx_freed_memory = (SyxOop *) syx_realloc (_syx_freed_memory, size * sizeof (SyxOop));
+
+  /* push new entries from the top, lower ones are reused first */
+  for (object=&syx_memory[size - 1]; object >= syx_memory + _syx_memory_size; object--)
+    _syx_freed_memory[_syx_freed_memory_top++] = (SyxOop) object;
+
+#ifdef SYX_DEBUG_GC
+  syx_debug ("GC: memory grown from %d to %d objects\n", _syx_memory_size, size);
+#endif
+
+  _syx_memory_size = size;
+  return TRUE;
+}
+
+/* Grow the table by half of its size, without exceeding the maximum size */
+static syx_bool
+_syx_memory_grow_step (void)
+{
+  syx_int32 size = _syx_memory_size + _syx_memory_size / 2;
+
+  if (size > _syx_memory_max_size)
+    size = _syx_memory_max_size;
+
+  return _syx_memory_grow (size);
+}
+
+/* Release free entries at the end of the table, down to the given size.
+   Used entries are never released, so the table might stay bigger */
+static void
+_syx_memory_shrink (syx_int32 size)
+{
+  SyxObject *object;
+  syx_int32 i, top;
+
+  for (object=SYX_MEMORY_TOP; object >= syx_memory + size && SYX_IS_NIL (SYX_OBJECT_CLASS (object)); object--);
+  size = object - syx_memory + 1;
+  if (size >= _syx_memory_size)
+    return;
+
+  /* forget released entries, keeping the order of the others */
+  for (i=0, top=0; i < _syx_freed_memory_top; i++)
+    {
+      if ((syx_int32) SYX_MEMORY_INDEX_OF (_syx_freed_memory[i]) < size)
+        _syx_freed_memory[top++] = _syx_freed_memory[i];
+    }
+  _syx_freed_memory_top = top;
+
+#ifdef SYX_DEBUG_GC
+  syx_debug ("GC: memory shrunk from %d to %d objects\n", _syx_memory_size, size);
+#endif
+
+  _syx_memory_size = size;
+}
+
+/* Apply the growth policy once a full collection is done */
+static void
+_syx_memory_resize (void)
+{
+  syx_int64 used = _syx_memory_size - _syx_freed_memory_top;
+
+  if (_syx_memory_grow_threshold && used * 100 > (syx_int64) _syx_memory_size * _syx_memory_grow_threshold)
+    _syx_memory_grow_step ();
+  else if (_syx_memory_shrink_threshold && _syx_memory_size > _syx_memory_initial_size
+           && used * 100 < (syx_int64) _syx_memory_size * _syx_memory_shrink_threshold)
+    {
+      /* leave half of the table free */
+      if (used * 2 > _syx_memory_initial_size)
+        _syx_memory_shrink ((syx_int32) used * 2);
+      else
+        _syx_memory_shrink (_syx_memory_initial_size);
+    }
+}
+
+/*!
+  Initialize the memory according to the given size.
+
+  The table is allowed to grow up to the maximum size set with syx_memory_set_max_size.
+  If the memory has been already initialized, it grows to the given size.
+*/
 void
 syx_memory_init (syx_int32 mem_size)
 {
   SyxObject *object;
 
+  if (mem_size > SYX_MEMORY_LIMIT)
+    syx_error ("object memory can't hold more than %d objects\n", SYX_MEMORY_LIMIT);
+
   if (_syx_memory_initialized)
     {
-      if (mem_size > _syx_memory_size)
-        {
-          syx_realloc (syx_memory, sizeof (SyxObject) * mem_size);
-          syx_realloc (_syx_freed_memory, sizeof (SyxOop) * mem_size);
-        }
+      if (mem_size > _syx_memory_capacity)
+        syx_error ("object memory can't grow beyond %d objects\n", _syx_memory_capacity);
 
+      _syx_memory_grow (mem_size);
       return;
     }
 
   _syx_memory_size = mem_size;
-
-  syx_memory = (SyxObject *) syx_calloc (_syx_memory_size, sizeof (SyxObject));
+  _syx_memory_initial_size = mem_size;
+  _syx_memory_capacity = (mem_size > _syx_memory_max_size ? mem_size : _syx_memory_max_size);
+
+  /* Pages of the table are not touched until the table grows.
+     A mapped table starts at a page, as mapped images expect */
+#ifdef SYX_MEMORY_MMAP
+  syx_memory = (SyxObject *) mmap (NULL, SYX_MEMORY_MAPPED_ALIGNED (_syx_memory_capacity * sizeof (SyxObject)),
+                                   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (syx_memory == MAP_FAILED)
+    syx_error ("can't reserve memory for %d objects\n", _syx_memory_capacity);
+  _syx_memory_table_mapped = TRUE;
+#else
+  syx_memory = (SyxObject *) syx_calloc (_syx_memory_capacity, sizeof (SyxObject));
+#endif
   _syx_freed_memory = (SyxOop *) syx_calloc (_syx_memory_size, sizeof (SyxOop));
 
   /* fill freed memory with all memory oops */
@@ -131,8 +522,26 @@ syx_memory_init (syx_int32 mem_size)
        _syx_freed_memory_top < _syx_memory_size;
        _syx_freed_memory_top++, object--)
     _syx_freed_memory[_syx_freed_memory_top] = (SyxOop) object;
-  _syx_memory_gc_trans_running = 0;
-  _syx_memory_gc_trans_top = 0;
+
+  _syx_memory_init_state ();
+}
+
+/* Set up the collector once the table and the freed entries are ready */
+static void
+_syx_memory_init_state (void)
+{
+  _syx_memory_handles.top = 0;
+  _syx_memory_handle_scopes = 0;
+
+  _syx_memory_nursery_size = SYX_MEMORY_NURSERY_SIZE (_syx_memory_size);
+  _syx_memory_nursery = (SyxOop *) syx_malloc (_syx_memory_nursery_size * sizeof (SyxOop));
+  _syx_memory_nursery_top = 0;
+  _syx_memory_remembered_size = 0x100;
+  _syx_memory_remembered = (SyxOop *) syx_malloc (_syx_memory_remembered_size * sizeof (SyxOop));
+  _syx_memory_remembered_top = 0;
+  _syx_memory_gc_young_requested = FALSE;
+  _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+  _syx_memory_gc_marking = FALSE;
 
   _syx_memory_initialized = TRUE;
 }
@@ -141,40 +550,105 @@ syx_memory_init (syx_int32 mem_size)
 void
 syx_memory_clear (void)
 {
-  SyxObject *object = syx_memory;
-  SyxOop context, process;
+  SyxOop context, process, finalizable;
+  syx_int32 i;
 
   if (!_syx_memory_initialized)
     return;
 
-  object = syx_memory;
-
-  /* finalize objects */
-  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+  /* finalize objects that have not been finalized yet */
+  for (i=0; i < _syx_memory_finalizable.top; i++)
     {
-      if (SYX_IS_NIL (object->klass))
-        continue;
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (_syx_memory_finalizable.oops[i])))
+        _syx_memory_list_append (&_syx_memory_finalization_queue, _syx_memory_finalizable.oops[i]);
+    }
+  _syx_memory_finalizable.top = 0;
 
-      if (SYX_IS_TRUE (SYX_CLASS_FINALIZATION (object->klass)))
-        {
-          process = syx_process_new ();
-          context = syx_send_unary_message (SYX_POINTER_CAST_OOP (object), "finalize");
-          syx_interp_enter_context (process, context);
-          syx_process_execute_blocking (process);
-        }
+  while (!SYX_IS_NIL (finalizable = syx_memory_finalization_next ()))
+    {
+      process = syx_process_new ();
+      context = syx_send_unary_message (finalizable, "finalize");
+      syx_interp_enter_context (process, context);
+      syx_process_execute_blocking (process);
     }
 
+  _syx_memory_release ();
+  if (_syx_memory_image_path)
+    syx_free (_syx_memory_image_path);
+  _syx_memory_image_path = NULL;
+}
+
+/* Release the table or the space, when they have been mapped */
+static void
+_syx_memory_unmap (syx_pointer region, syx_nint size)
+{
+#ifdef SYX_MEMORY_MMAP
+  munmap (region, SYX_MEMORY_MAPPED_ALIGNED (size));
+#endif
+}
+
+/* Free the table, the objects and the state of the collector */
+static void
+_syx_memory_release (void)
+{
+  SyxObject *object;
+  syx_int32 i;
+
   /* free memory used by objects */
   for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
     {
-      if (object->vars)
-        syx_free (object->vars);
-      if (object->data)
-        syx_free (object->data);
+      /* free entries have no class, don't mistake them for code when classes are not set up */
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (object)) && SYX_CODE_IS_CODE ((SyxOop) object))
+        syx_code_free_decoded ((SyxOop) object);
+#ifdef HAVE_LIBGMP
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (object)) && SYX_OBJECT_IS_LARGE_INTEGER ((SyxOop) object))
+        mpz_clear (SYX_OBJECT_LARGE_INTEGER ((SyxOop) object));
+#endif
+      syx_object_free_body ((SyxOop) object);
     }
 
-  syx_free (syx_memory);
+  for (i=0; i < _syx_memory_arenas_top; i++)
+    syx_free (_syx_memory_arenas[i]);
+  syx_free (_syx_memory_arenas);
+  _syx_memory_arenas = NULL;
+  _syx_memory_arenas_top = 0;
+  _syx_memory_arena_ptr = _syx_memory_arena_end = NULL;
+  memset (_syx_memory_body_free_lists, '\0', sizeof (_syx_memory_body_free_lists));
+
+  if (_syx_memory_table_mapped)
+    _syx_memory_unmap (syx_memory, _syx_memory_capacity * sizeof (SyxObject));
+  else
+    syx_free (syx_memory);
+  if (_syx_memory_space)
+    {
+      if (_syx_memory_space_mapped)
+        _syx_memory_unmap (_syx_memory_space, _syx_memory_space_end - _syx_memory_space);
+      else
+        syx_free (_syx_memory_space);
+    }
+  _syx_memory_table_mapped = _syx_memory_space_mapped = FALSE;
+  _syx_memory_space = _syx_memory_space_end = NULL;
   syx_free (_syx_freed_memory);
+  syx_free (_syx_memory_nursery);
+  syx_free (_syx_memory_remembered);
+  syx_free (_syx_memory_mark_stack);
+  _syx_memory_mark_stack = NULL;
+  _syx_memory_mark_stack_top = _syx_memory_mark_stack_size = 0;
+  _syx_memory_list_free (&_syx_memory_finalizable);
+  _syx_memory_list_free (&_syx_memory_finalization_queue);
+  _syx_memory_list_free (&_syx_memory_weak_arrays);
+  _syx_memory_list_free (&_syx_memory_ephemerons);
+  _syx_memory_list_free (&_syx_memory_handles);
+#ifdef SYX_MEMORY_FORK
+  _syx_memory_list_free (&_syx_memory_save_dirty);
+#endif
+  _syx_memory_handle_scopes = 0;
+  memset (&_syx_memory_stats, '\0', sizeof (SyxMemoryStats));
+  _syx_memory_finalization_head = 0;
+  _syx_memory_finalization_pending = FALSE;
+  _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+  _syx_memory_gc_marking = FALSE;
+  syx_method_cache_flush ();
   _syx_memory_initialized = FALSE;
 }
 
@@ -187,43 +661,229 @@ syx_memory_alloc (void)
   if (_syx_freed_memory_top == 0)
     {
       syx_memory_gc ();
-      if (_syx_freed_memory_top == 0)
+      if (_syx_freed_memory_top == 0 && !_syx_memory_grow_step ())
         syx_error ("object memory heap is really full\n");
     }
 
   oop = _syx_freed_memory[--_syx_freed_memory_top];
+  _syx_memory_stats.allocated_objects++;
 
-  /* Prevent the object from being collected */
-  if (_syx_memory_gc_trans_running)
+  /* Log the object into the nursery, which is allowed to grow until the next young collection */
+  if (_syx_memory_nursery_top == _syx_memory_nursery_size)
     {
-      if (_syx_memory_gc_trans_top == 0x100)
-        syx_error ("transactions can hold up to 256 objects\n");
+      _syx_memory_nursery_size *= 2;
+      _syx_memory_nursery = (SyxOop *) syx_realloc (_syx_memory_nursery,
+                                                    _syx_memory_nursery_size * sizeof (SyxOop));
+    }
+  _syx_memory_nursery[_syx_memory_nursery_top++] = oop;
+  if (_syx_memory_nursery_top >= SYX_MEMORY_NURSERY_SIZE (_syx_memory_size))
+    _syx_memory_gc_young_requested = TRUE;
+  SYX_OBJECT_IS_YOUNG(oop) = TRUE;
+  SYX_OBJECT_IS_DIRTY(oop) = TRUE;
+
+  /* Prevent the object from being collected until the scope is closed */
+  if (_syx_memory_handle_scopes)
+    _syx_memory_list_append (&_syx_memory_handles, oop);
 
+  SYX_OBJECT_IS_MARKED(oop) = FALSE;
+
+  /* Objects allocated during an incremental collection survive it */
+  if (_syx_memory_gc_marking)
+    {
       SYX_OBJECT_IS_MARKED(oop) = TRUE;
-      _syx_memory_gc_trans[_syx_memory_gc_trans_top++] = oop;
+      _syx_memory_gc_push (oop);
     }
-  else
-    SYX_OBJECT_IS_MARKED(oop) = FALSE;
+  else if (_syx_memory_gc_phase == SYX_MEMORY_GC_SWEEPING
+           && (syx_int32) SYX_MEMORY_INDEX_OF (oop) >= _syx_memory_gc_sweep_index)
+    SYX_OBJECT_IS_MARKED(oop) = TRUE;
 
   return oop;
 }
 
+/*!
+  Open a handle scope.
 
+  Objects allocated while the scope is open, and objects saved with syx_memory_handle,
+  are not freed until the scope is closed. Scopes can be nested and must be closed in reverse order.
 
-INLINE void
-_syx_memory_gc_mark (SyxOop object)
+  
+eturn the scope to be passed to syx_memory_handle_scope_close
+*/
+SyxMemoryHandleScope
+syx_memory_handle_scope_open (void)
 {
-  syx_varsize i;
+  _syx_memory_handle_scopes++;
+  return _syx_memory_handles.top;
+}
 
-  if (!SYX_IS_OBJECT (object) || SYX_OBJECT_IS_MARKED(object) || SYX_IS_NIL(syx_object_get_class (object)))
-    return;
+/*! Close a handle scope opened with syx_memory_handle_scope_open and release its objects */
+void
+syx_memory_handle_scope_close (SyxMemoryHandleScope scope)
+{
+  _syx_memory_handles.top = scope;
+  _syx_memory_handle_scopes--;
+}
 
-  SYX_OBJECT_IS_MARKED(object) = TRUE;
+/*!
+  Prevent an object from being freed until the innermost handle scope is closed.
+
+  
+eturn the object itself
+*/
+SyxOop
+syx_memory_handle (SyxOop object)
+{
+  if (!_syx_memory_handle_scopes)
+    syx_error ("no handle scope is open\n");
+
+  _syx_memory_list_append (&_syx_memory_handles, object);
+  return object;
+}
+
+/*!
+  Add the location of a C variable to the roots of the garbage collector.
+  The object held by the variable is not freed until the location is removed with syx_memory_root_remove.
+*/
+void
+syx_memory_root_add (SyxOop *root)
+{
+  if (_syx_memory_roots_top == _syx_memory_roots_size)
+    {
+      _syx_memory_roots_size = (_syx_memory_roots_size ? _syx_memory_roots_size * 2 : 0x10);
+      _syx_memory_roots = (SyxOop **) syx_realloc (_syx_memory_roots,
+                                                   _syx_memory_roots_size * sizeof (SyxOop *));
+    }
+  _syx_memory_roots[_syx_memory_roots_top++] = root;
+}
+
+/*! Remove the location of a C variable added with syx_memory_root_add */
+void
+syx_memory_root_remove (SyxOop *root)
+{
+  syx_int32 i;
+
+  for (i=_syx_memory_roots_top - 1; i >= 0; i--)
+    {
+      if (_syx_memory_roots[i] == root)
+        {
+          _syx_memory_roots[i] = _syx_memory_roots[--_syx_memory_roots_top];
+          return;
+        }
+    }
+}
 
-  _syx_memory_gc_mark (SYX_OBJECT(object)->klass);
+/* Add a new arena to the object space */
+static void
+_syx_memory_arena_new (void)
+{
+  _syx_memory_arenas = (syx_int8 **) syx_realloc (_syx_memory_arenas,
+                                                  (_syx_memory_arenas_top + 1) * sizeof (syx_int8 *));
+  _syx_memory_arena_ptr = (syx_int8 *) syx_malloc (SYX_MEMORY_ARENA_SIZE);
+  _syx_memory_arena_end = _syx_memory_arena_ptr + SYX_MEMORY_ARENA_SIZE;
+  _syx_memory_arenas[_syx_memory_arenas_top++] = _syx_memory_arena_ptr;
+}
+
+/*!
+  Allocate a zeroed body for instance variables and data of an object.
+
+  \param size the number of bytes
+  \return a body to be released with syx_memory_body_free
+*/
+syx_pointer
+syx_memory_body_alloc (syx_size size)
+{
+  SyxMemoryChunk *chunk;
+  syx_size index;
+
+  size = SYX_MEMORY_BODY_ROUND (size);
+  _syx_memory_stats.allocated_bytes += size;
+  if (size > SYX_MEMORY_BODY_MAX)
+    {
+      chunk = (SyxMemoryChunk *) syx_malloc0 (sizeof (SyxMemoryChunk) + size);
+      chunk->size = size;
+      return chunk + 1;
+    }
+
+  index = size / sizeof (SyxMemoryChunk);
+  chunk = _syx_memory_body_free_lists[index];
+  if (chunk)
+    _syx_memory_body_free_lists[index] = chunk->next;
+  else
+    {
+      if (_syx_memory_arena_end - _syx_memory_arena_ptr < (syx_nint)(sizeof (SyxMemoryChunk) + size))
+        _syx_memory_arena_new ();
+      chunk = (SyxMemoryChunk *) _syx_memory_arena_ptr;
+      _syx_memory_arena_ptr += sizeof (SyxMemoryChunk) + size;
+    }
+
+  chunk->size = size;
+  memset (chunk + 1, '\0', size);
+  return chunk + 1;
+}
+
+/*! Release a body allocated with syx_memory_body_alloc */
+void
+syx_memory_body_free (syx_pointer body)
+{
+  SyxMemoryChunk *chunk = ((SyxMemoryChunk *) body) - 1;
+  syx_size index;
+
+  _syx_memory_stats.freed_bytes += chunk->size;
+  if (chunk->size > SYX_MEMORY_BODY_MAX)
+    {
+      /* large bodies of a mapped image are left in place */
+      if ((syx_int8 *) chunk < _syx_memory_space || (syx_int8 *) chunk >= _syx_memory_space_end)
+        syx_free (chunk);
+      return;
+    }
+
+  index = chunk->size / sizeof (SyxMemoryChunk);
+  chunk->next = _syx_memory_body_free_lists[index];
+  _syx_memory_body_free_lists[index] = chunk;
+}
+
+
+
+static void _syx_memory_gc_mark (SyxOop object, syx_bool young);
+static void _syx_memory_gc_mark_stack (syx_bool young);
+
+/* TRUE if the object has been marked, or it is not collected.
+   If young is TRUE, old objects are not collected */
+static syx_bool
+_syx_memory_gc_is_reachable (SyxOop object, syx_bool young)
+{
+  if (!SYX_IS_OBJECT (object) || SYX_MEMORY_INDEX_OF (object) < 3)
+    return TRUE;
+
+  return SYX_OBJECT_IS_MARKED (object) || (young && !SYX_OBJECT_IS_YOUNG (object));
+}
+
+/* Mark the objects referenced by a detached frame.
+   The interpreter writes into detached frames without barriers, so scan them even if they're old */
+static void
+_syx_memory_gc_mark_detached_frame (SyxOop frame, syx_bool young);
+
+/* Mark all the objects referenced by the given object.
+   If young is TRUE, only young objects are marked */
+static void
+_syx_memory_gc_mark_references (SyxOop object, syx_bool young)
+{
+  syx_varsize i;
+  SyxInterpFrame *outer_frame;
+  SyxOop klass = SYX_OBJECT_CLASS (object);
+
+  _syx_memory_gc_mark (klass, young);
+
+  /* The key of an ephemeron must be reached before anything else it refers to */
+  if (SYX_OOP_EQ (klass, syx_ephemeron_class)
+      && !_syx_memory_gc_is_reachable (SYX_ASSOCIATION_KEY (object), young))
+    {
+      _syx_memory_list_append (&_syx_memory_ephemerons, object);
+      return;
+    }
 
   /* Only the used stack part of the process must be marked */
-  if (SYX_OOP_EQ (syx_object_get_class (object), syx_process_class))
+  if (SYX_OOP_EQ (klass, syx_process_class))
     {
       SyxOop stack = SYX_PROCESS_STACK (object);
       SyxInterpFrame *frame = SYX_OOP_CAST_POINTER (SYX_PROCESS_FRAME_POINTER (object));
@@ -234,22 +894,27 @@ _syx_memory_gc_mark (SyxOop object)
 
       /* First mark variables except the process stack */
       for (i=0; i < SYX_VARS_PROCESS_STACK; i++)
-        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i]);
+        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i], young);
 
-      /* Mark detached frames */
+      /* Mark detached frames, and outer frames of the running blocks */
       while (frame)
         {
-          _syx_memory_gc_mark (frame->detached_frame);
+          _syx_memory_gc_mark_detached_frame (frame->detached_frame, young);
+          if (young)
+            {
+              for (outer_frame = frame->outer_frame; outer_frame; outer_frame = outer_frame->outer_frame)
+                _syx_memory_gc_mark_detached_frame (outer_frame->detached_frame, young);
+            }
           frame = frame->parent_frame;
         }
 
       /* Now mark the stack */
       for (i=0; i < offset; i++)
-        _syx_memory_gc_mark (SYX_OBJECT_DATA(stack)[i]);
+        _syx_memory_gc_mark (SYX_OBJECT_DATA(stack)[i], young);
 
       /* Mark variables after the process stack */
       for (i=SYX_VARS_PROCESS_STACK+1; i < syx_object_vars_size (object); i++)
-        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i]);
+        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i], young);
 
       /* Process has no data */
       return;
@@ -257,289 +922,1218 @@ _syx_memory_gc_mark (SyxOop object)
   else
     {
       for (i=0; i < syx_object_vars_size (object); i++)
-        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i]);
+        _syx_memory_gc_mark (SYX_OBJECT_VARS(object)[i], young);
     }
 
   if (SYX_OBJECT_HAS_REFS (object))
     {
+      /* Elements are cleared once the marking is done, see _syx_memory_gc_finish_marking */
+      if (SYX_OOP_EQ (klass, syx_weak_array_class))
+        {
+          _syx_memory_list_append (&_syx_memory_weak_arrays, object);
+          return;
+        }
+
       for (i=0; i < SYX_OBJECT_DATA_SIZE (object); i++)
-        _syx_memory_gc_mark (SYX_OBJECT_DATA(object)[i]);
+        _syx_memory_gc_mark (SYX_OBJECT_DATA(object)[i], young);
     }
 }
 
-/* Walk trough the memory and collect unmarked objects */
+/* Mark the object and push it into the mark stack, its references will be marked by
+   _syx_memory_gc_mark_stack. This avoids recursion on long chains of objects */
 static void
-_syx_memory_gc_sweep ()
+_syx_memory_gc_mark (SyxOop object, syx_bool young)
 {
-  SyxObject *object;
-
-  /* skip constants */
-  syx_memory[0].is_marked = FALSE;
-  syx_memory[1].is_marked = FALSE;
-  syx_memory[2].is_marked = FALSE;
+  if (!SYX_IS_OBJECT (object) || SYX_OBJECT_IS_MARKED(object) || SYX_IS_NIL(syx_object_get_class (object)))
+    return;
 
-  for (object=syx_memory+3; object <= SYX_MEMORY_TOP; object++)
-    {
-      if (SYX_IS_NIL (object->klass))
-        continue;
+  /* Old objects referring to young objects are in the remembered set */
+  if (young && !SYX_OBJECT_IS_YOUNG(object))
+    return;
 
-      if (object->is_marked)
-        object->is_marked = FALSE;
-      else
-        syx_object_free ((SyxOop) object);
-    }
+  SYX_OBJECT_IS_MARKED(object) = TRUE;
+  _syx_memory_gc_push (object);
 }
 
-/*! Calls the Syx garbage collector */
+/*! Push a marked object into the mark stack, so that its references will be marked */
 void
-syx_memory_gc (void)
+_syx_memory_gc_push (SyxOop object)
 {
-#ifdef SYX_DEBUG_GC
-  syx_int32 old_top = _syx_freed_memory_top;
-  syx_int32 reclaimed;
-#endif
-
-  /* Save the state of transactions.
-     syx_object_free can call #finalize methods, so we need another transaction */
-  syx_int32 trans_top = _syx_memory_gc_trans_top;
-  syx_int32 trans_running = _syx_memory_gc_trans_running;
-  SyxOop trans[0x100];
-  memcpy (trans, _syx_memory_gc_trans, sizeof (SyxOop) * 0x100);
-  _syx_memory_gc_trans_top = 0;
-  _syx_memory_gc_trans_running = 0;
-
-  /* Save the active process state to make sure we mark the current frame */
-  _syx_interp_save_process_state (&_syx_interp_state);
+  if (_syx_memory_mark_stack_top == _syx_memory_mark_stack_size)
+    {
+      _syx_memory_mark_stack_size = (_syx_memory_mark_stack_size ? _syx_memory_mark_stack_size * 2 : 0x1000);
+      _syx_memory_mark_stack = (SyxOop *) syx_realloc (_syx_memory_mark_stack,
+                                                       _syx_memory_mark_stack_size * sizeof (SyxOop));
+    }
+  _syx_memory_mark_stack[_syx_memory_mark_stack_top++] = object;
+}
 
-  _syx_memory_gc_mark (syx_symbols);
-  _syx_memory_gc_mark (syx_globals);
-  _syx_memory_gc_sweep ();
+/*! Mark an object during an incremental collection. Use syx_memory_write_barrier instead */
+void
+_syx_memory_gc_shade (SyxOop object)
+{
+  _syx_memory_gc_mark (object, FALSE);
+}
 
-#ifdef SYX_DEBUG_GC
-  reclaimed = _syx_freed_memory_top - old_top;
-  syx_debug ("GC: reclaimed %d (%d%%); available %d; used %d; total %d\n", reclaimed, reclaimed * 100 / _syx_memory_size, _syx_freed_memory_top, _syx_memory_size - _syx_freed_memory_top, _syx_memory_size);
-#endif
+/* Mark the references of all objects in the mark stack, until it's empty */
+static void
+_syx_memory_gc_mark_stack (syx_bool young)
+{
+  SyxOop object;
 
-  /* Restore the normal transaction */
-  _syx_memory_gc_trans_top = trans_top;
-  _syx_memory_gc_trans_running = trans_running;
-  memcpy (_syx_memory_gc_trans, trans, sizeof (SyxOop) * 0x100);
+  while (_syx_memory_mark_stack_top > 0)
+    {
+      object = _syx_memory_mark_stack[--_syx_memory_mark_stack_top];
+      /* allocated during an incremental collection, then freed */
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        _syx_memory_gc_mark_references (object, young);
+    }
 }
 
+static void
+_syx_memory_gc_mark_detached_frame (SyxOop frame, syx_bool young)
+{
+  if (young && SYX_IS_OBJECT (frame) && !SYX_OBJECT_IS_YOUNG(frame))
+    _syx_memory_gc_mark_references (frame, young);
+  else
+    _syx_memory_gc_mark (frame, young);
+}
 
+/* Mark the roots: symbols, globals, handles, C roots, objects waiting to be finalized and the process
+   of the interpreter, which is saved by collections even once it has been terminated.
+   Primitives might allocate once the receiver and the arguments have been popped from the stack */
 static void
-_syx_memory_write (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image)
+_syx_memory_gc_mark_roots (syx_bool young)
 {
-  syx_int32 i, idx;
-  SyxOop oop;
-  for (i=0; i < n; i++)
+  syx_int32 i;
+  SyxOop *stack;
+
+  _syx_memory_gc_mark (syx_symbols, young);
+  _syx_memory_gc_mark (syx_globals, young);
+  _syx_memory_gc_mark (_syx_interp_state.process, young);
+  _syx_memory_gc_mark (_syx_interp_state.message_receiver, young);
+  for (i=0; i < _syx_memory_handles.top; i++)
+    _syx_memory_gc_mark (_syx_memory_handles.oops[i], young);
+  for (i=0; i < _syx_memory_roots_top; i++)
+    _syx_memory_gc_mark (*_syx_memory_roots[i], young);
+  if (SYX_IS_OBJECT (_syx_interp_state.process)
+      && !SYX_IS_NIL (syx_object_get_class (_syx_interp_state.process)))
     {
-      oop = oops[i];
-      if (SYX_IS_OBJECT (oop))
+      stack = SYX_OBJECT_DATA (SYX_PROCESS_STACK (_syx_interp_state.process));
+      if (_syx_interp_state.message_arguments >= stack
+          && _syx_interp_state.message_arguments + _syx_interp_state.message_arguments_count
+          <= stack + SYX_OBJECT_DATA_SIZE (SYX_PROCESS_STACK (_syx_interp_state.process)))
         {
-          if (mark_type)
-            fputc (SYX_MEMORY_TYPE_OBJECT, image);
-
-          idx = SYX_MEMORY_INDEX_OF (oop);
-          idx = SYX_COMPAT_SWAP_32 (idx);
-          fwrite (&idx, sizeof (syx_int32), 1, image);
+          for (i=0; i < _syx_interp_state.message_arguments_count; i++)
+            _syx_memory_gc_mark (_syx_interp_state.message_arguments[i], young);
         }
-      else if (SYX_IS_CPOINTER (oop))
-        {
-          /* Write nil for C pointers, they must not be available when starting again the interpreter */
-          if (mark_type)
-            fputc (SYX_MEMORY_TYPE_IMMEDIATE, image);
+    }
+  for (i=_syx_memory_finalization_head; i < _syx_memory_finalization_queue.top; i++)
+    _syx_memory_gc_mark (_syx_memory_finalization_queue.oops[i], young);
+}
 
-          idx = SYX_COMPAT_SWAP_32 (0);
-          fwrite (&idx, sizeof (syx_int32), 1, image);
+/* Mark what deferred ephemerons refer to, once their keys have been reached.
+   Repeat until no more keys are reached */
+static void
+_syx_memory_gc_mark_ephemerons (syx_bool young)
+{
+  syx_int32 i, top;
+  syx_bool found = TRUE;
+  SyxOop ephemeron;
+
+  while (found)
+    {
+      found = FALSE;
+      for (i=0, top=0; i < _syx_memory_ephemerons.top; i++)
+        {
+          ephemeron = _syx_memory_ephemerons.oops[i];
+          if (_syx_memory_gc_is_reachable (SYX_ASSOCIATION_KEY (ephemeron), young))
+            {
+              _syx_memory_gc_mark (SYX_ASSOCIATION_VALUE (ephemeron), young);
+              found = TRUE;
+            }
+          else
+            _syx_memory_ephemerons.oops[top++] = ephemeron;
         }
+      _syx_memory_ephemerons.top = top;
+      _syx_memory_gc_mark_stack (young);
+    }
+}
+
+/* Called once all the strongly reachable objects have been marked.
+   Unreachable finalizable objects are moved into the finalization queue and kept alive,
+   then weak references to unreachable objects are cleared */
+static void
+_syx_memory_gc_finish_marking (syx_bool young)
+{
+  syx_int32 i, top, queued;
+  SyxOop object;
+  SyxObject *weak;
+
+  _syx_memory_gc_mark_ephemerons (young);
+
+  queued = _syx_memory_finalization_queue.top;
+  for (i=0, top=0; i < _syx_memory_finalizable.top; i++)
+    {
+      object = _syx_memory_finalizable.oops[i];
+      /* freed explicitly */
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
+
+      if (_syx_memory_gc_is_reachable (object, young))
+        _syx_memory_finalizable.oops[top++] = object;
       else
-        {
-          if (mark_type)
-            fputc (SYX_MEMORY_TYPE_IMMEDIATE, image);
+        _syx_memory_list_append (&_syx_memory_finalization_queue, object);
+    }
+  _syx_memory_finalizable.top = top;
 
-          idx = (syx_int32)oop;
-          idx = SYX_COMPAT_SWAP_32 (idx);
-          fwrite (&idx, sizeof (syx_int32), 1, image);
+  if (queued < _syx_memory_finalization_queue.top)
+    {
+      for (i=queued; i < _syx_memory_finalization_queue.top; i++)
+        _syx_memory_gc_mark (_syx_memory_finalization_queue.oops[i], young);
+      _syx_memory_gc_mark_stack (young);
+      _syx_memory_gc_mark_ephemerons (young);
+      _syx_memory_finalization_pending = TRUE;
+    }
+
+  /* The keys of the remaining ephemerons are not reachable anymore */
+  for (i=0; i < _syx_memory_ephemerons.top; i++)
+    {
+      object = _syx_memory_ephemerons.oops[i];
+      SYX_ASSOCIATION_KEY (object) = syx_nil;
+      SYX_ASSOCIATION_VALUE (object) = syx_nil;
+    }
+  _syx_memory_ephemerons.top = 0;
+
+  for (i=0; i < _syx_memory_weak_arrays.top; i++)
+    {
+      weak = SYX_OBJECT (_syx_memory_weak_arrays.oops[i]);
+      for (top=0; top < weak->data_size; top++)
+        {
+          if (!_syx_memory_gc_is_reachable (weak->data[top], young))
+            weak->data[top] = syx_nil;
         }
     }
+  _syx_memory_weak_arrays.top = 0;
 }
 
-
-/* Write the variables of a Process or of a Context, fixing the frame pointer to match a valid index
-   in the stack */
+/* Walk trough the memory and collect unmarked objects */
 static void
-_syx_memory_write_vars_with_fp (SyxObject *object, SyxVariables stack_var, SyxVariables fp_var, FILE *image)
+_syx_memory_gc_sweep ()
 {
-  SyxInterpFrame *frame = SYX_OOP_CAST_POINTER (object->vars[fp_var]);
-  SyxOop stack;
-  syx_int32 offset;
+  SyxObject *object;
 
-  if (!SYX_IS_NIL (frame->detached_frame))
+  /* skip constants */
+  syx_memory[0].is_marked = FALSE;
+  syx_memory[1].is_marked = FALSE;
+  syx_memory[2].is_marked = FALSE;
+
+  for (object=syx_memory+3; object <= SYX_MEMORY_TOP; object++)
     {
-      stack = frame->detached_frame;
-      offset = 0;
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
+
+      if (object->is_marked)
+        object->is_marked = FALSE;
+      else
+        syx_object_free ((SyxOop) object);
     }
-  else
+}
+
+/* Sweep objects from where the incremental collection left, until the deadline in microseconds.
+   Returns TRUE once the whole memory has been swept. A zero deadline sweeps everything */
+static syx_bool
+_syx_memory_gc_sweep_slice (syx_uint64 deadline)
+{
+  SyxObject *object;
+
+  while (_syx_memory_gc_sweep_index < _syx_memory_size)
     {
-      stack = object->vars[stack_var];
-      offset = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, SYX_OBJECT_DATA (stack)));
+      if (deadline && _syx_memory_gc_sweep_index % SYX_MEMORY_SLICE_CHECK == 0
+          && syx_nanotime () / 1000 >= deadline)
+        return FALSE;
+
+      object = &syx_memory[_syx_memory_gc_sweep_index++];
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
+
+      if (object->is_marked)
+        object->is_marked = FALSE;
+      else
+        syx_object_free ((SyxOop) object);
     }
 
-  /* Write all variables before FRAME_POINTER */
-  _syx_memory_write (object->vars, TRUE, fp_var, image);
-  /* Now specify our own type for frame pointers */
-  fputc (SYX_MEMORY_TYPE_FRAME_POINTER, image);
-  /* We have to store the stack OOP in order to point to the right stack when loading back the image */
-  _syx_memory_write (&stack, FALSE, 1, image);
-  fwrite (&offset, sizeof (syx_int32), 1, image);
-  /* Let's store the remaining variables */
-  _syx_memory_write (object->vars + fp_var + 1, TRUE,
-                     syx_object_vars_size ((SyxOop)object) - fp_var - 1, image);
+  return TRUE;
 }
 
-/* Dump the header of the object with variables */
-static void
-_syx_memory_write_object_with_vars (SyxObject *object, FILE *image)
+/* Mark objects in the mark stack until the deadline in microseconds.
+   Returns TRUE once the stack is empty */
+static syx_bool
+_syx_memory_gc_mark_slice (syx_uint64 deadline)
 {
-  syx_int32 data;
+  syx_int32 count;
+  SyxOop object;
 
-  _syx_memory_write ((SyxOop *)&object, FALSE, 1, image);
-  _syx_memory_write (&object->klass, FALSE, 1, image);
-  fputc (object->has_refs, image);
-  fputc (object->is_constant, image);
+  for (count=1; _syx_memory_mark_stack_top > 0; count++)
+    {
+      if (count % SYX_MEMORY_SLICE_CHECK == 0 && syx_nanotime () / 1000 >= deadline)
+        return FALSE;
 
-  data = syx_object_vars_size ((SyxOop)object);
-  data = SYX_COMPAT_SWAP_32(data);
-  fwrite (&data, sizeof (syx_int32), 1, image);
+      object = _syx_memory_mark_stack[--_syx_memory_mark_stack_top];
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        _syx_memory_gc_mark_references (object, FALSE);
+    }
 
-  /* store instance variables, keep an eye on special cases */
-  if ((SYX_OOP_EQ (object->klass, syx_block_context_class) ||
-       SYX_OOP_EQ (object->klass, syx_method_context_class))
-      && !SYX_IS_NIL (object->vars[SYX_VARS_CONTEXT_PART_STACK]))
-    _syx_memory_write_vars_with_fp (object, SYX_VARS_CONTEXT_PART_STACK, SYX_VARS_CONTEXT_PART_FRAME_POINTER, image);
-  else if (SYX_OOP_EQ (object->klass, syx_process_class)
-           && !SYX_IS_NIL (object->vars[SYX_VARS_PROCESS_STACK]))
-    _syx_memory_write_vars_with_fp (object, SYX_VARS_PROCESS_STACK, SYX_VARS_PROCESS_FRAME_POINTER, image);
-  else
-    _syx_memory_write (object->vars, TRUE, SYX_COMPAT_SWAP_32(data), image);
+  return TRUE;
 }
 
-/* Writes a single entry of the frame that points to another frame */
+/* Mark again the references of a marked process, its detached frames and the outer frames of its blocks */
 static void
-_syx_memory_write_lazy_pointer (SyxObject *process, SyxInterpFrame *frame, FILE *image)
+_syx_memory_gc_remark_process (SyxOop process)
 {
-  SyxOop stack;
-  syx_int32 offset;
-  if (frame && !SYX_IS_NIL (frame->detached_frame))
-    stack = frame->detached_frame;
-  else if (!process || !frame)
-    stack = syx_nil; /* this will be encoded as 0 */
-  else
-    stack = process->vars[SYX_VARS_PROCESS_STACK];
+  SyxInterpFrame *frame, *outer_frame;
 
-  _syx_memory_write (&stack, FALSE, 1, image);
-  offset = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, SYX_OBJECT_DATA (stack)));
-
-  fwrite (&offset, sizeof (syx_int32), 1, image);
+  _syx_memory_gc_mark_references (process, FALSE);
+  for (frame = SYX_OOP_CAST_POINTER (SYX_PROCESS_FRAME_POINTER (process)); frame; frame = frame->parent_frame)
+    {
+      for (outer_frame = frame; outer_frame; outer_frame = outer_frame->outer_frame)
+        {
+          if (!SYX_IS_NIL (outer_frame->detached_frame))
+            _syx_memory_gc_mark_references (outer_frame->detached_frame, FALSE);
+        }
+    }
 }
 
-/* Dump a single frame */
+/* End the marking of an incremental collection.
+   The interpreter writes into processes without barriers, so mark them again.
+   Young processes are in the nursery, old ones are always remembered */
 static void
-_syx_memory_write_frame (SyxObject *process, SyxInterpFrame *frame, SyxInterpFrame *upper_frame, FILE *image)
+_syx_memory_gc_remark (void)
 {
-  syx_int32 data;
-  SyxInterpFrame *bottom_frame;
+  syx_int32 i;
+  SyxOop object;
 
-  if (!process)
-    bottom_frame = NULL;
-  else
-    bottom_frame = (SyxInterpFrame *)SYX_OBJECT_DATA (process->vars[SYX_VARS_PROCESS_STACK]);
+  _syx_interp_save_process_state (&_syx_interp_state);
 
-  _syx_memory_write (&frame->this_context, FALSE, 1, image);
-  _syx_memory_write (&frame->detached_frame, FALSE, 1, image);
-  _syx_memory_write_lazy_pointer (process, frame->parent_frame, image);
-  _syx_memory_write_lazy_pointer (process, frame->outer_frame, image);
-  _syx_memory_write_lazy_pointer (process, frame->stack_return_frame, image);
-  _syx_memory_write (&frame->method, FALSE, 1, image);
-  _syx_memory_write (&frame->closure, FALSE, 1, image);
-  /* this is not a SmallInteger */
-  data = SYX_COMPAT_SWAP_32 (frame->next_instruction);
-  fwrite (&data, sizeof (syx_int32), 1, image);
-  /* the stack pointer should point inside the process stack itself */
-  if (process)
-    _syx_memory_write (&process->vars[SYX_VARS_PROCESS_STACK], FALSE, 1, image);
-  else
+  _syx_memory_gc_mark_roots (FALSE);
+  if (SYX_IS_OBJECT (syx_processor))
+    _syx_memory_gc_mark_references (syx_processor, FALSE);
+
+  for (i=0; i < _syx_memory_remembered_top; i++)
     {
-      data = SYX_COMPAT_SWAP_32 (0);
-      fwrite (&data, sizeof (syx_int32), 1, image);
+      object = _syx_memory_remembered[i];
+      if (SYX_OBJECT_IS_REMEMBERED (object) && SYX_OBJECT_IS_MARKED (object)
+          && SYX_OOP_EQ (syx_object_get_class (object), syx_process_class))
+        _syx_memory_gc_remark_process (object);
     }
-  data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame->stack, bottom_frame));
-  fwrite (&data, sizeof (syx_int32), 1, image);
-  _syx_memory_write (&frame->receiver, TRUE, 1, image);
-  /* Store arguments, temporaries and local stack.
-     Only copy arguments and temporaries for detached frames without following the stack pointer */
-  if (SYX_IS_NIL (frame->detached_frame))
+
+  for (i=0; i < _syx_memory_nursery_top; i++)
     {
-      /* if no upper_frame is given, this frame is the top most frame of the process stack */
-      if (!upper_frame)
-        data = SYX_POINTERS_OFFSET (frame->stack, &frame->local);
-      else
-        data = SYX_POINTERS_OFFSET (upper_frame, &frame->local);
+      object = _syx_memory_nursery[i];
+      if (SYX_OBJECT_IS_YOUNG (object) && SYX_OBJECT_IS_MARKED (object)
+          && SYX_OOP_EQ (syx_object_get_class (object), syx_process_class))
+        _syx_memory_gc_remark_process (object);
     }
-  else
-    data = SYX_OBJECT_DATA_SIZE (frame->detached_frame) - SYX_POINTERS_OFFSET (&frame->local, frame);
-  data = SYX_COMPAT_SWAP_32 (data);
-  fwrite (&data, sizeof (syx_int32), 1, image);
-  _syx_memory_write (&frame->local, TRUE, SYX_COMPAT_SWAP_32 (data), image);
+
+  _syx_memory_gc_mark_stack (FALSE);
+  _syx_memory_gc_finish_marking (FALSE);
+
+  _syx_memory_gc_marking = FALSE;
+  _syx_memory_gc_phase = SYX_MEMORY_GC_SWEEPING;
+  _syx_memory_gc_sweep_index = 3;
+
+  /* skip constants */
+  syx_memory[0].is_marked = FALSE;
+  syx_memory[1].is_marked = FALSE;
+  syx_memory[2].is_marked = FALSE;
 }
 
-/* Dump the whole stack of the process.
-   This will also dump relative objects containing stack, like block closure outerFrames. */
+/* Account a pause of the garbage collector started at the given time in microseconds */
+static syx_uint64
+_syx_memory_gc_pause_end (syx_uint64 start)
+{
+  syx_uint64 pause = syx_nanotime () / 1000 - start;
+  syx_uint64 limit;
+  syx_int32 bucket;
+
+  if (pause > _syx_memory_gc_pause_max)
+    _syx_memory_gc_pause_max = pause;
+  _syx_memory_gc_pause_total += pause;
+  _syx_memory_gc_pauses++;
+
+  for (bucket=0, limit=100; bucket < SYX_MEMORY_PAUSE_BUCKETS - 1 && pause >= limit; bucket++, limit *= 10);
+  _syx_memory_stats.pauses[bucket]++;
+
+  return pause;
+}
+
+/* Account a collection and write it to the log */
 static void
-_syx_memory_write_process_stack (SyxObject *process, FILE *image)
+_syx_memory_gc_collected (syx_symbol kind, syx_uint64 pause, syx_int32 reclaimed)
 {
-  syx_int32 data;
-  SyxObject *stack = SYX_OBJECT (process->vars[SYX_VARS_PROCESS_STACK]);
-  SyxInterpFrame *bottom_frame = (SyxInterpFrame *)stack->data;
-  SyxInterpFrame *frame = SYX_OOP_CAST_POINTER (process->vars[SYX_VARS_PROCESS_FRAME_POINTER]);
-  SyxInterpFrame *upper_frame = NULL;
-  SyxOop *oop;
+  _syx_memory_stats.reclaimed_objects += reclaimed;
 
-  if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)))
+  if (!_syx_memory_log)
     return;
 
-  _syx_memory_write_object_with_vars (stack, image);
+  fprintf (_syx_memory_log, "%s: pause %luus; reclaimed %d; used %d; total %d\n", kind,
+           (unsigned long) pause, reclaimed, _syx_memory_size - _syx_freed_memory_top, _syx_memory_size);
+  fflush (_syx_memory_log);
+}
 
-  /* store data size */
-  data = SYX_COMPAT_SWAP_32 (stack->data_size);
-  fwrite (&data, sizeof (syx_varsize), 1, image);
-  /* We have to do things in reverse order because the stack is such a reverse single linked list,
-     each frame connected by parent frames */
-  while (frame)
+/* Keep only the young objects logged in the nursery from the given index */
+static void
+_syx_memory_nursery_compact (syx_int32 start)
+{
+  syx_int32 i, top;
+
+  for (i=start, top=0; i < _syx_memory_nursery_top; i++)
     {
-      /* We store detached frames later */
-      if (!SYX_IS_NIL (frame->detached_frame))
+      if (SYX_OBJECT_IS_YOUNG (_syx_memory_nursery[i]))
+        _syx_memory_nursery[top++] = _syx_memory_nursery[i];
+    }
+
+  _syx_memory_nursery_top = top;
+  _syx_memory_gc_young_requested = (top >= SYX_MEMORY_NURSERY_SIZE (_syx_memory_size));
+}
+
+/* Forget freed objects and duplicates in the remembered set.
+   Objects before forget_top are forgotten too, except processes */
+static void
+_syx_memory_remembered_compact (syx_int32 forget_top)
+{
+  syx_int32 i, top;
+  SyxOop object;
+
+  for (i=0, top=0; i < _syx_memory_remembered_top; i++)
+    {
+      object = _syx_memory_remembered[i];
+      if (!SYX_OBJECT_IS_REMEMBERED (object) || SYX_OBJECT_IS_MARKED (object))
+        continue;
+
+      if (i < forget_top && SYX_OOP_NE (syx_object_get_class (object), syx_process_class))
         {
-          frame = frame->parent_frame;
+          SYX_OBJECT_IS_REMEMBERED (object) = FALSE;
           continue;
         }
 
-      /* Store the index of this frame */
-      fputc (SYX_MEMORY_TYPE_BOF, image);
-      data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, bottom_frame));
-      fwrite (&data, sizeof (syx_varsize), 1, image);
-      _syx_memory_write_frame (process, frame, NULL, image);
-      upper_frame = frame;
-      frame = frame->parent_frame;
+      /* use the mark to skip duplicates */
+      SYX_OBJECT_IS_MARKED (object) = TRUE;
+      _syx_memory_remembered[top++] = object;
     }
-  fputc (SYX_MEMORY_TYPE_EOS, image);
-  /* We have to store the rest of objects, for detached frames, up to the upper frame.
-     What we need is only the local stacks, but we don't know where they begin, so just skip C pointers */
-  if (upper_frame)
-    {
-      data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (upper_frame, bottom_frame));
-      fwrite (&data, sizeof (syx_int32), 1, image);
+
+  _syx_memory_remembered_top = top;
+  for (i=0; i < top; i++)
+    SYX_OBJECT_IS_MARKED (_syx_memory_remembered[i]) = FALSE;
+}
+
+/*! Insert an old object into the remembered set. Use syx_memory_remember instead */
+void
+_syx_memory_remember (SyxOop object)
+{
+  if (_syx_memory_remembered_top == _syx_memory_remembered_size)
+    {
+      _syx_memory_remembered_size *= 2;
+      _syx_memory_remembered = (SyxOop *) syx_realloc (_syx_memory_remembered,
+                                                       _syx_memory_remembered_size * sizeof (SyxOop));
+    }
+
+  SYX_OBJECT_IS_REMEMBERED (object) = TRUE;
+  _syx_memory_remembered[_syx_memory_remembered_top++] = object;
+}
+
+/*!
+  Collect young objects.
+
+  Only young objects are marked, starting from the roots, the processor and the remembered set.
+  Then the nursery is swept and survivors become old.
+  Nothing is done while a handle scope is open, because C functions are still building young objects,
+  or during an incremental collection.
+*/
+void
+syx_memory_gc_young (void)
+{
+  syx_int32 i, top, remembered_top;
+  SyxOop object;
+  syx_uint64 start, pause;
+  syx_int32 old_top = _syx_freed_memory_top;
+
+  /* An incremental collection uses the marks of young objects too */
+  if (_syx_memory_gc_running || _syx_memory_handle_scopes || _syx_memory_gc_phase != SYX_MEMORY_GC_IDLE)
+    return;
+
+  start = syx_nanotime () / 1000;
+  _syx_memory_gc_running = TRUE;
+
+  /* Save the active process state to make sure we mark the current frame */
+  _syx_interp_save_process_state (&_syx_interp_state);
+
+  /* The active process is stored into the processor without barriers */
+  _syx_memory_gc_mark_roots (TRUE);
+  if (SYX_IS_OBJECT (syx_processor))
+    _syx_memory_gc_mark_references (syx_processor, TRUE);
+
+  remembered_top = _syx_memory_remembered_top;
+  for (i=0; i < remembered_top; i++)
+    {
+      object = _syx_memory_remembered[i];
+      if (SYX_OBJECT_IS_REMEMBERED (object))
+        _syx_memory_gc_mark_references (object, TRUE);
+    }
+  _syx_memory_gc_mark_stack (TRUE);
+  _syx_memory_gc_finish_marking (TRUE);
+
+  top = _syx_memory_nursery_top;
+
+  for (i=0; i < top; i++)
+    {
+      object = _syx_memory_nursery[i];
+      /* freed, or logged twice */
+      if (!SYX_OBJECT_IS_YOUNG (object))
+        continue;
+
+      /* skip constants */
+      if (SYX_OBJECT_IS_MARKED (object) || SYX_MEMORY_INDEX_OF (object) < 3)
+        {
+          SYX_OBJECT_IS_MARKED (object) = FALSE;
+          SYX_OBJECT_IS_YOUNG (object) = FALSE;
+          /* The interpreter doesn't use barriers on process stacks */
+          if (SYX_OOP_EQ (syx_object_get_class (object), syx_process_class))
+            _syx_memory_remember (object);
+        }
+      else
+        syx_object_free (object);
+    }
+
+  _syx_memory_nursery_compact (top);
+  _syx_memory_remembered_compact (remembered_top);
+  _syx_memory_gc_running = FALSE;
+
+  /* Freed oops can be reused for new classes */
+  syx_method_cache_flush ();
+  pause = _syx_memory_gc_pause_end (start);
+  _syx_memory_stats.young_collections++;
+  _syx_memory_gc_collected ("young", pause, _syx_freed_memory_top - old_top);
+
+#ifdef SYX_DEBUG_GC
+  syx_debug ("GC: young reclaimed %d; remembered %d\n", _syx_freed_memory_top - old_top,
+             _syx_memory_remembered_top);
+#endif
+}
+
+/*! Calls the Syx garbage collector */
+void
+syx_memory_gc (void)
+{
+  syx_int32 old_top = _syx_freed_memory_top;
+  syx_int32 reclaimed;
+  syx_bool running;
+  syx_uint64 start = syx_nanotime () / 1000;
+  syx_uint64 pause;
+
+  /* Save the active process state to make sure we mark the current frame */
+  _syx_interp_save_process_state (&_syx_interp_state);
+
+  /* Young collections must not run in the middle of the sweep */
+  running = _syx_memory_gc_running;
+  _syx_memory_gc_running = TRUE;
+
+  /* Finish an incremental collection. Objects it marked are still reachable */
+  if (_syx_memory_gc_phase == SYX_MEMORY_GC_MARKING)
+    _syx_memory_gc_remark ();
+  else if (_syx_memory_gc_phase == SYX_MEMORY_GC_SWEEPING)
+    _syx_memory_gc_sweep_slice (0);
+  _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+
+  _syx_memory_gc_mark_roots (FALSE);
+  _syx_memory_gc_mark_stack (FALSE);
+  _syx_memory_gc_finish_marking (FALSE);
+  _syx_memory_gc_sweep ();
+  _syx_memory_gc_running = running;
+
+  /* Survivors keep their generation, they might be still filled by C functions.
+     Forget freed objects */
+  _syx_memory_nursery_compact (0);
+  _syx_memory_remembered_compact (0);
+  reclaimed = _syx_freed_memory_top - old_top;
+  _syx_memory_resize ();
+
+  /* Freed oops can be reused for new classes */
+  syx_method_cache_flush ();
+
+#ifdef SYX_DEBUG_GC
+  syx_debug ("GC: reclaimed %d (%d%%); available %d; used %d; total %d\n", reclaimed, reclaimed * 100 / _syx_memory_size, _syx_freed_memory_top, _syx_memory_size - _syx_freed_memory_top, _syx_memory_size);
+#endif
+
+  pause = _syx_memory_gc_pause_end (start);
+  _syx_memory_stats.full_collections++;
+  _syx_memory_gc_collected ("full", pause, reclaimed);
+}
+
+/*!
+  Register an object whose class requests finalization.
+
+  Once the object is not reachable anymore, the garbage collector puts it into the finalization queue
+  instead of freeing it.
+*/
+void
+syx_memory_finalization_register (SyxOop object)
+{
+  _syx_memory_list_append (&_syx_memory_finalizable, object);
+}
+
+/*!
+  Remove the next object from the finalization queue.
+
+  
+eturn the object to be finalized, or nil if the queue is empty
+*/
+SyxOop
+syx_memory_finalization_next (void)
+{
+  SyxOop object;
+
+  if (_syx_memory_finalization_head == _syx_memory_finalization_queue.top)
+    return syx_nil;
+
+  object = _syx_memory_finalization_queue.oops[_syx_memory_finalization_head++];
+  _syx_memory_stats.finalized_objects++;
+  if (_syx_memory_finalization_head == _syx_memory_finalization_queue.top)
+    _syx_memory_finalization_head = _syx_memory_finalization_queue.top = 0;
+
+  return object;
+}
+
+/* Schedule a process sending #finalizeObjects to ObjectMemory, which drains the finalization queue */
+static void
+_syx_memory_finalization_schedule (void)
+{
+  SyxOop object_memory, process, context;
+
+  _syx_memory_finalization_pending = FALSE;
+  object_memory = syx_globals_at_if_absent ("ObjectMemory", syx_nil);
+  if (SYX_IS_NIL (object_memory))
+    return;
+
+  process = syx_process_new ();
+  context = syx_send_unary_message (object_memory, "finalizeObjects");
+  syx_interp_enter_context (process, context);
+  SYX_PROCESS_SUSPENDED (process) = syx_false;
+}
+
+/*!
+  Do a slice of an incremental collection, if incremental mode is enabled.
+
+  A new collection starts once free objects are running out. The slice marks or sweeps objects
+  until the pause budget is exhausted, then processes run for at least the same time before the next slice.
+  The scheduler calls this between processes.
+
+  This also schedules a finalizer process once collected objects are waiting to be finalized.
+*/
+void
+syx_memory_gc_step (void)
+{
+  syx_uint64 start, deadline;
+  syx_int32 old_top;
+  syx_bool done = FALSE;
+
+  if (_syx_memory_gc_running)
+    return;
+
+  if (_syx_memory_finalization_pending)
+    _syx_memory_finalization_schedule ();
+
+  if (_syx_memory_handle_scopes)
+    return;
+
+  if (_syx_memory_gc_phase == SYX_MEMORY_GC_IDLE
+      && (!_syx_memory_gc_incremental
+          || _syx_freed_memory_top > SYX_MEMORY_INCREMENTAL_THRESHOLD (_syx_memory_size)))
+    return;
+
+  /* Let processes run at least as long as a slice */
+  start = syx_nanotime () / 1000;
+  if (start < _syx_memory_gc_slice_end + _syx_memory_gc_pause_budget)
+    return;
+
+  deadline = start + _syx_memory_gc_pause_budget;
+  _syx_memory_gc_running = TRUE;
+
+  if (_syx_memory_gc_phase == SYX_MEMORY_GC_IDLE)
+    {
+      _syx_memory_gc_phase = SYX_MEMORY_GC_MARKING;
+      _syx_memory_gc_marking = TRUE;
+      _syx_memory_gc_cycle_pause = 0;
+      _syx_memory_gc_cycle_reclaimed = 0;
+      _syx_memory_gc_mark_roots (FALSE);
+    }
+
+  if (_syx_memory_gc_phase == SYX_MEMORY_GC_MARKING && _syx_memory_gc_mark_slice (deadline))
+    _syx_memory_gc_remark ();
+
+  if (_syx_memory_gc_phase == SYX_MEMORY_GC_SWEEPING)
+    {
+      old_top = _syx_freed_memory_top;
+      done = _syx_memory_gc_sweep_slice (deadline);
+      _syx_memory_gc_cycle_reclaimed += _syx_freed_memory_top - old_top;
+      if (done)
+        {
+          _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+          _syx_memory_nursery_compact (0);
+          _syx_memory_remembered_compact (0);
+          _syx_memory_resize ();
+
+#ifdef SYX_DEBUG_GC
+          syx_debug ("GC: incremental collection done; available %d; max pause %d\n", _syx_freed_memory_top,
+                     (syx_int32) _syx_memory_gc_pause_max);
+#endif
+        }
+
+      /* Freed oops can be reused for new classes */
+      syx_method_cache_flush ();
+    }
+
+  _syx_memory_gc_running = FALSE;
+  _syx_memory_gc_cycle_pause += _syx_memory_gc_pause_end (start);
+  _syx_memory_gc_slice_end = syx_nanotime () / 1000;
+
+  /* The log tells the pauses of all the slices */
+  if (done)
+    {
+      _syx_memory_stats.incremental_collections++;
+      _syx_memory_gc_collected ("incremental", _syx_memory_gc_cycle_pause, _syx_memory_gc_cycle_reclaimed);
+    }
+}
+
+/*! Enable or disable incremental collections made by syx_memory_gc_step */
+void
+syx_memory_gc_set_incremental (syx_bool incremental)
+{
+  _syx_memory_gc_incremental = incremental;
+}
+
+/*! Returns TRUE if incremental collections are enabled */
+syx_bool
+syx_memory_gc_is_incremental (void)
+{
+  return _syx_memory_gc_incremental;
+}
+
+/*! Set the maximum time in microseconds of a slice of an incremental collection */
+void
+syx_memory_gc_set_pause_budget (syx_uint32 usecs)
+{
+  _syx_memory_gc_pause_budget = usecs;
+}
+
+/*! Returns the maximum time in microseconds of a slice of an incremental collection */
+syx_uint32
+syx_memory_gc_get_pause_budget (void)
+{
+  return _syx_memory_gc_pause_budget;
+}
+
+/*! Returns the longest pause in microseconds made by the garbage collector */
+syx_uint64
+syx_memory_gc_get_max_pause (void)
+{
+  return _syx_memory_gc_pause_max;
+}
+
+/*! Returns the average pause in microseconds made by the garbage collector */
+syx_uint64
+syx_memory_gc_get_average_pause (void)
+{
+  if (!_syx_memory_gc_pauses)
+    return 0;
+
+  return _syx_memory_gc_pause_total / _syx_memory_gc_pauses;
+}
+
+/*!
+  Set the maximum number of objects the memory can grow to.
+
+  Once the memory has been initialized, the maximum can't be raised beyond the size reserved
+  for the object table, which is the maximum set before initializing.
+  The table never holds more than 2^SYX_OBJECT_CLASS_BITS objects.
+*/
+void
+syx_memory_set_max_size (syx_int32 size)
+{
+  if (_syx_memory_initialized && size > _syx_memory_capacity)
+    size = _syx_memory_capacity;
+  if (size > SYX_MEMORY_LIMIT)
+    size = SYX_MEMORY_LIMIT;
+
+  _syx_memory_max_size = size;
+}
+
+/*! Returns the maximum number of objects the memory can grow to */
+syx_int32
+syx_memory_get_max_size (void)
+{
+  if (_syx_memory_initialized && _syx_memory_max_size < _syx_memory_size)
+    return _syx_memory_size;
+
+  return _syx_memory_max_size;
+}
+
+/*!
+  Set the percentage of used objects after a full collection above which the memory grows.
+  Zero grows the memory only when it's full.
+*/
+void
+syx_memory_set_grow_threshold (syx_int32 percent)
+{
+  _syx_memory_grow_threshold = percent;
+}
+
+/*! Returns the percentage of used objects after a full collection above which the memory grows */
+syx_int32
+syx_memory_get_grow_threshold (void)
+{
+  return _syx_memory_grow_threshold;
+}
+
+/*!
+  Set the percentage of used objects after a full collection below which the memory shrinks.
+  The memory never shrinks below its initial size. Zero disables shrinking.
+*/
+void
+syx_memory_set_shrink_threshold (syx_int32 percent)
+{
+  _syx_memory_shrink_threshold = percent;
+}
+
+/*! Returns the percentage of used objects after a full collection below which the memory shrinks */
+syx_int32
+syx_memory_get_shrink_threshold (void)
+{
+  return _syx_memory_shrink_threshold;
+}
+
+/*! Fill the given structure with the statistics of the memory */
+void
+syx_memory_get_stats (SyxMemoryStats *stats)
+{
+  *stats = _syx_memory_stats;
+  stats->max_pause = _syx_memory_gc_pause_max;
+  stats->average_pause = syx_memory_gc_get_average_pause ();
+  stats->size = _syx_memory_size;
+  stats->used = _syx_memory_size - _syx_freed_memory_top;
+}
+
+/*!
+  Write a line into a file for each collection, telling its kind, its pause and the used memory.
+
+  \param path the file to append lines to, or NULL to stop logging
+  \return FALSE if the file couldn't be opened
+*/
+syx_bool
+syx_memory_set_log (syx_symbol path)
+{
+  if (_syx_memory_log)
+    fclose (_syx_memory_log);
+  _syx_memory_log = NULL;
+
+  if (!path)
+    return TRUE;
+
+  _syx_memory_log = fopen (path, "a");
+  return _syx_memory_log != NULL;
+}
+
+/*!
+  Count the instances of a class. Unreachable objects are counted until they are collected.
+*/
+syx_int32
+syx_memory_count_instances (SyxOop klass)
+{
+  SyxObject *object;
+  syx_int32 count = 0;
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (SYX_OBJECT_CLASS (object) == klass)
+        count++;
+    }
+
+  return count;
+}
+
+/*!
+  Count the instances of all classes. Unreachable objects are counted until they are collected.
+
+  \return an array indexed by SYX_MEMORY_INDEX_OF of classes, to be freed with syx_free
+*/
+syx_int32 *
+syx_memory_count_all_instances (void)
+{
+  SyxObject *object;
+  syx_int32 *counts = (syx_int32 *) syx_calloc (_syx_memory_size, sizeof (syx_int32));
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (!SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        counts[object->class_index]++;
+    }
+
+  return counts;
+}
+
+
+#define SYX_MEMORY_BUFFER_INITIAL_SIZE 0x100000
+
+/* Make room for size more bytes to be written into the buffer */
+static void
+_syx_memory_buffer_reserve (SyxMemoryBuffer *buffer, syx_nint size)
+{
+  syx_nint new_size;
+
+  if (buffer->top + size <= buffer->size)
+    return;
+
+  new_size = buffer->size ? buffer->size : SYX_MEMORY_BUFFER_INITIAL_SIZE;
+  while (new_size < buffer->top + size)
+    new_size *= 2;
+
+  buffer->data = (syx_int8 *) syx_realloc (buffer->data, new_size);
+  buffer->size = new_size;
+}
+
+static void
+_syx_memory_buffer_write (SyxMemoryBuffer *buffer, const void *ptr, syx_nint size)
+{
+  _syx_memory_buffer_reserve (buffer, size);
+  memcpy (buffer->data + buffer->top, ptr, size);
+  buffer->top += size;
+}
+
+static void
+_syx_memory_buffer_put (SyxMemoryBuffer *buffer, syx_int8 byte)
+{
+  _syx_memory_buffer_reserve (buffer, 1);
+  buffer->data[buffer->top++] = byte;
+}
+
+/* Write the pending bytes of the buffer to the file and empty it */
+static syx_bool
+_syx_memory_buffer_flush (SyxMemoryBuffer *buffer, FILE *file)
+{
+  syx_bool ret = TRUE;
+
+  if (buffer->top > 0 && fwrite (buffer->data, buffer->top, 1, file) != 1)
+    ret = FALSE;
+  buffer->top = 0;
+  return ret;
+}
+
+/* Returns FALSE if the buffer has not enough bytes left */
+static syx_bool
+_syx_memory_buffer_read (SyxMemoryBuffer *buffer, void *ptr, syx_nint size)
+{
+  if (buffer->top + size > buffer->size)
+    {
+      buffer->top = buffer->size;
+      return FALSE;
+    }
+
+  memcpy (ptr, buffer->data + buffer->top, size);
+  buffer->top += size;
+  return TRUE;
+}
+
+/* Returns EOF at the end of the buffer */
+static int
+_syx_memory_buffer_get (SyxMemoryBuffer *buffer)
+{
+  if (buffer->top >= buffer->size)
+    return EOF;
+
+  return (syx_uint8) buffer->data[buffer->top++];
+}
+
+/* Fill the buffer with the content of the file from the given offset */
+static syx_bool
+_syx_memory_buffer_fill (SyxMemoryBuffer *buffer, FILE *file, long offset)
+{
+  long size;
+
+  buffer->data = NULL;
+  buffer->size = buffer->top = 0;
+
+  if (fseek (file, 0, SEEK_END) || (size = ftell (file) - offset) < 0 || fseek (file, offset, SEEK_SET))
+    return FALSE;
+
+  if (!size)
+    return TRUE;
+
+  buffer->data = (syx_int8 *) syx_malloc (size);
+  if (fread (buffer->data, size, 1, file) != 1)
+    {
+      syx_free (buffer->data);
+      buffer->data = NULL;
+      return FALSE;
+    }
+
+  buffer->size = size;
+  return TRUE;
+}
+
+static void
+_syx_memory_write (SyxOop *oops, syx_bool mark_type, syx_varsize n, SyxMemoryBuffer *image)
+{
+  syx_int32 i, idx;
+  syx_nint value;
+  SyxOop oop;
+
+  /* the longest value is a wide integer, a type and two words */
+  _syx_memory_buffer_reserve (image, n * (1 + 2 * sizeof (syx_int32)));
+
+  for (i=0; i < n; i++)
+    {
+      oop = oops[i];
+      if (SYX_IS_OBJECT (oop))
+        {
+          if (mark_type)
+            _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_OBJECT);
+
+          idx = SYX_MEMORY_INDEX_OF (oop);
+          idx = SYX_COMPAT_SWAP_32 (idx);
+          _syx_memory_buffer_write (image, &idx, sizeof (syx_int32));
+        }
+      else if (SYX_IS_CPOINTER (oop))
+        {
+          /* Write nil for C pointers, they must not be available when starting again the interpreter */
+          if (mark_type)
+            _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_IMMEDIATE);
+
+          idx = SYX_COMPAT_SWAP_32 (0);
+          _syx_memory_buffer_write (image, &idx, sizeof (syx_int32));
+        }
+      else if (mark_type && (SyxOop)(syx_int32)oop != oop)
+        {
+          /* Store the value of SmallIntegers of 64-bit hosts, the high word first */
+          _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_WIDE_INTEGER);
+
+          value = SYX_SMALL_INTEGER (oop);
+          idx = SYX_COMPAT_SWAP_32 ((syx_int32)((value >> 16) >> 16));
+          _syx_memory_buffer_write (image, &idx, sizeof (syx_int32));
+          idx = SYX_COMPAT_SWAP_32 ((syx_int32)(value & 0xFFFFFFFF));
+          _syx_memory_buffer_write (image, &idx, sizeof (syx_int32));
+        }
+      else
+        {
+          if (mark_type)
+            _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_IMMEDIATE);
+
+          idx = (syx_int32)oop;
+          idx = SYX_COMPAT_SWAP_32 (idx);
+          _syx_memory_buffer_write (image, &idx, sizeof (syx_int32));
+        }
+    }
+}
+
+
+/* Write the variables of a Process or of a Context, fixing the frame pointer to match a valid index
+   in the stack */
+static void
+_syx_memory_write_vars_with_fp (SyxObject *object, SyxVariables stack_var, SyxVariables fp_var, SyxMemoryBuffer *image)
+{
+  SyxInterpFrame *frame = SYX_OOP_CAST_POINTER (object->vars[fp_var]);
+  SyxOop stack;
+  syx_int32 offset;
+
+  if (!SYX_IS_NIL (frame->detached_frame))
+    {
+      stack = frame->detached_frame;
+      offset = 0;
+    }
+  else
+    {
+      stack = object->vars[stack_var];
+      offset = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, SYX_OBJECT_DATA (stack)));
+    }
+
+  /* Write all variables before FRAME_POINTER */
+  _syx_memory_write (object->vars, TRUE, fp_var, image);
+  /* Now specify our own type for frame pointers */
+  _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_FRAME_POINTER);
+  /* We have to store the stack OOP in order to point to the right stack when loading back the image */
+  _syx_memory_write (&stack, FALSE, 1, image);
+  _syx_memory_buffer_write (image, &offset, sizeof (syx_int32));
+  /* Let's store the remaining variables */
+  _syx_memory_write (object->vars + fp_var + 1, TRUE,
+                     syx_object_vars_size ((SyxOop)object) - fp_var - 1, image);
+}
+
+/* Dump the header of the object with variables */
+static void
+_syx_memory_write_object_with_vars (SyxObject *object, SyxMemoryBuffer *image)
+{
+  syx_int32 data;
+  syx_varsize size;
+  SyxOop klass;
+
+  _syx_memory_write ((SyxOop *)&object, FALSE, 1, image);
+  klass = SYX_OBJECT_CLASS (object);
+  _syx_memory_write (&klass, FALSE, 1, image);
+  _syx_memory_buffer_put (image, object->has_refs);
+  _syx_memory_buffer_put (image, object->is_constant);
+
+  data = syx_object_vars_size ((SyxOop)object);
+  data = SYX_COMPAT_SWAP_32(data);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  /* the data size comes first to allocate the whole body of the object when loading */
+  size = SYX_COMPAT_SWAP_32 (object->data_size);
+  _syx_memory_buffer_write (image, &size, sizeof (syx_varsize));
+
+  /* store instance variables, keep an eye on special cases */
+  if ((SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_block_context_class) ||
+       SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_method_context_class))
+      && !SYX_IS_NIL (object->vars[SYX_VARS_CONTEXT_PART_STACK]))
+    _syx_memory_write_vars_with_fp (object, SYX_VARS_CONTEXT_PART_STACK, SYX_VARS_CONTEXT_PART_FRAME_POINTER, image);
+  else if (SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_process_class)
+           && !SYX_IS_NIL (object->vars[SYX_VARS_PROCESS_STACK]))
+    _syx_memory_write_vars_with_fp (object, SYX_VARS_PROCESS_STACK, SYX_VARS_PROCESS_FRAME_POINTER, image);
+  else
+    _syx_memory_write (object->vars, TRUE, SYX_COMPAT_SWAP_32(data), image);
+}
+
+/* Writes a single entry of the frame that points to another frame */
+static void
+_syx_memory_write_lazy_pointer (SyxObject *process, SyxInterpFrame *frame, SyxMemoryBuffer *image)
+{
+  SyxOop stack;
+  syx_int32 offset;
+  if (frame && !SYX_IS_NIL (frame->detached_frame))
+    stack = frame->detached_frame;
+  else if (!process || !frame)
+    stack = syx_nil; /* this will be encoded as 0 */
+  else
+    stack = process->vars[SYX_VARS_PROCESS_STACK];
+
+  _syx_memory_write (&stack, FALSE, 1, image);
+  offset = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, SYX_OBJECT_DATA (stack)));
+
+  _syx_memory_buffer_write (image, &offset, sizeof (syx_int32));
+}
+
+/* Dump a single frame */
+static void
+_syx_memory_write_frame (SyxObject *process, SyxInterpFrame *frame, SyxInterpFrame *upper_frame, SyxMemoryBuffer *image)
+{
+  syx_int32 data;
+  SyxInterpFrame *bottom_frame;
+  SyxOop stack;
+
+  if (!process)
+    bottom_frame = NULL;
+  else
+    bottom_frame = (SyxInterpFrame *)SYX_OBJECT_DATA (process->vars[SYX_VARS_PROCESS_STACK]);
+
+  _syx_memory_write (&frame->this_context, FALSE, 1, image);
+  _syx_memory_write (&frame->detached_frame, FALSE, 1, image);
+  _syx_memory_write_lazy_pointer (process, frame->parent_frame, image);
+  _syx_memory_write_lazy_pointer (process, frame->outer_frame, image);
+  _syx_memory_write_lazy_pointer (process, frame->stack_return_frame, image);
+  _syx_memory_write (&frame->method, FALSE, 1, image);
+  _syx_memory_write (&frame->closure, FALSE, 1, image);
+  /* this is not a SmallInteger */
+  data = SYX_COMPAT_SWAP_32 (frame->next_instruction);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  /* the stack pointer should point inside the process stack itself */
+  if (process)
+    _syx_memory_write (&process->vars[SYX_VARS_PROCESS_STACK], FALSE, 1, image);
+  else
+    {
+      data = SYX_COMPAT_SWAP_32 (0);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+    }
+  data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame->stack, bottom_frame));
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  /* arguments are in the same stack of the frame, the bottom frame of a new process has none */
+  if (!frame->arguments)
+    stack = syx_nil;
+  else if (!SYX_IS_NIL (frame->detached_frame))
+    stack = frame->detached_frame;
+  else
+    stack = process->vars[SYX_VARS_PROCESS_STACK];
+  _syx_memory_write (&stack, FALSE, 1, image);
+  data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame->arguments, SYX_OBJECT_DATA (stack)));
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  _syx_memory_write (&frame->receiver, TRUE, 1, image);
+  /* Store temporaries and local stack.
+     Only copy temporaries and arguments for detached frames without following the stack pointer */
+  if (SYX_IS_NIL (frame->detached_frame))
+    {
+      /* if no upper_frame is given, this frame is the top most frame of the process stack */
+      if (!upper_frame)
+        data = (frame->stack > &frame->local
+                ? SYX_POINTERS_OFFSET (frame->stack, &frame->local)
+                : 0);
+      else
+        data = SYX_POINTERS_OFFSET (upper_frame, &frame->local);
+    }
+  else
+    data = SYX_OBJECT_DATA_SIZE (frame->detached_frame) - SYX_POINTERS_OFFSET (&frame->local, frame);
+  data = SYX_COMPAT_SWAP_32 (data);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  _syx_memory_write (&frame->local, TRUE, SYX_COMPAT_SWAP_32 (data), image);
+
+  /* Arguments of frames in the process stack lay right below the frame */
+  if (SYX_IS_NIL (frame->detached_frame) && frame->arguments)
+    data = SYX_POINTERS_OFFSET (frame, frame->arguments);
+  else
+    data = 0;
+  data = SYX_COMPAT_SWAP_32 (data);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  _syx_memory_write (frame->arguments, TRUE, SYX_COMPAT_SWAP_32 (data), image);
+}
+
+/* Dump the whole stack of the process.
+   This will also dump relative objects containing stack, like block closure outerFrames. */
+static void
+_syx_memory_write_process_stack (SyxObject *process, SyxMemoryBuffer *image)
+{
+  syx_int32 data;
+  SyxObject *stack = SYX_OBJECT (process->vars[SYX_VARS_PROCESS_STACK]);
+  SyxInterpFrame *bottom_frame = (SyxInterpFrame *)stack->data;
+  SyxInterpFrame *frame = SYX_OOP_CAST_POINTER (process->vars[SYX_VARS_PROCESS_FRAME_POINTER]);
+  SyxInterpFrame *upper_frame = NULL;
+  SyxOop *oop;
+
+  if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)))
+    return;
+
+  _syx_memory_write_object_with_vars (stack, image);
+
+  /* We have to do things in reverse order because the stack is such a reverse single linked list,
+     each frame connected by parent frames */
+  while (frame)
+    {
+      /* We store detached frames later */
+      if (!SYX_IS_NIL (frame->detached_frame))
+        {
+          frame = frame->parent_frame;
+          continue;
+        }
+
+      /* Store the index of this frame */
+      _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_BOF);
+      data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (frame, bottom_frame));
+      _syx_memory_buffer_write (image, &data, sizeof (syx_varsize));
+      _syx_memory_write_frame (process, frame, NULL, image);
+      upper_frame = frame;
+      frame = frame->parent_frame;
+    }
+  _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_EOS);
+  /* We have to store the rest of objects, for detached frames, up to the upper frame.
+     What we need is only the local stacks, but we don't know where they begin, so just skip C pointers */
+  if (upper_frame)
+    {
+      data = SYX_COMPAT_SWAP_32 (SYX_POINTERS_OFFSET (upper_frame, bottom_frame));
+      _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
       for (oop = (SyxOop *)bottom_frame; oop != (SyxOop *)upper_frame; oop++)
         {
           if (SYX_IS_CPOINTER (*oop))
@@ -548,44 +2142,553 @@ _syx_memory_write_process_stack (SyxObject *process, FILE *image)
             _syx_memory_write (oop, TRUE, 1, image);
         }
     }
-  else
+  else
+    {
+      data = SYX_COMPAT_SWAP_32 (0);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+    }
+  stack->is_marked = TRUE;
+
+  /* Let's store all detached frames until they have a reference to this process */
+  frame = SYX_OOP_CAST_POINTER (process->vars[SYX_VARS_PROCESS_FRAME_POINTER]);
+  while (frame)
+    {
+      stack = SYX_OBJECT (frame->detached_frame);
+      /* Also check if the stack has been collected */
+      if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)) || stack->is_marked)
+        {
+          frame = frame->parent_frame;
+          continue;
+        }
+
+      _syx_memory_write_object_with_vars (stack, image);
+
+      /* Store the index of this frame */
+      _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_BOF);
+      data = SYX_COMPAT_SWAP_32 (0);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_varsize));
+      _syx_memory_write_frame (process, frame, NULL, image);
+      _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_EOS);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_varsize));
+
+      stack->is_marked = TRUE;
+      frame = frame->parent_frame;
+    }
+}
+
+/* Write the stacks of all processes. Suspended processes, waiting on semaphores or not yet resumed,
+   are not in the scheduler but their stacks hold frames as well */
+static void
+_syx_memory_write_processes (SyxMemoryBuffer *image)
+{
+  SyxObject *object;
+  SyxOop process;
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (SYX_OOP_NE (SYX_OBJECT_CLASS (object), syx_process_class))
+        continue;
+
+      process = (SyxOop) object;
+      if (SYX_IS_NIL (SYX_PROCESS_STACK (process))
+          || SYX_OBJECT_IS_MARKED (SYX_PROCESS_STACK (process)))
+        continue;
+
+      _syx_memory_write_process_stack (SYX_OBJECT (process), image);
+    }
+}
+
+/* Write an object with its data, followed by the outer frame of block closures */
+static void
+_syx_memory_write_object (SyxObject *object, SyxMemoryBuffer *image)
+{
+  SyxObject *stack;
+  syx_int32 data = 0;
+
+  _syx_memory_write_object_with_vars (object, image);
+
+  /* store data */
+  if (object->data_size > 0)
+    {
+      if (object->has_refs)
+        _syx_memory_write (object->data, TRUE, object->data_size, image);
+      else
+        {
+#ifdef HAVE_LIBGMP
+          if (SYX_OBJECT_IS_LARGE_INTEGER ((SyxOop)object))
+            {
+              /* Large integers are stored in the format of mpz_out_raw (),
+                 preceded by the number of bytes for systems that don't support GMP */
+              mpz_ptr z = SYX_OBJECT_LARGE_INTEGER ((SyxOop)object);
+              size_t count = (mpz_sizeinbase (z, 2) + 7) / 8;
+
+              if (!mpz_sgn (z))
+                count = 0;
+
+              /* specify that's a large integer */
+              _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_LARGE_INTEGER);
+              data = SYX_COMPAT_SWAP_32 ((syx_int32)(count + 4));
+              _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+
+              /* a big-endian byte count, negative for negative numbers, then the magnitude */
+              data = mpz_sgn (z) < 0 ? -(syx_int32)count : (syx_int32)count;
+              _syx_memory_buffer_put (image, (syx_int8)((data >> 24) & 0xFF));
+              _syx_memory_buffer_put (image, (syx_int8)((data >> 16) & 0xFF));
+              _syx_memory_buffer_put (image, (syx_int8)((data >> 8) & 0xFF));
+              _syx_memory_buffer_put (image, (syx_int8)(data & 0xFF));
+              _syx_memory_buffer_reserve (image, count);
+              if (count)
+                mpz_export (image->data + image->top, NULL, 1, 1, 1, 0, z);
+              image->top += count;
+            }
+          else
+#endif /* HAVE_LIBGMP */
+            {
+              /* it's not a large integer */
+              _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_NORMAL);
+              _syx_memory_buffer_write (image, object->data, object->data_size);
+            }
+        }
+    }
+
+  /* Check for block closures that are not attached to any process */
+  if (SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_block_closure_class))
+    {
+      stack = SYX_OBJECT (object->vars[SYX_VARS_BLOCK_CLOSURE_OUTER_FRAME]);
+      /* Check if the stack has been collected or written to the image */
+      if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)) || stack->is_marked)
+        return;
+
+      _syx_memory_write_object_with_vars (stack, image);
+
+      /* Store the index of this frame */
+      _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_BOF);
+      data = SYX_COMPAT_SWAP_32 (0);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_varsize));
+      /* Outer frames have only one frame */
+      _syx_memory_write_frame (NULL, (SyxInterpFrame *)stack->data, NULL, image);
+      _syx_memory_buffer_put (image, SYX_MEMORY_TYPE_EOS);
+      _syx_memory_buffer_write (image, &data, sizeof (syx_varsize));
+
+      stack->is_marked = TRUE;
+    }
+}
+
+/* Forget the changes made to objects, once the memory matches the image */
+static void
+_syx_memory_clean (void)
+{
+  SyxObject *object;
+
+  /* don't copy pages of mapped images needlessly */
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (object->is_dirty)
+        object->is_dirty = FALSE;
+    }
+}
+
+/* Set the image the memory matches, deltas can be appended to it */
+static void
+_syx_memory_set_image_path (syx_symbol path)
+{
+  char *old_path = _syx_memory_image_path;
+
+  _syx_memory_image_path = (path ? syx_strdup (path) : NULL);
+  if (old_path)
+    syx_free (old_path);
+}
+
+/* Write the portable image, where each object is stored field by field */
+static syx_bool
+_syx_memory_save_portable_image (FILE *file)
+{
+  SyxObject *object;
+  syx_int32 data = 0;
+  SyxMemoryBuffer buffer = {NULL, 0, 0};
+  SyxMemoryBuffer *image = &buffer;
+  syx_bool ret;
+
+  data = SYX_COMPAT_SWAP_32 (_syx_memory_size);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  data = SYX_COMPAT_SWAP_32 (_syx_freed_memory_top);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  _syx_memory_write (_syx_freed_memory, FALSE, _syx_freed_memory_top, image);
+
+  /* the scheduler writes straight to the file */
+  ret = _syx_memory_buffer_flush (image, file);
+  _syx_scheduler_save (file);
+
+  _syx_memory_write (&syx_globals, FALSE, 1, image);
+  _syx_memory_write (&syx_symbols, FALSE, 1, image);
+
+  /* First store the processes */
+  _syx_memory_write_processes (image);
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      /* the mark check is not related to the GC but means the object has been already written */
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)) || object->is_marked)
+        continue;
+
+      _syx_memory_write_object (object, image);
+    }
+
+  /* be sure all objects are unmarked */
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    object->is_marked = FALSE;
+
+  if (!_syx_memory_buffer_flush (image, file))
+    ret = FALSE;
+  syx_free (buffer.data);
+
+  return ret;
+}
+
+/* TRUE for objects the interpreter changes without the write barrier */
+static syx_bool
+_syx_memory_is_volatile (SyxObject *object)
+{
+  SyxOop klass = SYX_OBJECT_CLASS (object);
+
+  return (SYX_OOP_EQ (klass, syx_process_class)
+          || SYX_OOP_EQ (klass, syx_method_context_class)
+          || SYX_OOP_EQ (klass, syx_block_context_class)
+          || SYX_OOP_EQ (klass, syx_block_closure_class)
+          || SYX_OOP_EQ ((SyxOop) object, syx_processor));
+}
+
+/* Append a delta to an image: the size of the memory, then the objects changed since the image has been
+   written and the entries freed meanwhile, which have no class. Processes, contexts and closures are always written */
+static syx_bool
+_syx_memory_save_delta (FILE *file)
+{
+  SyxObject *object;
+  SyxOop stack;
+  syx_int32 data;
+  SyxMemoryBuffer buffer = {NULL, 0, 0};
+  SyxMemoryBuffer *image = &buffer;
+  syx_bool ret;
+
+  data = SYX_COMPAT_SWAP_32 (SYX_MEMORY_DELTA_MARK);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  data = SYX_COMPAT_SWAP_32 (_syx_memory_size);
+  _syx_memory_buffer_write (image, &data, sizeof (syx_int32));
+  _syx_memory_write (&syx_globals, FALSE, 1, image);
+  _syx_memory_write (&syx_symbols, FALSE, 1, image);
+
+  _syx_memory_write_processes (image);
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (object->is_marked)
+        continue;
+
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        {
+          if (object->is_dirty)
+            {
+              _syx_memory_write ((SyxOop *)&object, FALSE, 1, image);
+              _syx_memory_write (&syx_nil, FALSE, 1, image);
+            }
+          continue;
+        }
+
+      if (!object->is_dirty && !_syx_memory_is_volatile (object))
+        continue;
+
+      _syx_memory_write_object (object, image);
+
+      /* frames detached from processes refer to their stacks, which may have been written above */
+      if (SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_method_context_class)
+          || SYX_OOP_EQ (SYX_OBJECT_CLASS (object), syx_block_context_class))
+        {
+          stack = object->vars[SYX_VARS_CONTEXT_PART_STACK];
+          if (SYX_IS_OBJECT (stack) && !SYX_OBJECT_IS_MARKED (stack) && !SYX_IS_NIL (SYX_OBJECT_CLASS (stack)))
+            _syx_memory_write_object (SYX_OBJECT (stack), image);
+        }
+    }
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    object->is_marked = FALSE;
+
+  ret = _syx_memory_buffer_flush (image, file);
+  syx_free (buffer.data);
+
+  return ret;
+}
+
+typedef struct SyxMemoryRange SyxMemoryRange;
+
+/* Addresses of a body being saved into a mapped image, and its offset in the space */
+struct SyxMemoryRange
+{
+  syx_int8 *start;
+  syx_int8 *end;
+  syx_nint offset;
+};
+
+static int
+_syx_memory_range_compare (const void *a, const void *b)
+{
+  const SyxMemoryRange *range_a = (const SyxMemoryRange *) a;
+  const SyxMemoryRange *range_b = (const SyxMemoryRange *) b;
+
+  if (range_a->start < range_b->start)
+    return -1;
+  return range_a->start > range_b->start;
+}
+
+/* Translate a value to be saved into a mapped image.
+   Pointers into bodies, like the frame pointers of processes, are moved into the space */
+static SyxOop
+_syx_memory_mapped_translate (SyxOop oop, SyxMemoryRange *ranges, syx_int32 ranges_top, SyxOop space_base)
+{
+  syx_int8 *ptr = (syx_int8 *) SYX_OOP_CAST_POINTER (oop);
+  syx_int32 low = 0, high = ranges_top - 1, mid;
+
+  if (!SYX_IS_POINTER (oop) || SYX_IS_OBJECT (oop))
+    return oop;
+
+  /* look for the last range starting before the pointer */
+  while (low <= high)
+    {
+      mid = (low + high) / 2;
+      if (ranges[mid].start <= ptr)
+        low = mid + 1;
+      else
+        high = mid - 1;
+    }
+  if (high >= 0 && ptr <= ranges[high].end)
+    return space_base + ranges[high].offset + (ptr - ranges[high].start);
+
+  /* keep raw numbers like the instruction index of frames, other C pointers won't be valid anymore */
+  if (oop < 0x10000)
+    return oop;
+  return 0;
+}
+
+/* Returns the number of bytes of the data of an object, and the bytes needed to save the limbs of large integers */
+static syx_nint
+_syx_memory_mapped_data_size (SyxObject *object, syx_nint *limbs_size)
+{
+  *limbs_size = 0;
+  if (!object->data || !object->data_size)
+    return 0;
+
+#ifdef HAVE_LIBGMP
+  if (SYX_OBJECT_IS_LARGE_INTEGER ((SyxOop) object))
+    *limbs_size = SYX_MEMORY_BODY_ROUND (mpz_size (SYX_OBJECT_LARGE_INTEGER ((SyxOop) object)) * sizeof (mp_limb_t));
+#endif
+
+  return (object->has_refs ? (syx_nint) (object->data_size * sizeof (SyxOop)) : object->data_size);
+}
+
+/* Pad the image with zeros up to the next section, returns its offset */
+static syx_nint
+_syx_memory_mapped_align (FILE *image)
+{
+  syx_nint offset = ftell (image);
+  syx_nint aligned = SYX_MEMORY_MAPPED_ALIGNED (offset);
+
+  if (aligned > offset)
     {
-      data = SYX_COMPAT_SWAP_32 (0);
-      fwrite (&data, sizeof (syx_int32), 1, image);
+      fseek (image, aligned - 1, SEEK_SET);
+      fputc (0, image);
     }
-  stack->is_marked = TRUE;
+  return aligned;
+}
 
-  /* Let's store all detached frames until they have a reference to this process */
-  frame = SYX_OOP_CAST_POINTER (process->vars[SYX_VARS_PROCESS_FRAME_POINTER]);
-  while (frame)
+/* Write the mapped image: the header, the object table as it is in memory,
+   the indexes of freed entries and large integers, then all bodies laid out as they will be mapped */
+static syx_bool
+_syx_memory_save_mapped_image (FILE *image)
+{
+  SyxMemoryMappedHeader header;
+  SyxMemoryRange *ranges;
+  SyxObject *table, *object, *entry;
+  SyxOop *slots;
+  syx_nint *bodies;
+  syx_int32 *indexes;
+  syx_int8 *space, *body;
+  syx_nint vars_size, data_size, limbs_size, offset, i;
+  syx_int32 index, ranges_top = 0;
+  syx_bool ret;
+
+  memset (&header, '\0', sizeof (SyxMemoryMappedHeader));
+  memcpy (header.magic, SYX_MEMORY_MAPPED_MAGIC, sizeof (header.magic));
+  header.byte_order = 0x01020304;
+  header.oop_size = sizeof (SyxOop);
+  header.object_size = sizeof (SyxObject);
+  header.memory_size = _syx_memory_size;
+  header.freed_top = _syx_freed_memory_top;
+  header.globals = SYX_MEMORY_INDEX_OF (syx_globals);
+  header.symbols = SYX_MEMORY_INDEX_OF (syx_symbols);
+  header.table_base = (SyxOop) syx_memory;
+  /* the space follows the reserved table, where it is likely to be mapped again */
+  header.space_base = (SyxOop) syx_memory + SYX_MEMORY_MAPPED_ALIGNED (_syx_memory_capacity * sizeof (SyxObject));
+
+  bodies = (syx_nint *) syx_calloc (_syx_memory_size, sizeof (syx_nint));
+  ranges = (SyxMemoryRange *) syx_malloc (2 * _syx_memory_size * sizeof (SyxMemoryRange));
+  indexes = (syx_int32 *) syx_malloc ((_syx_freed_memory_top + _syx_memory_size) * sizeof (syx_int32));
+  for (index=0; index < _syx_freed_memory_top; index++)
+    indexes[index] = SYX_MEMORY_INDEX_OF (_syx_freed_memory[index]);
+
+  /* place the bodies into the space, data right after the instance variables */
+  offset = 0;
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
     {
-      stack = SYX_OBJECT (frame->detached_frame);
-      /* Also check if the stack has been collected */
-      if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)) || stack->is_marked)
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
+
+      index = object - syx_memory;
+      vars_size = SYX_MEMORY_BODY_ROUND (syx_object_vars_size ((SyxOop) object) * sizeof (SyxOop));
+      data_size = _syx_memory_mapped_data_size (object, &limbs_size);
+      if (limbs_size)
+        indexes[_syx_freed_memory_top + header.large_integers_top++] = index;
+
+      offset += sizeof (SyxMemoryChunk);
+      bodies[index] = offset;
+      if (object->vars)
         {
-          frame = frame->parent_frame;
-          continue;
+          ranges[ranges_top].start = (syx_int8 *) object->vars;
+          ranges[ranges_top].end = (syx_int8 *) object->vars + vars_size;
+          ranges[ranges_top++].offset = offset;
+        }
+      if (data_size)
+        {
+          ranges[ranges_top].start = (syx_int8 *) object->data;
+          ranges[ranges_top].end = (syx_int8 *) object->data + data_size;
+          ranges[ranges_top++].offset = offset + vars_size;
         }
+      offset += vars_size + SYX_MEMORY_BODY_ROUND (data_size) + limbs_size;
+    }
+  header.space_size = offset;
+  qsort (ranges, ranges_top, sizeof (SyxMemoryRange), _syx_memory_range_compare);
 
-      _syx_memory_write_object_with_vars (stack, image);
+  /* copy the bodies and point the table to them */
+  table = (SyxObject *) syx_malloc (_syx_memory_size * sizeof (SyxObject));
+  memcpy (table, syx_memory, _syx_memory_size * sizeof (SyxObject));
+  space = (syx_int8 *) syx_calloc (1, header.space_size + 1);
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
 
-      data = SYX_COMPAT_SWAP_32 (stack->data_size);
-      fwrite (&data, sizeof (syx_varsize), 1, image);    
-      /* Store the index of this frame */
-      fputc (SYX_MEMORY_TYPE_BOF, image);
-      data = SYX_COMPAT_SWAP_32 (0);
-      fwrite (&data, sizeof (syx_varsize), 1, image);
-      _syx_memory_write_frame (process, frame, NULL, image);
-      fputc (SYX_MEMORY_TYPE_EOS, image);
-      fwrite (&data, sizeof (syx_varsize), 1, image);
+      index = object - syx_memory;
+      entry = table + index;
+      body = space + bodies[index];
+      vars_size = syx_object_vars_size ((SyxOop) object);
+      data_size = _syx_memory_mapped_data_size (object, &limbs_size);
+      ((SyxMemoryChunk *) body - 1)->size = (SYX_MEMORY_BODY_ROUND (vars_size * sizeof (SyxOop))
+                                              + SYX_MEMORY_BODY_ROUND (data_size) + limbs_size);
 
-      stack->is_marked = TRUE;
-      frame = frame->parent_frame;
+      slots = (SyxOop *) body;
+      if (object->vars)
+        memcpy (slots, object->vars, vars_size * sizeof (SyxOop));
+      for (i=0; i < vars_size; i++)
+        slots[i] = _syx_memory_mapped_translate (slots[i], ranges, ranges_top, header.space_base);
+      entry->vars = (SyxOop *) SYX_OOP_CAST_POINTER (header.space_base + bodies[index]);
+
+      body += SYX_MEMORY_BODY_ROUND (vars_size * sizeof (SyxOop));
+      entry->data = NULL;
+      if (data_size)
+        {
+          entry->data = (SyxOop *) SYX_OOP_CAST_POINTER (header.space_base + (body - space));
+          memcpy (body, object->data, data_size);
+          slots = (SyxOop *) body;
+          if (object->has_refs)
+            {
+              for (i=0; i < object->data_size; i++)
+                slots[i] = _syx_memory_mapped_translate (slots[i], ranges, ranges_top, header.space_base);
+            }
+        }
+
+#ifdef HAVE_LIBGMP
+      /* limbs of large integers follow the data */
+      body += SYX_MEMORY_BODY_ROUND (data_size);
+      for (i=0; (syx_nint) (i * sizeof (mp_limb_t)) < limbs_size; i++)
+        ((mp_limb_t *) body)[i] = mpz_getlimbn (SYX_OBJECT_LARGE_INTEGER ((SyxOop) object), i);
+#endif
+
+      entry->is_marked = FALSE;
+      entry->is_young = FALSE;
+      entry->is_remembered = FALSE;
+      entry->is_dirty = FALSE;
     }
+
+  ret = fwrite (&header, sizeof (SyxMemoryMappedHeader), 1, image) == 1;
+  _syx_scheduler_save (image);
+
+  header.table_offset = _syx_memory_mapped_align (image);
+  ret = ret && fwrite (table, sizeof (SyxObject), _syx_memory_size, image) == (size_t) _syx_memory_size;
+  header.indexes_offset = _syx_memory_mapped_align (image);
+  index = _syx_freed_memory_top + header.large_integers_top;
+  ret = ret && fwrite (indexes, sizeof (syx_int32), index, image) == (size_t) index;
+  header.space_offset = _syx_memory_mapped_align (image);
+  ret = ret && fwrite (space, 1, header.space_size, image) == (size_t) header.space_size;
+  _syx_memory_mapped_align (image);
+
+  /* now that offsets are known, write the header again */
+  fseek (image, 0, SEEK_SET);
+  ret = ret && fwrite (&header, sizeof (SyxMemoryMappedHeader), 1, image) == 1;
+
+  syx_free (table);
+  syx_free (space);
+  syx_free (indexes);
+  syx_free (ranges);
+  syx_free (bodies);
+  return ret;
+}
+
+/* Images are written to a file with this suffix, then moved over the previous image.
+   Mapped images keep reading the pages of the file they've been loaded from */
+#define SYX_MEMORY_TEMP_SUFFIX ".new"
+
+static char *
+_syx_memory_temp_path (syx_symbol path)
+{
+  char *temp_path = (char *) syx_malloc (strlen (path) + sizeof (SYX_MEMORY_TEMP_SUFFIX));
+
+  strcpy (temp_path, path);
+  strcat (temp_path, SYX_MEMORY_TEMP_SUFFIX);
+  return temp_path;
+}
+
+/* Move the image written to temp_path over the one at path */
+static syx_bool
+_syx_memory_replace_image (syx_symbol temp_path, syx_symbol path)
+{
+#ifdef WINDOWS
+  /* rename doesn't replace existing files */
+  remove (path);
+#endif
+  if (!rename (temp_path, path))
+    return TRUE;
+
+  remove (temp_path);
+  return FALSE;
+}
+
+/* Write the image to the file in the format set with syx_memory_set_image_format, then close it */
+static syx_bool
+_syx_memory_write_image (FILE *image)
+{
+  syx_bool ret;
+
+  if (_syx_memory_image_format == SYX_MEMORY_IMAGE_MAPPED)
+    ret = _syx_memory_save_mapped_image (image);
+  else
+    ret = _syx_memory_save_portable_image (image);
+
+  if (fclose (image))
+    ret = FALSE;
+
+  return ret;
 }
 
 /*!
-  Dumps all the memory.
+  Dumps all the memory, in the format set with syx_memory_set_image_format.
 
   \param path the file path to put all inside
   \return FALSE if an error occurred
@@ -593,11 +2696,61 @@ _syx_memory_write_process_stack (SyxObject *process, FILE *image)
 syx_bool
 syx_memory_save_image (syx_symbol path)
 {
-  SyxObject *object;
   FILE *image;
-  syx_int32 data = 0;
-  SyxObject *stack;
-  SyxOop process;
+  char *temp_path;
+  syx_bool ret;
+
+  if (!path)
+    path = SYX_OBJECT_SYMBOL (syx_globals_at ("ImageFileName"));
+
+  if (!path)
+    return FALSE;
+
+  temp_path = _syx_memory_temp_path (path);
+  image = fopen (temp_path, "wb");
+  if (!image)
+    {
+      syx_free (temp_path);
+      return FALSE;
+    }
+
+  syx_memory_gc ();
+
+  if (_syx_memory_write_image (image))
+    ret = _syx_memory_replace_image (temp_path, path);
+  else
+    {
+      remove (temp_path);
+      ret = FALSE;
+    }
+  syx_free (temp_path);
+
+  /* the previous image is left as it was */
+  if (!ret)
+    return FALSE;
+
+  _syx_memory_clean ();
+  _syx_memory_set_image_path (path);
+  _syx_memory_image_size = _syx_memory_size;
+  return TRUE;
+}
+
+/*!
+  Append to an image the objects changed since it has been loaded or saved, and the objects freed meanwhile.
+  Such a delta takes much less time to be written than the whole memory. syx_memory_load_image applies
+  the deltas in the order they have been saved, and saving the image again folds them into it.
+
+  The whole image is saved when the memory doesn't match the image at the given path,
+  or when it has grown beyond the number of objects of that image.
+
+  \param path the file path of the image
+  \return FALSE if an error occurred
+*/
+syx_bool
+syx_memory_save_image_delta (syx_symbol path)
+{
+  FILE *image;
+  syx_bool ret;
 
   if (!path)
     path = SYX_OBJECT_SYMBOL (syx_globals_at ("ImageFileName"));
@@ -605,131 +2758,363 @@ syx_memory_save_image (syx_symbol path)
   if (!path)
     return FALSE;
 
-  image = fopen (path, "wb");
+  if (!_syx_memory_image_path || strcmp (path, _syx_memory_image_path)
+      || _syx_memory_size > _syx_memory_image_size)
+    return syx_memory_save_image (path);
+
+#ifdef SYX_MEMORY_FORK
+  /* the image is being written */
+  if (_syx_memory_save_pid)
+    return FALSE;
+#endif
+
+  image = fopen (path, "ab");
   if (!image)
     return FALSE;
 
   syx_memory_gc ();
 
-  data = SYX_COMPAT_SWAP_32 (_syx_memory_size);
-  fwrite (&data, sizeof (syx_int32), 1, image);
-  data = SYX_COMPAT_SWAP_32 (_syx_freed_memory_top);
-  fwrite (&data, sizeof (syx_int32), 1, image);
-  _syx_memory_write (_syx_freed_memory, FALSE, _syx_freed_memory_top, image);
+  ret = _syx_memory_save_delta (image);
+  if (fclose (image))
+    ret = FALSE;
 
-  _syx_scheduler_save (image);
+  if (ret)
+    _syx_memory_clean ();
+  else
+    _syx_memory_set_image_path (NULL);
 
-  _syx_memory_write (&syx_globals, FALSE, 1, image);
-  _syx_memory_write (&syx_symbols, FALSE, 1, image);
+  return ret;
+}
 
-  /* First store the processes */
-  process = syx_processor_active_process;
-  if (!SYX_IS_NIL (process))
+/*!
+  Dumps all the memory like syx_memory_save_image, but from a child process working on a
+  copy-on-write view of the memory, so that the interpreter can go on meanwhile.
+
+  The child process collects the garbage of its own copy before writing it, so the interpreter
+  only pays for the fork. Only one image can be written at once. Call syx_memory_wait_image_background once the returned
+  file descriptor is ready for reading, for example with syx_scheduler_poll_read_register.
+
+  \param path the file path to put all inside
+  \return a file descriptor to be read once the image is written, or -1 if the image can't be written in background
+*/
+syx_nint
+syx_memory_save_image_background (syx_symbol path)
+{
+#ifdef SYX_MEMORY_FORK
+  SyxObject *object;
+  FILE *image;
+  char *temp_path;
+  int fds[2];
+  pid_t pid;
+  char result;
+
+  if (_syx_memory_save_pid)
+    return -1;
+
+  if (!path)
+    path = SYX_OBJECT_SYMBOL (syx_globals_at ("ImageFileName"));
+
+  if (!path)
+    return -1;
+
+  temp_path = _syx_memory_temp_path (path);
+  image = fopen (temp_path, "wb");
+  if (!image || pipe (fds))
+    {
+      if (image)
+        {
+          fclose (image);
+          remove (temp_path);
+        }
+      syx_free (temp_path);
+      return -1;
+    }
+
+  /* pending output would be written twice */
+  fflush (NULL);
+
+  pid = fork ();
+  if (pid == 0)
     {
-      do
+      close (fds[0]);
+      /* the image must hold at least the objects of the memory, see syx_memory_save_image_delta */
+      _syx_memory_shrink_threshold = 0;
+      syx_memory_gc ();
+      if (_syx_memory_write_image (image))
+        result = _syx_memory_replace_image (temp_path, path);
+      else
         {
-          _syx_memory_write_process_stack (SYX_OBJECT (process), image);
-          process = SYX_PROCESS_NEXT (process);
-        } while (SYX_OOP_NE (process, syx_processor_active_process));
+          remove (temp_path);
+          result = FALSE;
+        }
+      _exit (write (fds[1], &result, 1) == 1 && result ? 0 : 1);
     }
 
+  fclose (image);
+  close (fds[1]);
+  if (pid < 0)
+    {
+      remove (temp_path);
+      syx_free (temp_path);
+      close (fds[0]);
+      return -1;
+    }
+  syx_free (temp_path);
+
+  /* the child writes the memory as it is now, changes made meanwhile must be tracked apart */
   for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
     {
-      /* the mark check is not related to the GC but means the object has been already written */
-      if (SYX_IS_NIL (object->klass) || object->is_marked)
+      if (object->is_dirty)
+        {
+          _syx_memory_list_append (&_syx_memory_save_dirty, (SyxOop) object);
+          object->is_dirty = FALSE;
+        }
+    }
+  _syx_memory_save_path = syx_strdup (path);
+  _syx_memory_save_size = _syx_memory_size;
+
+  _syx_memory_save_pid = pid;
+  _syx_memory_save_fd = fds[0];
+  return fds[0];
+#else
+  return -1;
+#endif /* SYX_MEMORY_FORK */
+}
+
+/*!
+  Wait for the image being written by syx_memory_save_image_background.
+
+  \return FALSE if an error occurred or if no image is being written
+*/
+syx_bool
+syx_memory_wait_image_background (void)
+{
+#ifdef SYX_MEMORY_FORK
+  char result = FALSE;
+  int status;
+  syx_int32 i;
+
+  if (!_syx_memory_save_pid)
+    return FALSE;
+
+  if (read (_syx_memory_save_fd, &result, 1) != 1)
+    result = FALSE;
+  close (_syx_memory_save_fd);
+
+  if (waitpid (_syx_memory_save_pid, &status, 0) < 0
+      || !WIFEXITED (status) || WEXITSTATUS (status))
+    result = FALSE;
+
+  /* the memory matches the new image, except for the changes made meanwhile.
+     Otherwise it still differs from the previous image by the changes made before the fork */
+  if (result)
+    {
+      _syx_memory_set_image_path (_syx_memory_save_path);
+      _syx_memory_image_size = _syx_memory_save_size;
+    }
+  else
+    {
+      for (i=0; i < _syx_memory_save_dirty.top; i++)
+        SYX_OBJECT_IS_DIRTY (_syx_memory_save_dirty.oops[i]) = TRUE;
+    }
+  _syx_memory_list_free (&_syx_memory_save_dirty);
+  syx_free (_syx_memory_save_path);
+  _syx_memory_save_path = NULL;
+
+  _syx_memory_save_pid = 0;
+  _syx_memory_save_fd = -1;
+  return result;
+#else
+  return FALSE;
+#endif /* SYX_MEMORY_FORK */
+}
+
+/*! Returns TRUE while an image is being written by syx_memory_save_image_background */
+syx_bool
+syx_memory_is_saving_image_background (void)
+{
+#ifdef SYX_MEMORY_FORK
+  return _syx_memory_save_pid != 0;
+#else
+  return FALSE;
+#endif
+}
+
+/* Point the blocks of code having the same source to the same position in the sources file.
+   The blocks and their previous text are appended to the list of changed code */
+static void
+_syx_memory_share_source (SyxOop code, SyxOop text, syx_symbol source, SyxOop position, SyxMemoryList *changed)
+{
+  SyxOop literals = SYX_CODE_LITERALS (code);
+  SyxOop block;
+  SyxOop block_text;
+  syx_varsize i;
+
+  if (!SYX_IS_OBJECT (literals))
+    return;
+
+  for (i=0; i < SYX_OBJECT_DATA_SIZE (literals); i++)
+    {
+      /* blocks are held by the closures pushed by the code */
+      block = SYX_OBJECT_DATA(literals)[i];
+      if (!SYX_IS_OBJECT (block) || SYX_OBJECT_CLASS (block) != syx_block_closure_class)
         continue;
 
-      _syx_memory_write_object_with_vars (object, image);
+      block = SYX_BLOCK_CLOSURE_BLOCK (block);
+      if (!SYX_IS_OBJECT (block))
+        continue;
 
-      /* store data */
-      data = SYX_COMPAT_SWAP_32 (object->data_size);
-      fwrite (&data, sizeof (syx_varsize), 1, image);
-      if (object->data_size > 0)
+      block_text = SYX_CODE_TEXT (block);
+      if (SYX_OOP_EQ (block_text, text)
+          || (SYX_OBJECT_IS_STRING (block_text) && !strcmp (SYX_OBJECT_SYMBOL (block_text), source)))
         {
-          if (object->has_refs)
-            _syx_memory_write (object->data, TRUE, object->data_size, image);
-          else
-            {
-#ifdef HAVE_LIBGMP
-              if (SYX_OBJECT_IS_LARGE_INTEGER ((SyxOop)object))
-                {
-                  /* This algorithm is used to store large integers.
-                     We need to specify how many bytes GMP wrote to the image,
-                     for systems that don't support GMP */
-
-                  syx_int32 offset = 0;
-                  syx_nint start, end;
-                  /* specify that's a large integer */
-                  fputc (SYX_MEMORY_TYPE_LARGE_INTEGER, image);
-                  /* make space to hold the offset */
-                  fwrite (&offset, sizeof (syx_int32), 1, image);
-                  start = ftell (image);
-                  mpz_out_raw (image, SYX_OBJECT_LARGE_INTEGER ((SyxOop)object));
-                  end = ftell (image);
-                  offset = end - start;
-                  /* go back to the offset */
-                  fseek (image, - offset - sizeof (syx_int32), SEEK_CUR);
-                  /* now write the length of the data written by mpz_out_raw () */
-                  data = SYX_COMPAT_SWAP_32 (offset);
-                  fwrite (&data, sizeof (syx_int32), 1, image);
-                  /* return again to continue normal writing */
-                  fseek (image, offset, SEEK_CUR);
-                }
-              else
-#endif /* HAVE_LIBGMP */
-                {
-                  /* it's not a large integer */
-                  fputc (SYX_MEMORY_TYPE_NORMAL, image);
-                  fwrite (object->data, sizeof (syx_int8), object->data_size, image);
-                }
-            }
+          _syx_memory_list_append (changed, block);
+          _syx_memory_list_append (changed, block_text);
+          SYX_CODE_TEXT(block) = position;
+          SYX_OBJECT_IS_DIRTY(block) = TRUE;
+          _syx_memory_share_source (block, text, source, position, changed);
         }
+    }
+}
 
-      /* Check for block closures that are not attached to any process */
-      if (SYX_OOP_EQ (object->klass, syx_block_closure_class))
+/* Append the source of code to the sources file and replace its text with the position of the source.
+   The code and its previous text are appended to the list of changed code */
+static syx_bool
+_syx_memory_externalize_code (SyxOop code, FILE *sources, syx_bool moved, SyxMemoryList *changed)
+{
+  SyxOop text = SYX_CODE_TEXT (code);
+  SyxOop position;
+  syx_string read_source = NULL;
+  syx_symbol source;
+  syx_bool ret;
+
+  if (SYX_OBJECT_IS_STRING (text))
+    source = SYX_OBJECT_SYMBOL (text);
+  else if (SYX_IS_SMALL_INTEGER (text) && moved)
+    {
+      /* the source is held by the old sources file */
+      source = read_source = syx_code_read_text (code);
+      if (!source)
         {
-          stack = SYX_OBJECT (object->vars[SYX_VARS_BLOCK_CLOSURE_OUTER_FRAME]);
-          /* Check if the stack has been collected or written to the image */
-          if (SYX_IS_NIL (SYX_POINTER_CAST_OOP (stack)) || stack->is_marked)
-            continue;
+          _syx_memory_list_append (changed, code);
+          _syx_memory_list_append (changed, text);
+          SYX_CODE_TEXT(code) = syx_nil;
+          SYX_OBJECT_IS_DIRTY(code) = TRUE;
+          return TRUE;
+        }
+    }
+  else
+    return TRUE;
+
+  position = syx_small_integer_new (ftell (sources));
+  ret = fwrite (source, 1, strlen (source) + 1, sources) == strlen (source) + 1;
+  if (ret)
+    {
+      _syx_memory_share_source (code, text, source, position, changed);
+      _syx_memory_list_append (changed, code);
+      _syx_memory_list_append (changed, text);
+      SYX_CODE_TEXT(code) = position;
+      SYX_OBJECT_IS_DIRTY(code) = TRUE;
+    }
 
-          _syx_memory_write_object_with_vars (stack, image);
+  if (read_source)
+    syx_free (read_source);
+  return ret;
+}
 
-          data = SYX_COMPAT_SWAP_32 (stack->data_size);
-          fwrite (&data, sizeof (syx_varsize), 1, image);
-          /* Store the index of this frame */
-          fputc (SYX_MEMORY_TYPE_BOF, image);
-          data = SYX_COMPAT_SWAP_32 (0);
-          fwrite (&data, sizeof (syx_varsize), 1, image);
-          /* Outer frames have only one frame */
-          _syx_memory_write_frame (NULL, (SyxInterpFrame *)stack->data, NULL, image);
-          fputc (SYX_MEMORY_TYPE_EOS, image);
-          fwrite (&data, sizeof (syx_varsize), 1, image);
-          
-          stack->is_marked = TRUE;
-        }
+/*!
+  Move the source of all methods and blocks out of the memory into a sources file, so that images are
+  smaller and faster to load. The text of each CompiledMethod and CompiledBlock is replaced by the
+  position of its source in the file, which syx_code_get_text reads back when needed.
+
+  Sources are appended to the file, whose path is held by the SourcesFileName global. Sources moved to
+  another file before are copied as well. Save the image afterwards to keep the new positions.
+  If the file can't be written, the code keeps its text and SourcesFileName isn't changed.
+
+  \param path the file path of the sources
+  \return FALSE if the sources file can't be written
+*/
+syx_bool
+syx_memory_externalize_sources (syx_symbol path)
+{
+  SyxOop old_path = syx_globals_at_if_absent ("SourcesFileName", syx_nil);
+  syx_bool moved = !SYX_OBJECT_IS_STRING (old_path) || strcmp (SYX_OBJECT_SYMBOL (old_path), path);
+  SyxObject *object;
+  SyxMemoryList changed = {NULL, 0, 0};
+  FILE *sources;
+  syx_bool ret = TRUE;
+  syx_int32 i;
+
+  sources = fopen (path, "ab");
+  if (!sources)
+    return FALSE;
+  fseek (sources, 0, SEEK_END);
+
+  /* methods first, to share their source with the blocks defined by them */
+  for (object=syx_memory; ret && object <= SYX_MEMORY_TOP; object++)
+    {
+      if (SYX_OBJECT_CLASS (object) == syx_compiled_method_class)
+        ret = _syx_memory_externalize_code ((SyxOop) object, sources, moved, &changed);
     }
 
-  fclose (image);
+  for (object=syx_memory; ret && object <= SYX_MEMORY_TOP; object++)
+    {
+      if (SYX_OBJECT_CLASS (object) == syx_compiled_block_class)
+        ret = _syx_memory_externalize_code ((SyxOop) object, sources, moved, &changed);
+    }
 
-  /* be sure all objects are unmarked */
-  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
-    object->is_marked = FALSE;
+  if (fclose (sources))
+    ret = FALSE;
 
-  return TRUE;
+  /* the positions are only valid once the whole file has been written, otherwise restore the previous texts */
+  if (ret)
+    syx_globals_at_put (syx_symbol_new ("SourcesFileName"), syx_string_new (path));
+  else
+    {
+      for (i=changed.top - 2; i >= 0; i -= 2)
+        SYX_CODE_TEXT(changed.oops[i]) = changed.oops[i + 1];
+    }
+
+  _syx_memory_list_free (&changed);
+  return ret;
+}
+
+/*!
+  Set the format of the images written by syx_memory_save_image.
+
+  Portable images can be loaded by any host. Mapped images are loaded much faster, by mapping
+  the file into memory, but only by hosts with the same word size and byte order.
+  syx_memory_load_image recognizes both formats.
+*/
+void
+syx_memory_set_image_format (SyxMemoryImageFormat format)
+{
+  _syx_memory_image_format = format;
+}
+
+/*! Returns the format of the images written by syx_memory_save_image */
+SyxMemoryImageFormat
+syx_memory_get_image_format (void)
+{
+  return _syx_memory_image_format;
 }
 
 static void
-_syx_memory_read_lazy_pointer (SyxOop *entry, FILE *image)
+_syx_memory_read_lazy_pointer (SyxOop *entry, SyxMemoryBuffer *image)
 {
   SyxMemoryLazyPointer *lazy;
-  syx_int32 data;
-  _syx_memory_lazy_pointers = syx_realloc (_syx_memory_lazy_pointers,
-                                           ++_syx_memory_lazy_pointers_top * sizeof (SyxMemoryLazyPointer));
-  lazy = &_syx_memory_lazy_pointers[_syx_memory_lazy_pointers_top - 1];
+  syx_int32 data = 0;
+
+  if (_syx_memory_lazy_pointers_top == _syx_memory_lazy_pointers_size)
+    {
+      _syx_memory_lazy_pointers_size = _syx_memory_lazy_pointers_size ? _syx_memory_lazy_pointers_size * 2 : 64;
+      _syx_memory_lazy_pointers = syx_realloc (_syx_memory_lazy_pointers,
+                                               _syx_memory_lazy_pointers_size * sizeof (SyxMemoryLazyPointer));
+    }
+  lazy = &_syx_memory_lazy_pointers[_syx_memory_lazy_pointers_top++];
   
   /* Store the stack oop */
-  fread(&data, sizeof (syx_int32), 1, image);
+  _syx_memory_buffer_read (image, &data, sizeof (syx_int32));
   data = SYX_COMPAT_SWAP_32 (data);
   if (!data)
     lazy->stack = 0;
@@ -737,7 +3122,7 @@ _syx_memory_read_lazy_pointer (SyxOop *entry, FILE *image)
     lazy->stack = (SyxOop)(syx_memory + data);
   
   /* Store the offset */
-  fread(&data, sizeof (syx_int32), 1, image);
+  _syx_memory_buffer_read (image, &data, sizeof (syx_int32));
   data = SYX_COMPAT_SWAP_32 (data);
   lazy->offset = data;
 
@@ -745,10 +3130,68 @@ _syx_memory_read_lazy_pointer (SyxOop *entry, FILE *image)
   lazy->entry = entry;
 }
 
+/* Read a SmallInteger stored by value. If it doesn't fit this host, it will be fixed once the image is loaded */
+static SyxOop
+_syx_memory_read_wide_integer (SyxOop *entry, syx_int32 high, syx_uint32 low)
+{
+  SyxMemoryWideInteger *wide;
+  syx_nint value;
+
+  if (sizeof (syx_nint) > sizeof (syx_int32))
+    {
+      value = (syx_nint)((((syx_unint)high << 16) << 16) | low);
+      if (SYX_SMALL_INTEGER_CAN_EMBED (value))
+        return syx_small_integer_new (value);
+    }
+
+  if (_syx_memory_wide_integers_top == _syx_memory_wide_integers_size)
+    {
+      _syx_memory_wide_integers_size = _syx_memory_wide_integers_size ? _syx_memory_wide_integers_size * 2 : 64;
+      _syx_memory_wide_integers = syx_realloc (_syx_memory_wide_integers,
+                                               _syx_memory_wide_integers_size * sizeof (SyxMemoryWideInteger));
+    }
+  wide = &_syx_memory_wide_integers[_syx_memory_wide_integers_top++];
+  wide->high = high;
+  wide->low = low;
+  wide->entry = entry;
+
+  return syx_nil;
+}
+
+/* Turn integers read by _syx_memory_read_wide_integer that don't fit a SmallInteger into LargeIntegers */
+static void
+_syx_memory_narrow_wide_integers (void)
+{
+  syx_int32 i;
+  SyxMemoryWideInteger *wide;
+#ifdef HAVE_LIBGMP
+  mpz_t *z;
+#endif
+
+  for (i=0; i < _syx_memory_wide_integers_top; i++)
+    {
+      wide = &_syx_memory_wide_integers[i];
+#ifdef HAVE_LIBGMP
+      z = syx_calloc (1, sizeof (mpz_t));
+      mpz_init_set_si (*z, wide->high);
+      mpz_mul_2exp (*z, *z, 32);
+      mpz_add_ui (*z, *z, wide->low);
+      *wide->entry = syx_large_integer_new_mpz (z);
+#else
+      syx_warning ("integer too large for this host, the image has been saved on a 64-bit host\n");
+      *wide->entry = syx_small_integer_new (wide->high < 0 ? SYX_SMALL_INTEGER_MIN : SYX_SMALL_INTEGER_MAX);
+#endif /* HAVE_LIBGMP */
+    }
+
+  syx_free (_syx_memory_wide_integers);
+  _syx_memory_wide_integers = NULL;
+  _syx_memory_wide_integers_top = _syx_memory_wide_integers_size = 0;
+}
+
 static syx_bool
-_syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image)
+_syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, SyxMemoryBuffer *image)
 {
-  syx_int32 i, idx;
+  syx_int32 i, idx, low;
   SyxOop oop;
   SyxMemoryType type = SYX_MEMORY_TYPE_OBJECT;
 
@@ -757,19 +3200,19 @@ _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image)
       oop = 0;
       
       if (mark_type)
-        type = fgetc (image);
+        type = _syx_memory_buffer_get (image);
       
       switch (type)
         {
         case SYX_MEMORY_TYPE_OBJECT:
-          if (!fread (&idx, sizeof (syx_int32), 1, image))
+          if (!_syx_memory_buffer_read (image, &idx, sizeof (syx_int32)))
             return FALSE;
 
           idx = SYX_COMPAT_SWAP_32 (idx);
           oop = (SyxOop)(syx_memory + idx);
           break;
         case SYX_MEMORY_TYPE_IMMEDIATE:
-          if (!fread (&idx, sizeof (syx_int32), 1, image))
+          if (!_syx_memory_buffer_read (image, &idx, sizeof (syx_int32)))
             return FALSE;
 
           oop = SYX_COMPAT_SWAP_32 (idx);
@@ -777,11 +3220,20 @@ _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image)
         case SYX_MEMORY_TYPE_FRAME_POINTER:
           _syx_memory_read_lazy_pointer (&oops[i], image);
           break;
+        case SYX_MEMORY_TYPE_WIDE_INTEGER:
+          if (!_syx_memory_buffer_read (image, &idx, sizeof (syx_int32)) || !_syx_memory_buffer_read (image, &low, sizeof (syx_int32)))
+            return FALSE;
+
+          oop = _syx_memory_read_wide_integer (&oops[i], SYX_COMPAT_SWAP_32 (idx),
+                                               (syx_uint32) SYX_COMPAT_SWAP_32 (low));
+          break;
         case SYX_MEMORY_TYPE_BOF:
           if (!_syx_memory_read_process_stack (&oops[i], image))
             return FALSE;
-
-          if (!fread (&idx, sizeof (syx_int32), 1, image))
+          /* fall through */
+        case SYX_MEMORY_TYPE_EOS:
+          /* the rest of the stack up to the upper frame, stacks of processes without frames start here */
+          if (!_syx_memory_buffer_read (image, &idx, sizeof (syx_int32)))
             return FALSE;
           idx = SYX_COMPAT_SWAP_32 (idx);
           return _syx_memory_read (oops, TRUE, idx, image);
@@ -796,7 +3248,7 @@ _syx_memory_read (SyxOop *oops, syx_bool mark_type, syx_varsize n, FILE *image)
 }
 
 static syx_bool
-_syx_memory_read_process_stack (SyxOop *oop, FILE *image)
+_syx_memory_read_process_stack (SyxOop *oop, SyxMemoryBuffer *image)
 {
   syx_varsize i;
   syx_int32 data;
@@ -805,7 +3257,7 @@ _syx_memory_read_process_stack (SyxOop *oop, FILE *image)
   do
     {
       i = 0;
-      if (!fread (&data, sizeof (syx_int32), 1, image)) 
+      if (!_syx_memory_buffer_read (image, &data, sizeof (syx_int32))) 
         return FALSE;
 
       frame = oop + SYX_COMPAT_SWAP_32 (data);
@@ -816,119 +3268,129 @@ _syx_memory_read_process_stack (SyxOop *oop, FILE *image)
       _syx_memory_read_lazy_pointer (frame+i++, image); /* stack return frame */
       _syx_memory_read (frame+i++, FALSE, 1, image); /* method */
       _syx_memory_read (frame+i++, FALSE, 1, image); /* closure */
-      if (!fread (&data, sizeof (syx_int32), 1, image))
+      if (!_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
         return FALSE;
       frame[i++] = SYX_COMPAT_SWAP_32 (data); /* next instruction */
       _syx_memory_read_lazy_pointer (frame+i++, image); /* stack pointer */
+      _syx_memory_read_lazy_pointer (frame+i++, image); /* arguments */
       _syx_memory_read (frame+i++, TRUE, 1, image); /* receiver */
-      if (!fread (&data, sizeof (syx_int32), 1, image))
+      if (!_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
+        return FALSE;
+      data = SYX_COMPAT_SWAP_32 (data);
+      _syx_memory_read (frame+i, TRUE, data, image); /* temporaries and local stack */
+      if (!_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
         return FALSE;
       data = SYX_COMPAT_SWAP_32 (data);
-      _syx_memory_read (frame+i, TRUE, data, image); /* arguments, temporaries and local stack */
-    } while (fgetc (image) != SYX_MEMORY_TYPE_EOS);
+      _syx_memory_read (frame-data, TRUE, data, image); /* arguments below the frame */
+    } while (_syx_memory_buffer_get (image) != SYX_MEMORY_TYPE_EOS);
 
   return TRUE;
 }
 
-/*!
-  Loads the memory.
-
-  \param path the file containing the data dumped by syx_memory_save_image
-  \return FALSE if an error occurred
-*/
-syx_bool
-syx_memory_load_image (syx_symbol path)
+#ifdef HAVE_LIBGMP
+/* Read length bytes of a large integer in the format of mpz_out_raw () */
+static void
+_syx_memory_read_large_integer (SyxObject *object, syx_int32 length, SyxMemoryBuffer *image)
 {
-  SyxObject *object;
-  FILE *image;
-  syx_int32 data;
-  syx_int32 i;
-  SyxMemoryLazyPointer *lazy;
-  
-  SYX_START_PROFILE;
+  mpz_ptr z = SYX_OBJECT_LARGE_INTEGER ((SyxOop)object);
+  syx_uint8 *bytes = (syx_uint8 *)image->data + image->top;
+  syx_int32 count = 0;
 
-  if (!path)
+  mpz_init (z);
+  if (length < 4 || length > image->size - image->top)
     {
-      if (SYX_IS_NIL (syx_globals))
-        path = syx_get_image_path ();
-      else
-        path = SYX_OBJECT_SYMBOL (syx_globals_at ("ImageFileName"));
+      image->top = image->size;
+      return;
     }
 
-  if (!path)
-    return FALSE;
-
-  image = fopen (path, "rb");
-  if (!image)
-    return FALSE;
+  count = (syx_int32)(((syx_uint32)bytes[0] << 24) | ((syx_uint32)bytes[1] << 16)
+                      | ((syx_uint32)bytes[2] << 8) | bytes[3]);
+  if ((count < 0 ? -count : count) <= length - 4)
+    {
+      mpz_import (z, count < 0 ? -count : count, 1, 1, 1, 0, bytes + 4);
+      if (count < 0)
+        mpz_neg (z, z);
+    }
 
-  fread (&data, sizeof (syx_int32), 1, image);
-  data = SYX_COMPAT_SWAP_32 (data);
-  syx_memory_init (data);
+  image->top += length;
+}
+#endif /* HAVE_LIBGMP */
 
-  fread (&data, sizeof (syx_int32), 1, image);
-  _syx_freed_memory_top = SYX_COMPAT_SWAP_32 (data);
-  _syx_memory_read (_syx_freed_memory, FALSE, _syx_freed_memory_top, image);
+/* Read the objects of an image or of a delta, until the end of the buffer or the next delta */
+static void
+_syx_memory_read_objects (SyxMemoryBuffer *image)
+{
+  SyxObject *object;
+  SyxOop klass;
+  syx_int32 data;
+  syx_varsize vars_size;
 
-  _syx_scheduler_load (image);
+  while (_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
+    {
+      data = SYX_COMPAT_SWAP_32 (data);
+      if (data == SYX_MEMORY_DELTA_MARK)
+        {
+          image->top -= sizeof (syx_int32);
+          break;
+        }
+      object = syx_memory + data;
 
-  _syx_memory_read (&syx_globals, FALSE, 1, image);
-  _syx_memory_read (&syx_symbols, FALSE, 1, image);
+      _syx_memory_read (&klass, FALSE, 1, image);
+      if (klass == (SyxOop) syx_memory)
+        {
+          /* the entry has been freed by a delta */
+          syx_object_free_body ((SyxOop)object);
+          memset (object, '\0', sizeof (SyxObject));
+          continue;
+        }
 
-  while (!feof (image))
-    {
-      if (!_syx_memory_read ((SyxOop *)&object, FALSE, 1, image))
-        break;
+      SYX_OBJECT_SET_CLASS (object, klass);
+      object->has_refs = _syx_memory_buffer_get (image);
+      object->is_constant = _syx_memory_buffer_get (image);
 
-      _syx_memory_read (&object->klass, FALSE, 1, image);
-      object->has_refs = fgetc (image);
-      object->is_constant = fgetc (image);
+      /* allocate the body */
+      _syx_memory_buffer_read (image, &data, sizeof (syx_varsize));
+      vars_size = SYX_COMPAT_SWAP_32 (data);
+      _syx_memory_buffer_read (image, &data, sizeof (syx_varsize));
+      data = SYX_COMPAT_SWAP_32 (data);
+      syx_object_free_body ((SyxOop)object);
+      syx_object_alloc_body ((SyxOop)object, vars_size, data);
 
       /* fetch instance variables */
-      fread (&data, sizeof (syx_varsize), 1, image);
-      data = SYX_COMPAT_SWAP_32 (data);
-      if (object->vars)
-        syx_free (object->vars);
-      object->vars = (SyxOop *) syx_calloc (data, sizeof (SyxOop));
-      _syx_memory_read (object->vars, TRUE, data, image);
+      _syx_memory_read (object->vars, TRUE, vars_size, image);
 
       /* fetch data */
-      fread (&data, sizeof (syx_varsize), 1, image);
-      object->data_size = SYX_COMPAT_SWAP_32 (data);
       if (object->data_size > 0)
         {
-          if (object->data && object->data_size > 0)
-            syx_free (object->data);
-          
           if (object->has_refs)
-            {
-              object->data = (SyxOop *) syx_calloc (object->data_size, sizeof (SyxOop));
-              _syx_memory_read (object->data, TRUE, object->data_size, image);
-            }
+            _syx_memory_read (object->data, TRUE, object->data_size, image);
           else
             {
-              object->data = (SyxOop *) syx_calloc (object->data_size, sizeof (syx_int8));
-              if (fgetc (image) == SYX_MEMORY_TYPE_LARGE_INTEGER)
+              if (_syx_memory_buffer_get (image) == SYX_MEMORY_TYPE_LARGE_INTEGER)
                 {
-                  fread (&data, sizeof (syx_int32), 1, image);
+                  _syx_memory_buffer_read (image, &data, sizeof (syx_int32));
                   data = SYX_COMPAT_SWAP_32 (data);
 #ifdef HAVE_LIBGMP
-                  mpz_init (SYX_OBJECT_LARGE_INTEGER ((SyxOop)object));
-                  mpz_inp_raw (SYX_OBJECT_LARGE_INTEGER ((SyxOop)object), image);
+                  _syx_memory_read_large_integer (object, data, image);
 #else
                   /* skip GMP data since we can't handle it */
-                  fseek (image, data, SEEK_CUR);
+                  image->top = data < image->size - image->top ? image->top + data : image->size;
 #endif
                 }
               else
-                fread (object->data, sizeof (syx_int8), object->data_size, image);
+                _syx_memory_buffer_read (image, object->data, object->data_size);
             }
         }
     }
-  
-  fclose (image);
- 
-  /* Fix lazy pointers */
+}
+
+/* Point the entries read by _syx_memory_read_lazy_pointer into the stacks they refer to */
+static void
+_syx_memory_fix_lazy_pointers (void)
+{
+  syx_int32 i;
+  SyxMemoryLazyPointer *lazy;
+
   for (i=0; i < _syx_memory_lazy_pointers_top; i++)
     {
       lazy = &_syx_memory_lazy_pointers[i];
@@ -938,28 +3400,363 @@ syx_memory_load_image (syx_symbol path)
         *lazy->entry = SYX_POINTER_CAST_OOP (NULL);
     }
   syx_free (_syx_memory_lazy_pointers);
-  _syx_memory_lazy_pointers_top = 0;
+  _syx_memory_lazy_pointers = NULL;
+  _syx_memory_lazy_pointers_top = _syx_memory_lazy_pointers_size = 0;
+}
 
-  syx_fetch_basic ();
+/* Apply the deltas appended to an image by syx_memory_save_image_delta, in the order they have been written.
+   Lazy pointers are fixed after each delta, since the next one might replace the stacks they point into */
+static syx_bool
+_syx_memory_read_deltas (SyxMemoryBuffer *image)
+{
+  SyxObject *object;
+  syx_int32 data;
 
-  SYX_END_PROFILE(load_image);
+  if (image->top >= image->size)
+    return TRUE;
 
-  syx_initialize_system ();
+  while (_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
+    {
+      if (SYX_COMPAT_SWAP_32 (data) != SYX_MEMORY_DELTA_MARK
+          || !_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
+        return FALSE;
+
+      /* the memory might have grown meanwhile, but not beyond the table reserved for the image */
+      data = SYX_COMPAT_SWAP_32 (data);
+      if (data > _syx_memory_capacity)
+        return FALSE;
+      if (data > _syx_memory_size)
+        syx_memory_init (data);
+
+      _syx_memory_read (&syx_globals, FALSE, 1, image);
+      _syx_memory_read (&syx_symbols, FALSE, 1, image);
+      _syx_memory_read_objects (image);
+      _syx_memory_fix_lazy_pointers ();
+    }
+
+  /* entries without a class are free, lower ones are reused first */
+  _syx_freed_memory_top = 0;
+  for (object=SYX_MEMORY_TOP; object >= syx_memory; object--)
+    {
+      if (!object->class_index)
+        _syx_freed_memory[_syx_freed_memory_top++] = (SyxOop) object;
+    }
 
   return TRUE;
 }
 
-/*! Release a transaction started with syx_memory_gc_begin and unmark all objects in the transaction */
-void
-syx_memory_gc_end (void)
+/* Read a portable image written by _syx_memory_save_portable_image */
+static syx_bool
+_syx_memory_load_portable_image (FILE *file)
 {
-  syx_int32 i;
-  if (--_syx_memory_gc_trans_running > 0)
-    return;
+  syx_int32 data;
+  SyxMemoryBuffer buffer;
+  SyxMemoryBuffer *image = &buffer;
+  syx_bool ret;
+
+  if (!_syx_memory_buffer_fill (image, file, 0))
+    return FALSE;
+
+  if (!_syx_memory_buffer_read (image, &data, sizeof (syx_int32)))
+    {
+      syx_free (buffer.data);
+      return FALSE;
+    }
+  data = SYX_COMPAT_SWAP_32 (data);
+
+  /* reserve the table for the objects of the image, the current one might be too small */
+  if (_syx_memory_initialized)
+    _syx_memory_release ();
+  syx_memory_init (data);
+  _syx_memory_image_size = data;
+  _syx_memory_gc_phase = SYX_MEMORY_GC_IDLE;
+  _syx_memory_gc_marking = FALSE;
+  _syx_memory_mark_stack_top = 0;
+  _syx_memory_finalizable.top = 0;
+  _syx_memory_finalization_queue.top = _syx_memory_finalization_head = 0;
+  _syx_memory_finalization_pending = FALSE;
+  _syx_memory_weak_arrays.top = _syx_memory_ephemerons.top = 0;
+
+  _syx_memory_buffer_read (image, &data, sizeof (syx_int32));
+  _syx_freed_memory_top = SYX_COMPAT_SWAP_32 (data);
+  _syx_memory_read (_syx_freed_memory, FALSE, _syx_freed_memory_top, image);
+
+  /* the scheduler reads straight from the file */
+  fseek (file, image->top, SEEK_SET);
+  _syx_scheduler_load (file);
+  image->top = ftell (file);
+
+  _syx_memory_read (&syx_globals, FALSE, 1, image);
+  _syx_memory_read (&syx_symbols, FALSE, 1, image);
+
+  _syx_memory_read_objects (image);
+  _syx_memory_fix_lazy_pointers ();
+  ret = _syx_memory_read_deltas (image);
+  syx_free (buffer.data);
+
+  return ret;
+}
+
+/* Move the references of a mapped image which could not be mapped at the addresses it has been saved for */
+static void
+_syx_memory_mapped_relocate (SyxOop table_base, SyxOop space_base, syx_nint space_size)
+{
+  SyxObject *object;
+  SyxOop *slots;
+  syx_nint table_delta = (SyxOop) syx_memory - table_base;
+  syx_nint space_delta = (SyxOop) _syx_memory_space - space_base;
+  SyxOop table_end = table_base + _syx_memory_size * sizeof (SyxObject);
+  SyxOop space_end = space_base + space_size;
+  syx_varsize i, size, vars_size;
+
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (object->vars)
+        object->vars = (SyxOop *)((syx_int8 *) object->vars + space_delta);
+      if (object->data)
+        object->data = (SyxOop *)((syx_int8 *) object->data + space_delta);
+    }
+
+  /* syx_nil is not known yet, free entries have no class index */
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      if (!object->class_index)
+        continue;
+
+      /* instance variables first, then data holding references */
+      vars_size = SYX_SMALL_INTEGER (SYX_CLASS_INSTANCE_SIZE (SYX_OBJECT_CLASS (object)));
+      size = vars_size + (object->has_refs && object->data ? object->data_size : 0);
+      for (i=0; i < size; i++)
+        {
+          slots = (i < vars_size ? object->vars + i : object->data + i - vars_size);
+          if (!SYX_IS_POINTER (*slots))
+            continue;
+          if (*slots >= table_base && *slots < table_end)
+            *slots += table_delta;
+          else if (*slots >= space_base && *slots <= space_end)
+            *slots += space_delta;
+        }
+    }
+}
+
+#ifdef HAVE_LIBGMP
+/* Rebuild a large integer of a mapped image from the limbs saved after its data */
+static void
+_syx_memory_mapped_large_integer (SyxObject *object)
+{
+  mpz_t *z = (mpz_t *) object->data;
+  mp_limb_t *limbs = (mp_limb_t *)((syx_int8 *) object->data + SYX_MEMORY_BODY_ROUND (sizeof (mpz_t)));
+  size_t count = mpz_size (*z);
+  int sign = mpz_sgn (*z);
+
+  mpz_init (*z);
+  mpz_import (*z, count, -1, sizeof (mp_limb_t), 0, 0, limbs);
+  if (sign < 0)
+    mpz_neg (*z, *z);
+}
+#endif /* HAVE_LIBGMP */
+
+/* Load a mapped image written by _syx_memory_save_mapped_image.
+   The table and the space are mapped privately from the file when possible, so that pages are read
+   on demand and copied once written. References are moved only if the addresses they have been saved for are taken */
+static syx_bool
+_syx_memory_load_mapped_image (FILE *image)
+{
+  SyxMemoryMappedHeader header;
+  SyxMemoryBuffer buffer;
+  SyxObject *table;
+  syx_int8 *space;
+  syx_int32 *indexes;
+  syx_int32 capacity, i, count;
+  syx_bool ret;
+
+  if (!fread (&header, sizeof (SyxMemoryMappedHeader), 1, image))
+    return FALSE;
+
+  if (header.byte_order != 0x01020304 || header.oop_size != sizeof (SyxOop)
+      || header.object_size != sizeof (SyxObject))
+    {
+      syx_warning ("the image has been saved for a different kind of host, use a portable image instead\n");
+      return FALSE;
+    }
+
+  _syx_scheduler_load (image);
+
+  count = header.freed_top + header.large_integers_top;
+  indexes = (syx_int32 *) syx_malloc ((count + 1) * sizeof (syx_int32));
+  if (fseek (image, header.indexes_offset, SEEK_SET)
+      || fread (indexes, sizeof (syx_int32), count, image) != (size_t) count)
+    {
+      syx_free (indexes);
+      return FALSE;
+    }
+
+  if (_syx_memory_initialized)
+    _syx_memory_release ();
+
+  capacity = (header.memory_size > _syx_memory_max_size ? header.memory_size : _syx_memory_max_size);
+
+#ifdef SYX_MEMORY_MMAP
+  /* reserve the whole capacity, then map the saved table over its beginning */
+  table = (SyxObject *) mmap (SYX_OOP_CAST_POINTER (header.table_base),
+                              SYX_MEMORY_MAPPED_ALIGNED (capacity * sizeof (SyxObject)),
+                              PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  space = NULL;
+  if (table != MAP_FAILED
+      && mmap (table, SYX_MEMORY_MAPPED_ALIGNED (header.memory_size * sizeof (SyxObject)),
+               PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno (image), header.table_offset) != MAP_FAILED)
+    space = (syx_int8 *) mmap (SYX_OOP_CAST_POINTER (header.space_base), SYX_MEMORY_MAPPED_ALIGNED (header.space_size),
+                               PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno (image), header.space_offset);
+
+  if (table == MAP_FAILED || !space || space == MAP_FAILED)
+    {
+      if (table != MAP_FAILED)
+        munmap (table, SYX_MEMORY_MAPPED_ALIGNED (capacity * sizeof (SyxObject)));
+      syx_free (indexes);
+      return FALSE;
+    }
+  _syx_memory_table_mapped = _syx_memory_space_mapped = TRUE;
+#else
+  table = (SyxObject *) syx_calloc (capacity, sizeof (SyxObject));
+  space = (syx_int8 *) syx_malloc (header.space_size);
+  if (fseek (image, header.table_offset, SEEK_SET)
+      || fread (table, sizeof (SyxObject), header.memory_size, image) != (size_t) header.memory_size
+      || fseek (image, header.space_offset, SEEK_SET)
+      || fread (space, 1, header.space_size, image) != (size_t) header.space_size)
+    {
+      syx_free (table);
+      syx_free (space);
+      syx_free (indexes);
+      return FALSE;
+    }
+#endif /* SYX_MEMORY_MMAP */
+
+  syx_memory = table;
+  _syx_memory_size = _syx_memory_initial_size = _syx_memory_image_size = header.memory_size;
+  _syx_memory_capacity = capacity;
+  _syx_memory_space = space;
+  _syx_memory_space_end = space + header.space_size;
+
+  _syx_freed_memory = (SyxOop *) syx_malloc (_syx_memory_size * sizeof (SyxOop));
+  for (_syx_freed_memory_top=0; _syx_freed_memory_top < header.freed_top; _syx_freed_memory_top++)
+    _syx_freed_memory[_syx_freed_memory_top] = (SyxOop)(syx_memory + indexes[_syx_freed_memory_top]);
+  _syx_memory_init_state ();
 
-  for (i=0; i < _syx_memory_gc_trans_top; i++)
-    SYX_OBJECT_IS_MARKED(_syx_memory_gc_trans[i]) = FALSE;
+  if ((SyxOop) syx_memory != header.table_base || (SyxOop) space != header.space_base)
+    _syx_memory_mapped_relocate (header.table_base, header.space_base, header.space_size);
 
-  _syx_memory_gc_trans_top = 0;
-  _syx_memory_gc_trans_running = 0;
+  syx_globals = (SyxOop)(syx_memory + header.globals);
+  syx_symbols = (SyxOop)(syx_memory + header.symbols);
+
+#ifdef HAVE_LIBGMP
+  for (i=header.freed_top; i < count; i++)
+    _syx_memory_mapped_large_integer (syx_memory + indexes[i]);
+#endif
+
+  syx_free (indexes);
+
+  /* deltas are appended after the space */
+  if (!_syx_memory_buffer_fill (&buffer, image, SYX_MEMORY_MAPPED_ALIGNED (header.space_offset + header.space_size)))
+    return FALSE;
+  ret = _syx_memory_read_deltas (&buffer);
+  syx_free (buffer.data);
+
+  return ret;
+}
+
+/*!
+  Loads the memory.
+
+  Both portable and mapped images are recognized, see syx_memory_set_image_format.
+  Deltas appended to the image by syx_memory_save_image_delta are applied as well.
+
+  \param path the file containing the data dumped by syx_memory_save_image
+  \return FALSE if an error occurred
+*/
+syx_bool
+syx_memory_load_image (syx_symbol path)
+{
+  SyxObject *object;
+  FILE *image;
+  char magic[sizeof (SYX_MEMORY_MAPPED_MAGIC) - 1];
+  syx_bool mapped, loaded;
+
+  SYX_START_PROFILE;
+
+  if (!path)
+    {
+      if (SYX_IS_NIL (syx_globals))
+        path = syx_get_image_path ();
+      else
+        path = SYX_OBJECT_SYMBOL (syx_globals_at ("ImageFileName"));
+    }
+
+  if (!path)
+    return FALSE;
+
+  image = fopen (path, "rb");
+  if (!image)
+    return FALSE;
+
+  /* the path might be held by the memory being replaced */
+  _syx_memory_set_image_path (path);
+
+  mapped = (fread (magic, sizeof (magic), 1, image) == 1
+            && !memcmp (magic, SYX_MEMORY_MAPPED_MAGIC, sizeof (magic)));
+  rewind (image);
+  if (mapped)
+    loaded = _syx_memory_load_mapped_image (image);
+  else
+    loaded = _syx_memory_load_portable_image (image);
+  fclose (image);
+
+  if (!loaded)
+    {
+      _syx_memory_set_image_path (NULL);
+      return FALSE;
+    }
+
+  /* objects are dirty once they are changed from now on */
+  _syx_memory_clean ();
+
+  syx_fetch_basic ();
+  _syx_memory_narrow_wide_integers ();
+
+  /* Reset the inline caches of send sites saved within the image.
+     All objects are old, only processes must be remembered. Finalizable objects are registered again */
+  syx_method_cache_invalidate ();
+  _syx_memory_nursery_top = 0;
+  _syx_memory_remembered_top = 0;
+  _syx_memory_gc_young_requested = FALSE;
+  for (object=syx_memory; object <= SYX_MEMORY_TOP; object++)
+    {
+      /* don't copy pages of mapped images needlessly */
+      if (object->is_young || object->is_remembered)
+        {
+          object->is_young = FALSE;
+          object->is_remembered = FALSE;
+        }
+      if (SYX_IS_NIL (SYX_OBJECT_CLASS (object)))
+        continue;
+
+      if (SYX_OBJECT_CLASS (object) == syx_process_class)
+        _syx_memory_remember ((SyxOop) object);
+      else if (SYX_IS_TRUE (SYX_CLASS_FINALIZATION (SYX_OBJECT_CLASS (object))))
+        syx_memory_finalization_register ((SyxOop) object);
+    }
+
+  /* Decode the portable bytecodes of methods and blocks.
+     Methods of mapped images are decoded once they're run, to touch as few pages as possible */
+  for (object=syx_memory; object <= SYX_MEMORY_TOP && !mapped; object++)
+    {
+      if ((SYX_OBJECT_CLASS (object) == syx_compiled_method_class || SYX_OBJECT_CLASS (object) == syx_compiled_block_class)
+          && SYX_IS_OBJECT (SYX_CODE_BYTECODES ((SyxOop) object)))
+        syx_code_decode ((SyxOop) object);
+    }
+
+  SYX_END_PROFILE(load_image);
+
+  syx_initialize_system ();
+
+  return TRUE;
 }
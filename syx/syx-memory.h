@@ -36,27 +36,200 @@ SYX_BEGIN_DECLS
 EXPORT SyxOop *_syx_freed_memory;
 EXPORT syx_int32 _syx_freed_memory_top;
 
-EXPORT SyxOop _syx_memory_gc_trans[0x100];
-EXPORT syx_int32 _syx_memory_gc_trans_top;
-EXPORT syx_int32 _syx_memory_gc_trans_running;
+/*! The number of handle scopes currently open */
+EXPORT syx_int32 _syx_memory_handle_scopes;
+
+/*! Set once the nursery is full, the interpreter will then collect young objects */
+EXPORT syx_bool _syx_memory_gc_young_requested;
+
+/*! Set while an incremental collection is marking objects, see syx_memory_gc_step */
+EXPORT syx_bool _syx_memory_gc_marking;
 
 EXPORT void syx_memory_init (syx_int32 size);
 EXPORT void syx_memory_clear (void);
 EXPORT SyxOop syx_memory_alloc (void);
 EXPORT void syx_memory_gc (void);
+EXPORT void syx_memory_gc_young (void);
+EXPORT void _syx_memory_remember (SyxOop object);
+EXPORT void _syx_memory_gc_shade (SyxOop object);
+EXPORT void _syx_memory_gc_push (SyxOop object);
+
+EXPORT void syx_memory_gc_step (void);
+EXPORT void syx_memory_gc_set_incremental (syx_bool incremental);
+EXPORT syx_bool syx_memory_gc_is_incremental (void);
+EXPORT void syx_memory_gc_set_pause_budget (syx_uint32 usecs);
+EXPORT syx_uint32 syx_memory_gc_get_pause_budget (void);
+EXPORT syx_uint64 syx_memory_gc_get_max_pause (void);
+EXPORT syx_uint64 syx_memory_gc_get_average_pause (void);
+
+EXPORT void syx_memory_set_max_size (syx_int32 size);
+EXPORT syx_int32 syx_memory_get_max_size (void);
+EXPORT void syx_memory_set_grow_threshold (syx_int32 percent);
+EXPORT syx_int32 syx_memory_get_grow_threshold (void);
+EXPORT void syx_memory_set_shrink_threshold (syx_int32 percent);
+EXPORT syx_int32 syx_memory_get_shrink_threshold (void);
+
+/*! The number of buckets of SyxMemoryStats::pauses */
+#define SYX_MEMORY_PAUSE_BUCKETS 5
+
+typedef struct SyxMemoryStats SyxMemoryStats;
+
+/*! Counters of the object memory since it has been initialized, see syx_memory_get_stats */
+struct SyxMemoryStats
+{
+  /*! Collections of the whole memory made by syx_memory_gc */
+  syx_uint32 full_collections;
+  /*! Collections of young objects */
+  syx_uint32 young_collections;
+  /*! Incremental collections completed by syx_memory_gc_step */
+  syx_uint32 incremental_collections;
+
+  syx_uint64 allocated_objects;
+  syx_uint64 reclaimed_objects;
+  /*! Bytes of the bodies of objects, see syx_memory_body_alloc */
+  syx_uint64 allocated_bytes;
+  syx_uint64 freed_bytes;
+  /*! Objects handed to the finalizer */
+  syx_uint64 finalized_objects;
+
+  /*! Number of pauses shorter than 100us, 1ms, 10ms, 100ms and the longer ones, in this order */
+  syx_uint32 pauses[SYX_MEMORY_PAUSE_BUCKETS];
+  /*! Longest and average pause in microseconds */
+  syx_uint64 max_pause;
+  syx_uint64 average_pause;
+
+  /*! The number of objects the memory can hold before growing, and the number of used objects */
+  syx_int32 size;
+  syx_int32 used;
+};
+
+EXPORT void syx_memory_get_stats (SyxMemoryStats *stats);
+EXPORT syx_bool syx_memory_set_log (syx_symbol path);
+EXPORT syx_int32 syx_memory_count_instances (SyxOop klass);
+EXPORT syx_int32 *syx_memory_count_all_instances (void);
+
+EXPORT void syx_memory_finalization_register (SyxOop object);
+EXPORT SyxOop syx_memory_finalization_next (void);
+
+/*! Bodies up to this number of bytes are carved from the arenas of the object space */
+#define SYX_MEMORY_BODY_MAX 512
+
+typedef union SyxMemoryChunk SyxMemoryChunk;
+
+/*! The header of a body allocated in the object space */
+union SyxMemoryChunk
+{
+  /*! The usable size of an allocated body */
+  syx_size size;
+  /*! The next free chunk of the same size class */
+  SyxMemoryChunk *next;
+  /*! Keeps bodies aligned for doubles */
+  syx_double align;
+};
+
+/*! Round a number of bytes to the alignment of bodies */
+#define SYX_MEMORY_BODY_ROUND(size) (((size) + sizeof (SyxMemoryChunk) - 1) & ~(sizeof (SyxMemoryChunk) - 1))
+
+EXPORT syx_pointer syx_memory_body_alloc (syx_size size);
+EXPORT void syx_memory_body_free (syx_pointer body);
+
+/*! Returns the usable size in bytes of a body allocated with syx_memory_body_alloc */
+INLINE syx_size
+syx_memory_body_size (syx_pointer body)
+{
+  return (((SyxMemoryChunk *) body) - 1)->size;
+}
+
+/*! Formats of the images written by syx_memory_save_image */
+typedef enum
+{
+  /*! Objects are stored field by field with a fixed byte order, any host can load the image */
+  SYX_MEMORY_IMAGE_PORTABLE,
+  /*! The object table and the bodies are stored as they're laid out in memory,
+    to be mapped back by hosts with the same word size and byte order */
+  SYX_MEMORY_IMAGE_MAPPED
+} SyxMemoryImageFormat;
 
 EXPORT syx_bool syx_memory_save_image (syx_symbol path);
+EXPORT syx_bool syx_memory_save_image_delta (syx_symbol path);
+EXPORT syx_bool syx_memory_externalize_sources (syx_symbol path);
+EXPORT syx_nint syx_memory_save_image_background (syx_symbol path);
+EXPORT syx_bool syx_memory_wait_image_background (void);
+EXPORT syx_bool syx_memory_is_saving_image_background (void);
 EXPORT syx_bool syx_memory_load_image (syx_symbol path);
+EXPORT void syx_memory_set_image_format (SyxMemoryImageFormat format);
+EXPORT SyxMemoryImageFormat syx_memory_get_image_format (void);
 
 /*! Frees the memory of a SyxOop and saves it to be reused for the next syx_memory_alloc */
 INLINE void
 syx_memory_free (SyxOop oop)
 {
   memset (SYX_OBJECT(oop), '\0', sizeof (SyxObject));
+  SYX_OBJECT_IS_DIRTY(oop) = TRUE;
   _syx_freed_memory[_syx_freed_memory_top++] = oop;
 }
 
 
+/*!
+  Add an old object to the remembered set, so that young objects it refers to
+  will survive the next young collection.
+
+  Use this when storing many references at once into an object, e.g. with memcpy.
+  An incremental collection will mark the references of the object again.
+*/
+INLINE void
+syx_memory_remember (SyxOop object)
+{
+  if (!SYX_IS_OBJECT (object))
+    return;
+
+  SYX_OBJECT_IS_DIRTY(object) = TRUE;
+  if (!SYX_OBJECT_IS_YOUNG (object) && !SYX_OBJECT_IS_REMEMBERED (object))
+    _syx_memory_remember (object);
+
+  if (_syx_memory_gc_marking && SYX_OBJECT_IS_MARKED (object))
+    _syx_memory_gc_push (object);
+}
+
+/*!
+  The write barrier. Must be called each time a value is stored into an object which
+  might be old, that is an object not created by the running C function.
+
+  While an incremental collection is marking, the stored object is marked too,
+  so that it can't be hidden into an object whose references have been already marked.
+  The object holding the reference is marked as dirty, see syx_memory_save_image_delta.
+
+  \param object the object holding the reference
+  \param value the stored object
+*/
+INLINE void
+syx_memory_write_barrier (SyxOop object, SyxOop value)
+{
+  if (SYX_IS_OBJECT (object))
+    SYX_OBJECT_IS_DIRTY(object) = TRUE;
+
+  if (!SYX_IS_OBJECT (value))
+    return;
+
+  if (SYX_OBJECT_IS_YOUNG (value) && SYX_IS_OBJECT (object)
+      && !SYX_OBJECT_IS_YOUNG (object) && !SYX_OBJECT_IS_REMEMBERED (object))
+    _syx_memory_remember (object);
+
+  if (_syx_memory_gc_marking && !SYX_OBJECT_IS_MARKED (value))
+    _syx_memory_gc_shade (value);
+}
+
+/*!
+  Collect young objects if the nursery is full.
+
+  Young collections only happen here, so that objects being built by C functions
+  are never promoted and they don't need the write barrier.
+  The interpreter calls this before each message send.
+*/
+#define syx_memory_gc_young_safepoint()                \
+  if (_syx_memory_gc_young_requested)                  \
+    syx_memory_gc_young ()
+
 /*! Returns the size of the memory */
 INLINE syx_int32
 syx_memory_get_size (void)
@@ -65,19 +238,23 @@ syx_memory_get_size (void)
 }
 
 /*!
-  Begins a garbage collection transaction.
+  Marks a position in the handle stack, see syx_memory_handle_scope_open.
 
-  In this transaction, all objects being allocated must not be freed because marked.
-  The transaction can hold up to 256 objects.
+  \code
+  SyxMemoryHandleScope scope = syx_memory_handle_scope_open ();
+  array = syx_array_new_size (count);
+  for (i=0; i < count; i++)
+    SYX_OBJECT_DATA(array)[i] = syx_string_new (strings[i]);
+  syx_memory_handle_scope_close (scope);
+  \endcode
 */
-INLINE void
-syx_memory_gc_begin (void)
-{
-  _syx_memory_gc_trans_running++;
-}
+typedef syx_int32 SyxMemoryHandleScope;
 
-/*! Release a transaction started with syx_memory_gc_begin and unmark all objects in the transaction */
-EXPORT void syx_memory_gc_end (void);
+EXPORT SyxMemoryHandleScope syx_memory_handle_scope_open (void);
+EXPORT void syx_memory_handle_scope_close (SyxMemoryHandleScope scope);
+EXPORT SyxOop syx_memory_handle (SyxOop object);
+EXPORT void syx_memory_root_add (SyxOop *root);
+EXPORT void syx_memory_root_remove (SyxOop *root);
 
 SYX_END_DECLS
 
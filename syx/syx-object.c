@@ -24,6 +24,7 @@
 
 #include "syx-memory.h"
 #include "syx-object.h"
+#include "syx-bytecode.h"
 #include "syx-interp.h"
 #include "syx-error.h"
 #include "syx-enums.h"
@@ -65,8 +66,10 @@ SyxOop syx_nil,
   syx_string_class,
   syx_byte_array_class,
   syx_array_class,
+  syx_weak_array_class,
 
   syx_variable_binding_class,
+  syx_ephemeron_class,
   syx_dictionary_class,
 
   syx_compiled_method_class,
@@ -107,22 +110,95 @@ syx_object_initialize (SyxOop oop)
     }
 }
 
+/* TRUE if the data lives in the same body of instance variables */
+static syx_bool
+_syx_object_data_is_inline (SyxObject *object)
+{
+  return object->data && object->vars
+    && (syx_int8 *)object->data >= (syx_int8 *)object->vars
+    && (syx_int8 *)object->data < (syx_int8 *)object->vars + syx_memory_body_size (object->vars);
+}
+
+/*!
+  Allocate instance variables and data of an object in a single body of the object space.
+  SyxObject::has_refs must be already set.
+
+  \param vars_size number of instance variables
+  \param size number of objects/bytes to hold
+*/
+void
+syx_object_alloc_body (SyxOop object, syx_varsize vars_size, syx_varsize size)
+{
+  SyxObject *obj = SYX_OBJECT (object);
+  syx_size vars_bytes = SYX_MEMORY_BODY_ROUND (vars_size * sizeof (SyxOop));
+  syx_size data_bytes = (obj->has_refs ? (syx_size) (size * sizeof (SyxOop)) : size);
+
+  obj->vars = (SyxOop *) syx_memory_body_alloc (vars_bytes + data_bytes);
+  obj->data_size = size;
+  obj->is_dirty = TRUE;
+  obj->data = (size > 0 ? (SyxOop *)((syx_int8 *)obj->vars + vars_bytes) : NULL);
+}
+
+/*! Frees instance variables and data of an object, but not the object itself */
+void
+syx_object_free_body (SyxOop object)
+{
+  SyxObject *obj = SYX_OBJECT (object);
+
+  if (obj->data && !_syx_object_data_is_inline (obj))
+    syx_free (obj->data);
+  if (obj->vars)
+    syx_memory_body_free (obj->vars);
+  obj->vars = NULL;
+  obj->data = NULL;
+}
+
+/*!
+  Replace SyxObject::data with the given data, which must be allocated with syx_malloc.
+  The previous data is freed.
+*/
+void
+syx_object_set_data (SyxOop object, SyxOop *data, syx_varsize size)
+{
+  SyxObject *obj = SYX_OBJECT (object);
+
+  if (obj->data && !_syx_object_data_is_inline (obj))
+    syx_free (obj->data);
+  obj->data = data;
+  obj->data_size = size;
+  obj->is_dirty = TRUE;
+}
+
 /*!
   Resize SyxObject::data to the given size, being careful of object indexables and byte indexables.
 
+  Data living in the body of the object is moved outside once it grows.
   Warning, if the new size is lesser than the current, the data at the end of the array will be lost
 */
 void
 syx_object_resize (SyxOop object, syx_varsize size)
 {
-  if (SYX_OBJECT_HAS_REFS (object))
-    SYX_OBJECT_DATA(object) = (SyxOop *) syx_realloc (SYX_OBJECT_DATA(object),
-                                                      size * sizeof (SyxOop));
+  SyxObject *obj = SYX_OBJECT (object);
+  syx_int32 element_size = (obj->has_refs ? sizeof (SyxOop) : sizeof (syx_int8));
+  SyxOop *data;
+
+  obj->is_dirty = TRUE;
+  if (_syx_object_data_is_inline (obj))
+    {
+      if (size <= obj->data_size)
+        {
+          obj->data_size = size;
+          return;
+        }
+
+      data = (SyxOop *) syx_malloc (size * element_size);
+      memcpy (data, obj->data, obj->data_size * element_size);
+      obj->data = data;
+    }
   else
-    SYX_OBJECT_DATA(object) = (SyxOop *) syx_realloc (SYX_OBJECT_DATA(object),
-                                                      size * sizeof (syx_int8));
+    obj->data = (SyxOop *) syx_realloc (obj->data, size * element_size);
 
-  SYX_OBJECT_DATA_SIZE(object) = size;
+  obj->data_size = size;
 }
 
 
@@ -207,12 +283,12 @@ syx_large_integer_new_mpz (syx_pointer mpz)
 }
 
 /*!
-  Transform a 32-bit integer to a multiple precision integer.
+  Transform a native integer to a multiple precision integer.
 
   \b This function is available only if Syx has been linked with the GMP library
 */
 SyxOop
-syx_large_integer_new_integer (syx_int32 i)
+syx_large_integer_new_integer (syx_nint i)
 {
 #ifdef HAVE_LIBGMP
   mpz_t *z = syx_calloc (1, sizeof (mpz_t));
@@ -303,6 +379,7 @@ syx_array_add (SyxOop array, SyxOop element, syx_bool unique)
 
   syx_object_grow_by (array, 1);
   SYX_OBJECT_DATA(array)[size] = element;
+  syx_memory_write_barrier (array, element);
 }
 
 /*!
@@ -347,6 +424,7 @@ syx_symbol_new (syx_symbol symbol)
   SYX_SYMBOL_HASH(obj) = syx_small_integer_new (hash);
   table[index] = obj;
   table[index+1] = obj;
+  syx_memory_write_barrier (syx_symbols, obj);
   SYX_DICTIONARY_TALLY (syx_symbols) = syx_small_integer_new (tally + 1);
 
   return obj;
@@ -361,7 +439,7 @@ syx_string_hash (syx_symbol string)
   for (ret=0, string = string + 1; *string != '\0'; string++)
     ret += *string + *(string - 1);
 
-  if (!SYX_SMALL_INTEGER_CAN_EMBED (ret))
+  if (!SYX_SMALL_INTEGER_CAN_EMBED_INT32 (ret))
     ret >>= 2;
 
   return SYX_SMALL_INTEGER_EMBED (ret);
@@ -565,6 +643,7 @@ syx_dictionary_bind_set_value (SyxOop binding, SyxOop value)
 
   SYX_ASSOCIATION_VALUE (binding) = syx_small_integer_new (index);
   table[index+1] = value;
+  syx_memory_write_barrier (dict, value);
 }
 
 /*!
@@ -608,10 +687,15 @@ syx_dictionary_rehash (SyxOop dict)
   syx_int32 tally = SYX_SMALL_INTEGER (SYX_DICTIONARY_TALLY (dict));
   syx_varsize newsize = size * 2;
   SyxOop *table = SYX_OBJECT_DATA (dict);
-  SyxOop newdict = syx_dictionary_new (newsize);
+  SyxOop newdict;
   SyxOop entry;
   syx_int32 i;
 
+  /* the table is going to be stolen, so don't allocate it within the body of the new dictionary */
+  newdict = syx_object_new_data (syx_dictionary_class, TRUE, newsize * 2,
+                                 (SyxOop *) syx_calloc (newsize * 2, sizeof (SyxOop)));
+  SYX_DICTIONARY_TALLY (newdict) = syx_small_integer_new (0);
+
   for (i=0; tally && i < size; i+=2)
     {
       entry = table[i];
@@ -622,10 +706,10 @@ syx_dictionary_rehash (SyxOop dict)
         }
     }
 
-  syx_free (SYX_OBJECT_DATA (dict));
-  SYX_OBJECT_DATA (dict) = SYX_OBJECT_DATA (newdict);
-  SYX_OBJECT_DATA_SIZE (dict) = SYX_OBJECT_DATA_SIZE (newdict);
-  syx_free (SYX_OBJECT_VARS (newdict));
+  syx_object_set_data (dict, SYX_OBJECT_DATA (newdict), SYX_OBJECT_DATA_SIZE (newdict));
+  syx_memory_remember (dict);
+  SYX_OBJECT_DATA (newdict) = NULL;
+  syx_object_free_body (newdict);
   syx_memory_free (newdict);
 }
 
@@ -650,6 +734,8 @@ syx_dictionary_at_symbol_put (SyxOop dict, SyxOop key, SyxOop value)
   table = SYX_OBJECT_DATA (dict);
   table[index] = key;
   table[index+1] = value;
+  syx_memory_write_barrier (dict, key);
+  syx_memory_write_barrier (dict, value);
   SYX_DICTIONARY_TALLY (dict) = syx_small_integer_new (tally + 1);
 }
 
@@ -665,10 +751,11 @@ SyxOop
 syx_method_context_new (SyxOop method, SyxOop receiver, SyxOop arguments)
 {
   SyxOop object;
+  SyxMemoryHandleScope scope;
 
   SYX_START_PROFILE;
 
-  syx_memory_gc_begin ();
+  scope = syx_memory_handle_scope_open ();
 
   object = syx_object_new (syx_method_context_class);
 
@@ -677,7 +764,7 @@ syx_method_context_new (SyxOop method, SyxOop receiver, SyxOop arguments)
   SYX_CONTEXT_PART_ARGUMENTS(object) = arguments;
   SYX_METHOD_CONTEXT_RECEIVER(object) = receiver;
 
-  syx_memory_gc_end ();
+  syx_memory_handle_scope_close (scope);
 
   SYX_END_PROFILE(method_context);
 
@@ -711,6 +798,15 @@ syx_block_context_new (SyxOop closure, SyxOop arguments)
 
 /* Object */
 
+/* Let the garbage collector know when an object must be finalized */
+static void
+_syx_object_register_finalization (SyxOop object, SyxOop klass)
+{
+  if (!SYX_IS_NIL (klass) && SYX_OBJECT_VARS (klass)
+      && SYX_IS_TRUE (SYX_CLASS_FINALIZATION (klass)))
+    syx_memory_finalization_register (object);
+}
+
 /*!
   Create a new object specifying an arbitrary number of instance variables.
 
@@ -723,12 +819,11 @@ syx_object_new_vars (SyxOop klass, syx_varsize vars_size)
   SyxOop oop = syx_memory_alloc ();
   SyxObject *object = SYX_OBJECT (oop);
 
-  object->klass = klass;
+  SYX_OBJECT_SET_CLASS (object, klass);
   object->has_refs = FALSE;
   object->is_constant = FALSE;
-  object->vars = (SyxOop *) syx_calloc (vars_size, sizeof (SyxOop));
-  object->data_size = 0;
-  object->data = NULL;
+  syx_object_alloc_body (oop, vars_size, 0);
+  _syx_object_register_finalization (oop, klass);
 
   return oop;
 }
@@ -742,14 +837,16 @@ syx_object_new_vars (SyxOop klass, syx_varsize vars_size)
 SyxOop 
 syx_object_new_size (SyxOop klass, syx_bool has_refs, syx_varsize size)
 {
-  SyxObject *object = SYX_OBJECT (syx_object_new (klass));
+  SyxOop oop = syx_memory_alloc ();
+  SyxObject *object = SYX_OBJECT (oop);
 
+  SYX_OBJECT_SET_CLASS (object, klass);
   object->has_refs = has_refs;
-  object->data_size = size;
-  object->data = (SyxOop *) (has_refs
-                             ? syx_calloc (size, sizeof (SyxOop))
-                             : syx_calloc (size, sizeof (syx_int8)));
-  return (SyxOop)object;
+  object->is_constant = FALSE;
+  syx_object_alloc_body (oop, SYX_SMALL_INTEGER (SYX_CLASS_INSTANCE_SIZE (klass)), size);
+  _syx_object_register_finalization (oop, klass);
+
+  return oop;
 }
 
 /*!
@@ -778,6 +875,7 @@ syx_object_copy (SyxOop object)
   SyxOop oop;
   SyxObject *obj1;
   SyxObject *obj2;
+  syx_varsize vars_size;
 
   if (!SYX_IS_OBJECT (object))
     return object;
@@ -786,53 +884,47 @@ syx_object_copy (SyxOop object)
   obj1 = SYX_OBJECT (oop);
   obj2 = SYX_OBJECT (object);
 
-  obj1->klass = obj2->klass;
+  obj1->class_index = obj2->class_index;
   obj1->has_refs = obj2->has_refs;
   obj1->is_constant = FALSE;
 
-  obj1->vars = (SyxOop *) syx_memdup (obj2->vars, SYX_SMALL_INTEGER(SYX_CLASS_INSTANCE_SIZE (obj1->klass)),
-                                      sizeof (SyxOop));
+  vars_size = SYX_SMALL_INTEGER(SYX_CLASS_INSTANCE_SIZE (SYX_OBJECT_CLASS (obj1)));
+  syx_object_alloc_body (oop, vars_size, obj2->data_size);
+  memcpy (obj1->vars, obj2->vars, vars_size * sizeof (SyxOop));
+  /* decoded bytecodes are owned by the original code */
+  if (SYX_CODE_IS_CODE (oop))
+    SYX_CODE_DECODED_BYTECODES(oop) = syx_nil;
 
-  obj1->data_size = obj2->data_size;
-  if (obj2->data)
-    {
-      if (obj1->has_refs)
-        obj1->data = (SyxOop *) syx_memdup (obj2->data, obj1->data_size, sizeof (SyxOop));
-      else
-        obj1->data = (SyxOop *) syx_memdup (obj2->data, obj1->data_size, sizeof (syx_int8));
-    }
+  if (obj1->data_size > 0)
+    memcpy (obj1->data, obj2->data,
+            obj1->data_size * (obj1->has_refs ? sizeof (SyxOop) : sizeof (syx_int8)));
 
+  _syx_object_register_finalization (oop, SYX_OBJECT_CLASS (obj1));
   return oop;
 }
 
 /*!
   Frees all the memory used by the object.
 
-  If the class has finalizationRequest set to true, perform #finalize on the object
+  Objects whose class has finalizationRequest set to true are not finalized here.
+  The garbage collector puts them into the finalization queue before they can be freed.
 */
 void
 syx_object_free (SyxOop object)
 {
-  SyxOop process, context, klass;
-  if (!SYX_IS_OBJECT (object))
+  if (!SYX_IS_OBJECT (object) || SYX_IS_NIL (syx_object_get_class (object)))
     return;
 
-  klass = syx_object_get_class (object);
-  if (SYX_IS_NIL (klass))
-    return;
+#ifdef HAVE_LIBGMP
+  /* release the digits of large integers */
+  if (SYX_OBJECT_IS_LARGE_INTEGER (object))
+    mpz_clear (SYX_OBJECT_LARGE_INTEGER (object));
+#endif
 
-  if (SYX_IS_TRUE (SYX_CLASS_FINALIZATION (klass)))
-    {
-      process = syx_process_new ();
-      context = syx_send_unary_message (object, "finalize");
-      syx_interp_enter_context (process, context);
-      syx_process_execute_blocking (process);
-    }
+  if (SYX_CODE_IS_CODE (object))
+    syx_code_free_decoded (object);
 
-  if (SYX_OBJECT_VARS (object))
-    syx_free (SYX_OBJECT_VARS (object));
-  if (SYX_OBJECT_DATA (object))
-    syx_free (SYX_OBJECT_DATA (object));
+  syx_object_free_body (object);
   syx_memory_free (object);
 }
 
@@ -920,9 +1012,180 @@ syx_class_lookup_method (SyxOop klass, syx_symbol selector)
   return syx_nil;
 }
 
+/* Global method lookup cache, indexed by class and selector */
+
+typedef struct SyxMethodCacheEntry SyxMethodCacheEntry;
+struct SyxMethodCacheEntry
+{
+  SyxOop klass;
+  SyxOop selector;
+  SyxOop method;
+};
+
+static SyxMethodCacheEntry _syx_method_cache[SYX_METHOD_CACHE_SIZE];
+syx_uint32 _syx_method_cache_hits = 0;
+syx_uint32 _syx_method_cache_misses = 0;
+
+#define _SYX_METHOD_CACHE_INDEX(klass,selector) \
+  ((((syx_nint)(klass) ^ (syx_nint)(selector)) >> 2) & (SYX_METHOD_CACHE_SIZE - 1))
+
+/*!
+  Invalidate all the entries of the global method lookup cache.
+
+  This is called after the garbage collector has released objects, because freed oops
+  can be reused for new classes.
+*/
+void
+syx_method_cache_flush (void)
+{
+  memset (_syx_method_cache, '\0', sizeof (_syx_method_cache));
+}
+
+/*!
+  Invalidate both the global method lookup cache and the inline caches of all send sites.
+
+  This must be called each time a method dictionary or the hierarchy of a class changes.
+  Send sites are cleared, so they don't keep replaced methods alive.
+  Bindings are left clean and untouched slots aren't written, not to copy pages of mapped images.
+*/
+void
+syx_method_cache_invalidate (void)
+{
+  SyxObject *object;
+  syx_varsize i;
+
+  syx_method_cache_flush ();
+
+  /* free entries have no class */
+  if (SYX_IS_NIL (syx_variable_binding_class))
+    return;
+
+  for (object=syx_memory; object < syx_memory + _syx_memory_size; object++)
+    {
+      if (SYX_OBJECT_CLASS (object) != syx_variable_binding_class
+          || object->data_size != SYX_INLINE_CACHE_SIZE)
+        continue;
+
+      for (i=0; i < SYX_INLINE_CACHE_SIZE; i++)
+        {
+          if (!SYX_IS_NIL (object->data[i]))
+            object->data[i] = syx_nil;
+        }
+    }
+}
+
+/*!
+  Decode the portable bytecodes of a CompiledMethod or a CompiledBlock into the native form
+  executed by the interpreter. Old decoded bytecodes are released.
+
+  Decoded bytecodes are allocated out of the object memory, so this is safe while the garbage collector
+  can't run.
+
+  \return the decoded instructions
+*/
+syx_uint32 *
+syx_code_decode (SyxOop code)
+{
+  SyxOop bytecodes = SYX_CODE_BYTECODES (code);
+  syx_varsize count = SYX_OBJECT_DATA_SIZE (bytecodes) / sizeof (syx_uint16);
+  SyxCodeDecoded *decoded;
+
+  syx_code_free_decoded (code);
+
+  decoded = (SyxCodeDecoded *) syx_malloc (sizeof (SyxCodeDecoded) + count * sizeof (syx_uint32));
+  decoded->bytecodes = bytecodes;
+  syx_bytecode_decode ((syx_uint16 *)SYX_OBJECT_DATA (bytecodes), count, decoded->words);
+
+  SYX_CODE_DECODED_BYTECODES(code) = SYX_POINTER_CAST_OOP (decoded);
+  return decoded->words;
+}
+
+/*! Release the decoded bytecodes of a CompiledMethod or a CompiledBlock */
+void
+syx_code_free_decoded (SyxOop code)
+{
+  SyxOop decoded = SYX_CODE_DECODED_BYTECODES (code);
+
+  if (SYX_IS_CPOINTER (decoded))
+    syx_free (SYX_OOP_CAST_POINTER (decoded));
+
+  SYX_CODE_DECODED_BYTECODES(code) = syx_nil;
+}
+
+/*!
+  Read the source of a CompiledMethod or a CompiledBlock moved out of the image by syx_memory_externalize_sources.
+  The text of the code holds the position of the source in the file named by the SourcesFileName global,
+  where it's terminated by a NUL character.
+
+  \return a new string to be freed with syx_free, or NULL if the source can't be read
+*/
+syx_string
+syx_code_read_text (SyxOop code)
+{
+  SyxOop text = SYX_CODE_TEXT (code);
+  SyxOop path = syx_globals_at_if_absent ("SourcesFileName", syx_nil);
+  FILE *sources;
+  syx_string source = NULL;
+  syx_varsize size = 0;
+  syx_varsize capacity = 256;
+  int c;
+
+  if (!SYX_IS_SMALL_INTEGER (text) || !SYX_OBJECT_IS_STRING (path))
+    return NULL;
+
+  sources = fopen (SYX_OBJECT_SYMBOL (path), "rb");
+  if (!sources)
+    return NULL;
+
+  if (!fseek (sources, SYX_SMALL_INTEGER (text), SEEK_SET))
+    {
+      source = (syx_string) syx_malloc (capacity);
+      while ((c = getc (sources)) != EOF && c)
+        {
+          if (size + 1 == capacity)
+            {
+              capacity *= 2;
+              source = (syx_string) syx_realloc (source, capacity);
+            }
+          source[size++] = c;
+        }
+      source[size] = '\0';
+
+      /* the file has been truncated */
+      if (c == EOF)
+        {
+          syx_free (source);
+          source = NULL;
+        }
+    }
+
+  fclose (sources);
+  return source;
+}
+
+/*!
+  Returns the source of a CompiledMethod or a CompiledBlock as a String.
+
+  The source kept in the sources file is read each time, so it's not held by the memory.
+
+  \return syx_nil if the source isn't available
+*/
+SyxOop
+syx_code_get_text (SyxOop code)
+{
+  SyxOop text = SYX_CODE_TEXT (code);
+
+  if (!SYX_IS_SMALL_INTEGER (text))
+    return text;
+
+  return syx_string_new_ref (syx_code_read_text (code));
+}
+
 /*!
   A mix between syx_class_lookup_method and syx_dictionary_bind_if_absent.
 
+  The result is cached in the global method lookup cache. Only found methods are cached.
+
   \return syx_nil if no method has been found
 */
 SyxOop 
@@ -930,16 +1193,31 @@ syx_class_lookup_method_binding (SyxOop klass, SyxOop binding)
 {
   SyxOop cur;
   SyxOop method;
-  
+  SyxOop selector = SYX_ASSOCIATION_KEY (binding);
+  SyxMethodCacheEntry *entry = &_syx_method_cache[_SYX_METHOD_CACHE_INDEX (klass, selector)];
+
+  if (entry->klass == klass && entry->selector == selector)
+    {
+      _syx_method_cache_hits++;
+      return entry->method;
+    }
+
+  _syx_method_cache_misses++;
   for (cur=klass; !SYX_IS_NIL (cur); cur = SYX_CLASS_SUPERCLASS (cur))
     {
       if (SYX_IS_NIL (SYX_CLASS_METHODS (cur)))
         continue;
       
       SYX_VARIABLE_BINDING_DICTIONARY (binding) = SYX_CLASS_METHODS (cur);
+      syx_memory_write_barrier (binding, SYX_CLASS_METHODS (cur));
       method = syx_dictionary_bind_if_absent (binding, syx_nil);
       if (!SYX_IS_NIL (method))
-        return method;
+        {
+          entry->klass = klass;
+          entry->selector = selector;
+          entry->method = method;
+          return method;
+        }
     }
   
   return syx_nil;
@@ -975,6 +1253,7 @@ syx_semaphore_signal (SyxOop semaphore)
   /* create a new array without signaled processes */
   SYX_SEMAPHORE_LIST(semaphore) = syx_array_new_ref (SYX_OBJECT_DATA_SIZE(list) - i,
                                                      SYX_OBJECT_DATA(list) + i);
+  syx_memory_write_barrier (semaphore, SYX_SEMAPHORE_LIST(semaphore));
   SYX_SEMAPHORE_SIGNALS(semaphore) = syx_small_integer_new (signals);
 
   /* release */
@@ -1003,6 +1282,7 @@ syx_semaphore_wait (SyxOop semaphore)
   SYX_PROCESS_SUSPENDED (process) = syx_true;
   syx_object_grow_by (list, 1);
   SYX_OBJECT_DATA(list)[SYX_OBJECT_DATA_SIZE(list) - 1] = process;
+  syx_memory_write_barrier (list, process);
 
   /* release */
   _syx_sem_lock--;
@@ -1013,23 +1293,18 @@ syx_semaphore_wait (SyxOop semaphore)
 
 /*! TRUE if an overflow occurs when doing b times a */
 syx_bool
-SYX_SMALL_INTEGER_MUL_OVERFLOW (syx_int32 a, syx_int32 b)
+SYX_SMALL_INTEGER_MUL_OVERFLOW (syx_nint a, syx_nint b)
 {
-#ifdef HAVE_INT64_T
-  syx_int64 res = (syx_int64)a * (syx_int64)b;
-  if ((res > INT_MAX) || (res < INT_MIN))
-    return TRUE;
-#else
   if (a > 0) 
     {
       if (b > 0)
         {
-          if (a > (INT_MAX / b))
+          if (a > (LONG_MAX / b))
             return TRUE;
         } 
       else
         {
-          if (b < (INT_MIN / a))
+          if (b < (LONG_MIN / a))
             return TRUE;
         } 
     } 
@@ -1037,33 +1312,32 @@ SYX_SMALL_INTEGER_MUL_OVERFLOW (syx_int32 a, syx_int32 b)
     { 
       if (b > 0)
         { 
-          if (a < (INT_MIN / b))
+          if (a < (LONG_MIN / b))
             return TRUE;
         } 
       else
         { 
-          if ( (a != 0) && (b < (INT_MAX / a)))
+          if ( (a != 0) && (b < (LONG_MAX / a)))
             return TRUE;
         } 
     }
-#endif
 
   return FALSE;
 }
 
 /*! TRUE if an overflow occurs when shifting a by b */
 syx_bool
-SYX_SMALL_INTEGER_SHIFT_OVERFLOW (syx_int32 a, syx_int32 b)
+SYX_SMALL_INTEGER_SHIFT_OVERFLOW (syx_nint a, syx_nint b)
 {
   /* Thanks to Sam Philips */
   syx_int32 i;
-  syx_int32 sval;
+  syx_nint sval;
 
   if (b <= 0)
     return FALSE;
 
   i = 0;
-  sval = abs(a);
+  sval = labs (a);
 
   while (sval >= 16)
     {
@@ -1077,7 +1351,7 @@ SYX_SMALL_INTEGER_SHIFT_OVERFLOW (syx_int32 a, syx_int32 b)
       i++;
     }
   
-  if ((i + b) > 30)
+  if ((i + b) > (syx_nint) SYX_SMALL_INTEGER_BITS - 1)
     return TRUE;
 
   return FALSE;
@@ -57,6 +57,9 @@ SYX_BEGIN_DECLS
 #define SYX_OBJECT_HAS_REFS(oop) (SYX_OBJECT(oop)->has_refs)
 #define SYX_OBJECT_IS_MARKED(oop) (SYX_OBJECT(oop)->is_marked)
 #define SYX_OBJECT_IS_CONSTANT(oop) (SYX_OBJECT(oop)->is_constant)
+#define SYX_OBJECT_IS_YOUNG(oop) (SYX_OBJECT(oop)->is_young)
+#define SYX_OBJECT_IS_REMEMBERED(oop) (SYX_OBJECT(oop)->is_remembered)
+#define SYX_OBJECT_IS_DIRTY(oop) (SYX_OBJECT(oop)->is_dirty)
 
 #define SYX_IS_NIL(oop) ((oop) == 0 || (oop) == syx_nil)
 #define SYX_IS_TRUE(oop) ((oop) == syx_true)
@@ -69,38 +72,55 @@ SYX_BEGIN_DECLS
                               ((oop) < (SyxOop)syx_memory ||            \
                                (oop) >= (SyxOop)(syx_memory + _syx_memory_size)))
 
-#define SYX_OBJECT_IS_STRING(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT(oop)->klass == syx_string_class)
-#define SYX_OBJECT_IS_SYMBOL(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT(oop)->klass == syx_symbol_class)
-#define SYX_OBJECT_IS_FLOAT(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT(oop)->klass == syx_float_class)
-#define SYX_OBJECT_IS_LARGE_INTEGER(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT(oop)->klass == syx_large_integer_class)
+#define SYX_OBJECT_IS_STRING(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT_CLASS(oop) == syx_string_class)
+#define SYX_OBJECT_IS_SYMBOL(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT_CLASS(oop) == syx_symbol_class)
+#define SYX_OBJECT_IS_FLOAT(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT_CLASS(oop) == syx_float_class)
+#define SYX_OBJECT_IS_LARGE_INTEGER(oop) (SYX_IS_OBJECT(oop) && SYX_OBJECT_CLASS(oop) == syx_large_integer_class)
 
 /* Oop */
 
 typedef struct SyxObject SyxObject;
 
-/*! The core class of Syx holding necessary informations for each concrete object. */
+/*! Bits of the object header holding the index of the class in the object table */
+#define SYX_OBJECT_CLASS_BITS 26
+
+/*!
+  The core class of Syx holding necessary informations for each concrete object.
+
+  The class is kept as an index in the object table and packed together with the flags
+  into a single word, so that the header takes 24 bytes on 64-bit hosts and 16 bytes on 32-bit hosts.
+*/
 struct SyxObject
 {
-  /*! Holds the class of the instance. Please use syx_object_get_class to obtain a class from a SyxOop */
-  SyxOop klass;
+  /*! A list of SyxOop containing instance variables. */
+  SyxOop *vars;
+
+  /*! This holds the data stored for the object. These can be oops, bytes, doubles and so on. */
+  SyxOop *data;
+
+  /*! Index of the class in the object table. Please use syx_object_get_class to obtain a class from a SyxOop */
+  unsigned int class_index : SYX_OBJECT_CLASS_BITS;
   
   /*! Specify if this object contains references to other objects in its data */
-  syx_bool has_refs;
+  unsigned int has_refs : 1;
 
   /*! Used to mark the object by the garbage collector */
-  syx_bool is_marked;
+  unsigned int is_marked : 1;
 
   /*! Set to TRUE if data shouldn't be modified */
-  syx_bool is_constant;
+  unsigned int is_constant : 1;
 
-  /*! A list of SyxOop containing instance variables. */
-  SyxOop *vars;
+  /*! Set to TRUE until the object survives a young collection */
+  unsigned int is_young : 1;
+
+  /*! Set to TRUE if the object is old and it's in the remembered set */
+  unsigned int is_remembered : 1;
+
+  /*! Set to TRUE if the object has changed since the image has been saved or loaded */
+  unsigned int is_dirty : 1;
 
   /*! The number of data elements held by the object */
   syx_varsize data_size;
-
-  /*! This holds the data stored for the object. These can be oops, bytes, doubles and so on. */
-  SyxOop *data;
 };
 
 EXPORT SyxObject *syx_memory;
@@ -109,6 +129,13 @@ EXPORT syx_int32 _syx_memory_size;
 /*! Returns the index of the oop in the object table */
 #define SYX_MEMORY_INDEX_OF(oop) ((((SyxOop)oop) - (SyxOop)syx_memory) / sizeof (SyxObject))
 
+/*! The class of an object which is not an immediate value. Free entries of the object table answer nil */
+#define SYX_OBJECT_CLASS(oop) ((SyxOop)(syx_memory + SYX_OBJECT(oop)->class_index))
+
+/*! Set the class of an object which is not an immediate value */
+#define SYX_OBJECT_SET_CLASS(oop, klass)                                \
+  (SYX_OBJECT(oop)->class_index = (SYX_IS_NIL (klass) ? 0 : SYX_MEMORY_INDEX_OF (klass)))
+
 
 /* References to commonly used oops */
 
@@ -130,8 +157,10 @@ EXPORT SyxOop syx_nil,
   syx_string_class,
   syx_byte_array_class,
   syx_array_class,
+  syx_weak_array_class,
 
   syx_variable_binding_class,
+  syx_ephemeron_class,
   syx_dictionary_class,
 
   syx_compiled_method_class,
@@ -153,6 +182,9 @@ EXPORT SyxOop syx_object_new_data (SyxOop klass, syx_bool has_refs, syx_varsize
 EXPORT SyxOop syx_object_copy (SyxOop object);
 EXPORT void syx_object_free (SyxOop oop);
 EXPORT void syx_object_resize (SyxOop oop, syx_varsize size);
+EXPORT void syx_object_alloc_body (SyxOop object, syx_varsize vars_size, syx_varsize size);
+EXPORT void syx_object_free_body (SyxOop object);
+EXPORT void syx_object_set_data (SyxOop object, SyxOop *data, syx_varsize size);
 #define syx_object_grow_by(oop,size) (syx_object_resize((oop),SYX_OBJECT_DATA_SIZE(oop)+size))
 EXPORT syx_int32 syx_object_get_variable_index (SyxOop self, syx_symbol name);
 EXPORT void syx_object_initialize (SyxOop oop);
@@ -182,7 +214,7 @@ syx_object_get_class (SyxOop object)
   /* ordered by usage */ 
 
   if (SYX_IS_OBJECT(object))
-    return SYX_OBJECT(object)->klass;
+    return SYX_OBJECT_CLASS (object);
 
   if (SYX_IS_SMALL_INTEGER(object))
     return syx_small_integer_class;
@@ -213,7 +245,7 @@ syx_object_set_class (SyxOop object, SyxOop klass)
   if (!SYX_IS_OBJECT(object))
     return;
 
-  SYX_OBJECT(object)->klass = klass;
+  SYX_OBJECT_SET_CLASS (object, klass);
 }
 
 EXPORT syx_symbol *syx_class_get_all_instance_variable_names (SyxOop klass);
@@ -221,6 +253,37 @@ EXPORT syx_bool syx_class_is_superclass_of (SyxOop klass, SyxOop subclass);
 EXPORT SyxOop syx_class_lookup_method (SyxOop klass, syx_symbol selector);
 EXPORT SyxOop syx_class_lookup_method_binding (SyxOop klass, SyxOop binding);
 
+/*! The number of entries in the global method lookup cache. Must be a power of 2 */
+#define SYX_METHOD_CACHE_SIZE 1024
+
+/*! The number of receiver classes a polymorphic send site can cache */
+#define SYX_INLINE_CACHE_ENTRIES 4
+/*! The size of the inline cache held by the VariableBinding of a send site */
+#define SYX_INLINE_CACHE_SIZE (1 + SYX_INLINE_CACHE_ENTRIES * 2)
+
+EXPORT syx_uint32 _syx_method_cache_hits;
+EXPORT syx_uint32 _syx_method_cache_misses;
+
+EXPORT void syx_method_cache_flush (void);
+EXPORT void syx_method_cache_invalidate (void);
+
+typedef struct SyxCodeDecoded SyxCodeDecoded;
+
+/*! The native bytecodes of a CompiledMethod or a CompiledBlock, held by SYX_CODE_DECODED_BYTECODES.
+  They're never saved into the image, which only contains the portable bytecodes */
+struct SyxCodeDecoded
+{
+  /*! The ByteArray of portable bytecodes that has been decoded */
+  SyxOop bytecodes;
+  /*! Decoded instructions, look at SYX_BYTECODE_DECODED_WIDE */
+  syx_uint32 words[1];
+};
+
+EXPORT syx_uint32 *syx_code_decode (SyxOop code);
+EXPORT void syx_code_free_decoded (SyxOop code);
+EXPORT syx_string syx_code_read_text (SyxOop code);
+EXPORT SyxOop syx_code_get_text (SyxOop code);
+
 EXPORT syx_int32 syx_dictionary_index_of (SyxOop dict, syx_symbol key, syx_int32 hash, syx_bool return_nil_index);
 EXPORT void syx_dictionary_rehash (SyxOop dict);
 EXPORT SyxOop syx_dictionary_binding_at_symbol (SyxOop dict, syx_symbol key);
@@ -240,7 +303,7 @@ EXPORT syx_int32 syx_string_hash (syx_symbol string);
 EXPORT SyxOop syx_metaclass_new (SyxOop supermetaclass);
 EXPORT SyxOop syx_class_new (SyxOop superclass);
 EXPORT SyxOop syx_large_integer_new (syx_symbol string, syx_int32 base);
-EXPORT SyxOop syx_large_integer_new_integer (syx_int32 integer);
+EXPORT SyxOop syx_large_integer_new_integer (syx_nint integer);
 EXPORT SyxOop syx_large_integer_new_mpz (syx_pointer mpz);
 EXPORT SyxOop syx_symbol_new (syx_symbol symbol);
 EXPORT SyxOop syx_method_context_new (SyxOop method, SyxOop receiver, SyxOop arguments);
@@ -281,6 +344,9 @@ EXPORT void syx_array_add (SyxOop array, SyxOop element, syx_bool unique);
 #define SYX_CODE_PRIMITIVE(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_CODE_PRIMITIVE])
 #define SYX_CODE_CLASS(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_CODE_CLASS])
 #define SYX_CODE_TEXT(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_CODE_TEXT])
+#define SYX_CODE_DECODED_BYTECODES(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_CODE_DECODED_BYTECODES])
+#define SYX_CODE_IS_CODE(oop) (SYX_OOP_EQ (syx_object_get_class (oop), syx_compiled_method_class) || \
+                               SYX_OOP_EQ (syx_object_get_class (oop), syx_compiled_block_class))
 
 #define SYX_METHOD_ARGUMENT_STACK_SIZE(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_METHOD_ARGUMENT_STACK_SIZE])
 #define SYX_METHOD_TEMPORARY_STACK_SIZE(oop) (SYX_OBJECT_VARS(oop)[SYX_VARS_METHOD_TEMPORARY_STACK_SIZE])
@@ -331,6 +397,23 @@ syx_object_vars_size (SyxOop object)
   return SYX_SMALL_INTEGER (SYX_CLASS_INSTANCE_SIZE (klass));
 }
 
+/*!
+  Returns the native bytecodes of a CompiledMethod or a CompiledBlock.
+
+  Bytecodes are decoded again if they have never been decoded or the portable ones have been replaced.
+*/
+INLINE syx_uint32 *
+syx_code_get_decoded (SyxOop code)
+{
+  SyxOop decoded = SYX_CODE_DECODED_BYTECODES (code);
+
+  if (SYX_IS_CPOINTER (decoded)
+      && SYX_OOP_EQ (((SyxCodeDecoded *)SYX_OOP_CAST_POINTER (decoded))->bytecodes, SYX_CODE_BYTECODES (code)))
+    return ((SyxCodeDecoded *)SYX_OOP_CAST_POINTER (decoded))->words;
+
+  return syx_code_decode (code);
+}
+
 
 /* Inlined constructors */
 
@@ -45,6 +45,7 @@ static void _syx_parser_parse_block_message_pattern (SyxParser *self);
 static void _syx_parser_parse_method_message_pattern (SyxParser *self);
 
 static void _syx_parser_parse_primitive (SyxParser *self);
+static void _syx_parser_find_quick_method (SyxParser *self);
 static void _syx_parser_parse_temporaries (SyxParser *self);
 
 static void _syx_parser_parse_body (SyxParser *self);
@@ -53,6 +54,7 @@ static void _syx_parser_parse_expression (SyxParser *self);
 static void _syx_parser_parse_assignment (SyxParser *self, syx_symbol assign_name);
 static void _syx_parser_parse_block (SyxParser *self);
 static syx_varsize _syx_parser_parse_optimized_block (SyxParser *self, SyxBytecodeSpecial branch_type, syx_bool do_pop);
+static syx_bool _syx_parser_parse_inlined_message (SyxParser *self, syx_symbol selector);
 static void _syx_parser_parse_array (SyxParser *self);
 static SyxOop _syx_parser_parse_literal_array (SyxParser *self);
 
@@ -80,6 +82,8 @@ syx_parser_new (SyxLexer *lexer, SyxOop method, SyxOop klass)
   self->method = method;
   self->klass = klass;
   self->_in_block = FALSE;
+  self->_home_method = method;
+  self->_home_frame = syx_nil;
 
   self->bytecode = syx_bytecode_new ();
   self->_temporary_scopes_top = 0;
@@ -87,6 +91,8 @@ syx_parser_new (SyxLexer *lexer, SyxOop method, SyxOop klass)
   self->instance_names = syx_class_get_all_instance_variable_names (klass);
 
   self->_duplicate_indexes_top = 0;
+  self->_loops_top = 0;
+  self->_fallback_loops_top = 0;
 
   return self;
 }
@@ -149,6 +155,14 @@ syx_parser_parse (SyxParser *self, syx_bool skip_message_pattern)
   self->_temporary_scopes[self->_temporary_scopes_top].top = 0;
   self->_argument_scopes[self->_argument_scopes_top].top = 0;
 
+  if (!self->_in_block)
+    {
+      /* the method may be already old, while literals and bytecodes will be young */
+      syx_memory_remember (self->method);
+      self->_home_method = self->method;
+      self->_home_frame = syx_nil;
+    }
+
   if (!skip_message_pattern)
     _syx_parser_parse_message_pattern (self);
 
@@ -173,6 +187,9 @@ syx_parser_parse (SyxParser *self, syx_bool skip_message_pattern)
   SYX_CODE_TEXT(self->method) = syx_string_new (self->lexer->text +
                                                 syx_find_first_non_whitespace (self->lexer->text));
   SYX_CODE_CLASS(self->method) = self->klass;
+  if (!self->_in_block)
+    _syx_parser_find_quick_method (self);
+  syx_code_decode (self->method);
 
   /* Free arguments and temporaries of this scope */
   _syx_parser_free_arguments (self);
@@ -181,45 +198,85 @@ syx_parser_parse (SyxParser *self, syx_bool skip_message_pattern)
   return TRUE;
 }
 
+/* Returns the address of a variable as expected by the interpreter: the index within its scope
+   and the number of outer scopes to go through */
+static syx_varsize
+_syx_parser_scope_address (syx_varsize depth, syx_varsize index)
+{
+  if (index > SYX_BYTECODE_SCOPE_INDEX_MASK
+      || depth > (SYX_BYTECODE_MAX >> SYX_BYTECODE_SCOPE_INDEX_BITS))
+    syx_signal (SYX_ERROR_INTERP, syx_string_new ("Too many arguments or temporaries"));
+
+  return (depth << SYX_BYTECODE_SCOPE_INDEX_BITS) + index;
+}
+
+/* The innermost depth blocks refer to variables of outer scopes or to the receiver,
+   so they can't be clean */
+static void
+_syx_parser_refer_outer_scopes (SyxParser *self, syx_varsize depth)
+{
+  syx_varsize i;
+  for (i=0; i < depth; i++)
+    self->_clean_scopes[self->_temporary_scopes_top - i] = FALSE;
+}
+
+/* Remember that a real block refers to the temporary at the given scope and index,
+   in case it's the argument of an inlined loop */
+static void
+_syx_parser_capture_temporary (SyxParser *self, syx_varsize scope_index, syx_varsize index)
+{
+  syx_varsize i;
+
+  /* blocks sent by the fallback of an inlined message are expected to be evaluated
+     right away, so they don't prevent the outer loops from being inlined */
+  for (i=self->_fallback_loops_top; i < self->_loops_top; i++)
+    {
+      if (self->_loops[i].scope == scope_index && self->_loops[i].index == index)
+        self->_loops[i].captured = TRUE;
+    }
+}
+
 static syx_varsize
 _syx_parser_find_temporary_name (SyxParser *self, syx_symbol name)
 {
-  syx_varsize i, top, scope_index;
+  syx_varsize i, scope_index;
   SyxParserScope *scope;
   if (!name)
     return -1;
 
-  top = 0;
   for (scope_index=self->_temporary_scopes_top; scope_index >= 0; scope_index--)
     {
       scope = self->_temporary_scopes + scope_index;
       for (i=scope->top-1; i >= 0; i--)
         {
           if (!strcmp (scope->stack[i], name))
-            return i + top;
+            {
+              if (scope_index < self->_temporary_scopes_top)
+                _syx_parser_capture_temporary (self, scope_index, i);
+              return _syx_parser_scope_address (self->_temporary_scopes_top - scope_index, i);
+            }
         }
-      top += scope->top;
     }
 
   return -1;
 }
 
+/* Index 0 of the current scope is reserved to the receiver */
 static syx_varsize
 _syx_parser_find_argument_name (SyxParser *self, syx_symbol name)
 {
-  syx_varsize i, index, scope_index;
+  syx_varsize i, scope_index;
   SyxParserScope *scope;
   if (!name)
     return -1;
 
-  index = 0;
   for (scope_index=self->_argument_scopes_top; scope_index >= 0; scope_index--)
     {
       scope = self->_argument_scopes + scope_index;
-      for (i=0; i < scope->top; i++, index++)
+      for (i=0; i < scope->top; i++)
         {
           if (!strcmp (scope->stack[i], name))
-            return index;
+            return _syx_parser_scope_address (self->_argument_scopes_top - scope_index, i + 1);
         }
     }
 
@@ -385,6 +442,7 @@ _syx_parser_parse_name_term (SyxParser *self, syx_symbol name)
 
   if (!strcmp (name, "self") || !strcmp (name, "super"))
     {
+      _syx_parser_refer_outer_scopes (self, self->_temporary_scopes_top);
       syx_bytecode_push_argument (self->bytecode, 0);
       if (!strcmp (name, "super"))
         return TRUE;
@@ -408,6 +466,7 @@ _syx_parser_parse_name_term (SyxParser *self, syx_symbol name)
     }
   else if (!strcmp (name, "thisContext"))
     {
+      _syx_parser_refer_outer_scopes (self, self->_temporary_scopes_top);
       syx_bytecode_push_constant (self->bytecode, SYX_BYTECODE_CONST_CONTEXT);
       return FALSE;
     }
@@ -415,13 +474,15 @@ _syx_parser_parse_name_term (SyxParser *self, syx_symbol name)
   pos = _syx_parser_find_argument_name (self, name);
   if (pos >= 0)
     {
-      syx_bytecode_push_argument (self->bytecode, pos + 1);
+      _syx_parser_refer_outer_scopes (self, pos >> SYX_BYTECODE_SCOPE_INDEX_BITS);
+      syx_bytecode_push_argument (self->bytecode, pos);
       return FALSE;    
     }
 
   pos = _syx_parser_find_temporary_name (self, name);
   if (pos >= 0)
     {
+      _syx_parser_refer_outer_scopes (self, pos >> SYX_BYTECODE_SCOPE_INDEX_BITS);
       syx_bytecode_push_temporary (self->bytecode, pos);
       return FALSE;
     }
@@ -429,6 +490,7 @@ _syx_parser_parse_name_term (SyxParser *self, syx_symbol name)
   pos = _syx_parser_find_instance_name (self, name);
   if (pos >= 0)
     {
+      _syx_parser_refer_outer_scopes (self, self->_temporary_scopes_top);
       syx_bytecode_push_instance (self->bytecode, pos);
       return FALSE;
     }
@@ -443,6 +505,74 @@ _syx_parser_parse_name_term (SyxParser *self, syx_symbol name)
   return FALSE;
 }
 
+/* TRUE if the instruction at the given position is the given special operation */
+static syx_bool
+_syx_parser_is_special (SyxParser *self, syx_int32 index, SyxBytecodeSpecial special)
+{
+  syx_uint16 byte = SYX_COMPAT_SWAP_16 (self->bytecode->code[index]);
+  return byte == (SYX_BYTECODE_DO_SPECIAL << SYX_BYTECODE_ARGUMENT_BITS) + special;
+}
+
+/* Tag the method as quick if it only answers the receiver, a constant, a literal or an instance variable,
+   or if it's a setter of an instance variable. Look at SYX_METHOD_QUICK_FIRST */
+static void
+_syx_parser_find_quick_method (SyxParser *self)
+{
+  syx_int32 count = self->bytecode->code_top;
+  syx_uint16 byte, command, argument;
+  syx_int32 primitive = 0;
+
+  if (SYX_SMALL_INTEGER (SYX_METHOD_PRIMITIVE (self->method)) != -1
+      || count == 0 || !_syx_parser_is_special (self, count - 1, SYX_BYTECODE_SELF_RETURN))
+    return;
+
+  /* an empty method */
+  if (count == 1)
+    primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_SELF, 0);
+
+  byte = SYX_COMPAT_SWAP_16 (self->bytecode->code[0]);
+  command = byte >> SYX_BYTECODE_ARGUMENT_BITS;
+  argument = byte & SYX_BYTECODE_ARGUMENT_MASK;
+
+  /* a single statement returning something */
+  if (count == 3 && _syx_parser_is_special (self, 1, SYX_BYTECODE_STACK_RETURN))
+    {
+      switch (command)
+        {
+        case SYX_BYTECODE_PUSH_ARGUMENT:
+          if (argument == 0)
+            primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_SELF, 0);
+          break;
+        case SYX_BYTECODE_PUSH_CONSTANT:
+          if (argument != SYX_BYTECODE_CONST_CONTEXT)
+            primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_CONSTANT, argument);
+          break;
+        case SYX_BYTECODE_PUSH_LITERAL:
+          primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_LITERAL, argument);
+          break;
+        case SYX_BYTECODE_PUSH_INSTANCE:
+          primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_INSTANCE, argument);
+          break;
+        }
+    }
+
+  /* assign the argument to an instance variable, optionally followed by ^self */
+  if ((count == 3
+       || (count == 6 && _syx_parser_is_special (self, 2, SYX_BYTECODE_POP_TOP)
+           && SYX_COMPAT_SWAP_16 (self->bytecode->code[3]) == SYX_BYTECODE_PUSH_ARGUMENT << SYX_BYTECODE_ARGUMENT_BITS
+           && _syx_parser_is_special (self, 4, SYX_BYTECODE_STACK_RETURN)))
+      && command == SYX_BYTECODE_PUSH_ARGUMENT && argument == 1
+      && SYX_SMALL_INTEGER (SYX_CODE_ARGUMENTS_COUNT (self->method)) == 1)
+    {
+      byte = SYX_COMPAT_SWAP_16 (self->bytecode->code[1]);
+      if (byte >> SYX_BYTECODE_ARGUMENT_BITS == SYX_BYTECODE_ASSIGN_INSTANCE)
+        primitive = SYX_METHOD_QUICK_NEW (SYX_METHOD_QUICK_SETTER, byte & SYX_BYTECODE_ARGUMENT_MASK);
+    }
+
+  if (primitive)
+    SYX_METHOD_PRIMITIVE(self->method) = syx_small_integer_new (primitive);
+}
+
 static void
 _syx_parser_parse_primitive (SyxParser *self)
 {
@@ -601,6 +731,7 @@ _syx_parser_parse_statement (SyxParser *self)
       syx_token_free (token);
       syx_lexer_next_token (self->lexer);
       _syx_parser_parse_expression (self);
+      _syx_parser_refer_outer_scopes (self, self->_temporary_scopes_top);
       syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_STACK_RETURN);
     }
   else
@@ -649,6 +780,7 @@ _syx_parser_parse_assignment (SyxParser *self, syx_symbol assign_name)
   pos = _syx_parser_find_temporary_name (self, assign_name);
   if (pos >= 0)
     {
+      _syx_parser_refer_outer_scopes (self, pos >> SYX_BYTECODE_SCOPE_INDEX_BITS);
       _syx_parser_parse_expression (self);
       syx_bytecode_assign_temporary (self->bytecode, pos);
       return;
@@ -657,6 +789,7 @@ _syx_parser_parse_assignment (SyxParser *self, syx_symbol assign_name)
   pos = _syx_parser_find_instance_name (self, assign_name);
   if (pos >= 0)
     {
+      _syx_parser_refer_outer_scopes (self, self->_temporary_scopes_top);
       _syx_parser_parse_expression (self);
       syx_bytecode_assign_instance (self->bytecode, pos);
       return;
@@ -695,15 +828,111 @@ _syx_parser_do_continuation (SyxParser *self, syx_bool super_receiver)
   self->_duplicate_indexes_top--;
 }
 
+/* Declare a temporary of the current scope that lives until the end of an inlined message */
 static syx_varsize
-_syx_parser_parse_optimized_block (SyxParser *self, SyxBytecodeSpecial branch_type, syx_bool do_pop)
+_syx_parser_add_temporary (SyxParser *self, syx_symbol name)
+{
+  SyxParserScope *scope = self->_temporary_scopes + self->_temporary_scopes_top;
+
+  scope->stack[scope->top++] = syx_strdup (name);
+  if (SYX_IS_NIL (SYX_CODE_TEMPORARIES_COUNT (self->method))
+      || scope->top > SYX_SMALL_INTEGER (SYX_CODE_TEMPORARIES_COUNT (self->method)))
+    SYX_CODE_TEMPORARIES_COUNT(self->method) = syx_small_integer_new (scope->top);
+
+  return _syx_parser_scope_address (0, scope->top - 1);
+}
+
+/* Parse the opening bracket and the arguments of a literal block whose code is put in place.
+   The arguments are declared as temporaries of the current scope */
+static void
+_syx_parser_parse_inlined_block_arguments (SyxParser *self, syx_varsize *arguments, syx_int32 arguments_count)
 {
-  syx_int8 scope_top;
-  syx_uint16 jump;
-  syx_bool block_state;
   SyxToken token;
   syx_int32 i;
 
+  syx_token_free (syx_lexer_get_last_token (self->lexer));
+  token = syx_lexer_next_token (self->lexer);
+
+  for (i=0; i < arguments_count; i++)
+    {
+      if (! (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, ":")))
+        syx_signal (SYX_ERROR_INTERP, syx_string_new ("Expected %d block arguments\n", arguments_count));
+      syx_token_free (token);
+      token = syx_lexer_next_token (self->lexer);
+      if (token.type != SYX_TOKEN_NAME_CONST)
+        syx_signal (SYX_ERROR_INTERP, syx_string_new ("Expected block argument name\n"));
+      arguments[i] = _syx_parser_add_temporary (self, token.value.string);
+      syx_token_free (token);
+      token = syx_lexer_next_token (self->lexer);
+    }
+
+  if (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, ":"))
+    syx_signal (SYX_ERROR_INTERP, syx_string_new ("Expected %d block arguments\n", arguments_count));
+
+  if (arguments_count > 0)
+    {
+      if (! (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "|")))
+        syx_signal (SYX_ERROR_INTERP, syx_string_new ("Expected | after block message pattern\n"));
+      syx_token_free (token);
+      syx_lexer_next_token (self->lexer);
+    }
+}
+
+/* Parse the body of a literal block whose code is put in place, up to the closing bracket.
+   Temporaries declared after scope_top are released */
+static void
+_syx_parser_parse_inlined_block_body (SyxParser *self, syx_int8 scope_top)
+{
+  SyxParserScope *scope = self->_temporary_scopes + self->_temporary_scopes_top;
+  syx_bool block_state;
+  syx_uint16 code_top;
+  syx_int32 i;
+
+  block_state = self->_in_block;
+  self->_in_block = TRUE;
+
+  _syx_parser_parse_temporaries (self);
+  code_top = self->bytecode->code_top;
+  _syx_parser_parse_body (self);
+  /* an empty block answers nil */
+  if (code_top == self->bytecode->code_top)
+    syx_bytecode_push_constant (self->bytecode, SYX_BYTECODE_CONST_NIL);
+
+  /* we need to restore the current scope after the inlined block has been parsed */
+  for (i=scope_top; i < scope->top; i++)
+    syx_free (scope->stack[i]);
+  scope->top = scope_top;
+  syx_lexer_next_token (self->lexer);
+
+  self->_in_block = block_state;
+}
+
+/* Put in place a literal block without arguments, or send value to any other object */
+static void
+_syx_parser_parse_inlined_block (SyxParser *self)
+{
+  SyxToken token = syx_lexer_get_last_token (self->lexer);
+  syx_int8 scope_top;
+
+  if (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "["))
+    {
+      scope_top = self->_temporary_scopes[self->_temporary_scopes_top].top;
+      _syx_parser_parse_inlined_block_arguments (self, NULL, 0);
+      _syx_parser_parse_inlined_block_body (self, scope_top);
+    }
+  else
+    {
+      /* a variable or such has been used, like ifTrue: trueBlock */
+      _syx_parser_do_binary_continuation (self, _syx_parser_parse_term (self), FALSE);
+      syx_bytecode_gen_message (self->bytecode, FALSE, 0, "value");
+    }
+}
+
+static syx_varsize
+_syx_parser_parse_optimized_block (SyxParser *self, SyxBytecodeSpecial branch_type, syx_bool do_pop)
+{
+  syx_uint16 jump;
+
   syx_bytecode_do_special (self->bytecode, branch_type);
   syx_bytecode_gen_code (self->bytecode, 0);
   jump = self->bytecode->code_top - 1;
@@ -711,33 +940,354 @@ _syx_parser_parse_optimized_block (SyxParser *self, SyxBytecodeSpecial branch_ty
   if (do_pop)
     syx_bytecode_pop_top (self->bytecode);
   
-  block_state = self->_in_block;
-  self->_in_block = TRUE;
+  _syx_parser_parse_inlined_block (self);
+
+  self->bytecode->code[jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  return jump;
+}
+
+/* Free a token read while looking ahead */
+static void
+_syx_parser_free_peeked_token (SyxToken token)
+{
+#ifdef HAVE_LIBGMP
+  if (token.type == SYX_TOKEN_LARGE_INT_CONST)
+    {
+      mpz_clear (*token.value.large_integer);
+      syx_free (token.value.large_integer);
+      return;
+    }
+#endif
+  syx_token_free (token);
+}
+
+/* Look ahead at the literal block starting at the last token of a copy of the lexer.
+   Returns the number of arguments of the block, or -1 if there's no literal block.
+   The token following the block is stored in after, to be freed */
+static syx_int32
+_syx_parser_peek_block (SyxLexer *lexer, SyxToken *after)
+{
+  SyxToken token = syx_lexer_get_last_token (lexer);
+  syx_int32 arguments_count = 0;
+  syx_int32 depth = 1;
+
+  after->type = SYX_TOKEN_END;
+  if (! (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "[")))
+    return -1;
+
+  token = syx_lexer_next_token (lexer);
+  while (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, ":"))
+    {
+      syx_token_free (token);
+      token = syx_lexer_next_token (lexer);
+      if (token.type != SYX_TOKEN_NAME_CONST)
+        {
+          _syx_parser_free_peeked_token (token);
+          return -1;
+        }
+      arguments_count++;
+      syx_token_free (token);
+      token = syx_lexer_next_token (lexer);
+    }
+
+  if (arguments_count > 0)
+    {
+      if (! (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "|")))
+        {
+          _syx_parser_free_peeked_token (token);
+          return -1;
+        }
+      syx_token_free (token);
+      token = syx_lexer_next_token (lexer);
+    }
+
+  while (! (token.type == SYX_TOKEN_CLOSING && token.value.character == ']' && depth == 1))
+    {
+      if (token.type == SYX_TOKEN_END)
+        return -1;
+      if (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "["))
+        depth++;
+      else if (token.type == SYX_TOKEN_CLOSING && token.value.character == ']')
+        depth--;
+      _syx_parser_free_peeked_token (token);
+      token = syx_lexer_next_token (lexer);
+    }
+
+  *after = syx_lexer_next_token (lexer);
+  return arguments_count;
+}
+
+/* Check whether the message whose last keyword has just been read can be inlined:
+   the argument must be a literal block with the given number of arguments, optionally followed by
+   other_selector and a literal block without arguments, and no other keyword must follow */
+static syx_bool
+_syx_parser_can_inline (SyxParser *self, syx_int32 arguments_count, syx_symbol other_selector)
+{
+  SyxLexer lexer = *self->lexer;
+  SyxToken token;
+  SyxToken after;
+  syx_bool ret;
+
+  ret = _syx_parser_peek_block (&lexer, &token) == arguments_count;
+  if (ret && other_selector && token.type == SYX_TOKEN_NAME_COLON && !strcmp (token.value.string, other_selector))
+    {
+      syx_token_free (token);
+      token = syx_lexer_next_token (&lexer);
+      ret = _syx_parser_peek_block (&lexer, &after) == 0;
+      _syx_parser_free_peeked_token (token);
+      token = after;
+    }
+
+  /* the selector goes on, like ifNil:foo: */
+  if (token.type == SYX_TOKEN_NAME_COLON)
+    ret = FALSE;
+
+  _syx_parser_free_peeked_token (token);
+  return ret;
+}
+
+/* Move the lexer back to a literal block saved before it was inlined, to parse it again */
+static void
+_syx_parser_rewind_to_block (SyxParser *self, SyxLexer *position)
+{
+  syx_token_free (syx_lexer_get_last_token (self->lexer));
+  *self->lexer = *position;
+  /* the opening bracket has been freed while inlining the block */
+  self->lexer->last_token.value.string = syx_strdup ("[");
+}
+
+/* Inline and: and or:. The receiver answers itself when the block isn't evaluated.
+   Receivers other than Booleans are sent the real message with a closure of the block */
+static void
+_syx_parser_parse_inlined_condition (SyxParser *self, SyxBytecodeSpecial branch_type,
+                                     SyxBytecodeConstant constant, syx_symbol selector)
+{
+  SyxLexer block_position = *self->lexer;
+  syx_uint16 fallback_jump, jump, end_jump, skip_jump;
+  syx_int16 fallback_state;
+
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH_IF_NOT_BOOLEAN);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  fallback_jump = self->bytecode->code_top - 1;
+
+  jump = _syx_parser_parse_optimized_block (self, branch_type, FALSE);
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  end_jump = self->bytecode->code_top - 1;
+
+  /* jump here if the block must not be evaluated, the branch pushed nil */
+  self->bytecode->code[jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  syx_bytecode_pop_top (self->bytecode);
+  syx_bytecode_push_constant (self->bytecode, constant);
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  skip_jump = self->bytecode->code_top - 1;
+
+  /* jump here if the receiver is not a Boolean, the block is parsed again as a real one */
+  self->bytecode->code[fallback_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  _syx_parser_rewind_to_block (self, &block_position);
+  fallback_state = self->_fallback_loops_top;
+  self->_fallback_loops_top = self->_loops_top;
+  _syx_parser_parse_term (self);
+  self->_fallback_loops_top = fallback_state;
+  syx_bytecode_gen_message (self->bytecode, FALSE, 1, selector);
+
+  self->bytecode->code[end_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  self->bytecode->code[skip_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+}
+
+/* Inline ifNil: and ifNotNil: optionally followed by the other selector.
+   Any object can be tested, so there's no need to fall back to a real message */
+static void
+_syx_parser_parse_inlined_nil_test (SyxParser *self, syx_symbol test, syx_symbol other_selector)
+{
+  SyxToken token;
+  syx_uint16 jump, end_jump;
+
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_DUPLICATE);
+  self->bytecode->stack_size++;
+  syx_bytecode_gen_message (self->bytecode, FALSE, 0, test);
+  jump = _syx_parser_parse_optimized_block (self, SYX_BYTECODE_BRANCH_IF_TRUE, TRUE);
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  end_jump = self->bytecode->code_top - 1;
+
+  /* jump here if the block must not be evaluated, pop the nil pushed by the branch
+     and answer the receiver */
+  self->bytecode->code[jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  syx_bytecode_pop_top (self->bytecode);
 
   token = syx_lexer_get_last_token (self->lexer);
-  if (token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "["))
+  if (token.type == SYX_TOKEN_NAME_COLON && !strcmp (token.value.string, other_selector))
     {
       syx_token_free (token);
       syx_lexer_next_token (self->lexer);
-      /* we need to restore the current scope after the optimized block has been parsed */
-      scope_top = self->_temporary_scopes[self->_temporary_scopes_top].top;
-      _syx_parser_parse_temporaries (self);
-      _syx_parser_parse_body (self);
-      for (i=scope_top; i < self->_temporary_scopes[self->_temporary_scopes_top].top; i++)
-        syx_free (self->_temporary_scopes[self->_temporary_scopes_top].stack[i]);
-      self->_temporary_scopes[self->_temporary_scopes_top].top = scope_top;
-      token = syx_lexer_next_token (self->lexer);
+      syx_bytecode_pop_top (self->bytecode);
+      _syx_parser_parse_inlined_block (self);
+    }
+
+  self->bytecode->code[end_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+}
+
+/* Inline to:do: and timesRepeat: into a loop over a SmallInteger counter.
+   The receiver is answered like the methods in Number and Integer do.
+   If the receiver or the limit is not a SmallInteger, the real message is sent with a closure of the block.
+
+   The block argument of to:do: is a temporary shared by all the iterations, so the message is sent
+   if a real block refers to it. Returns FALSE in that case, after rewinding to the block */
+static syx_bool
+_syx_parser_parse_inlined_loop (SyxParser *self, syx_bool block_counter)
+{
+  SyxParserScope *scope = self->_temporary_scopes + self->_temporary_scopes_top;
+  syx_int8 scope_top = scope->top;
+  SyxLexer block_position = *self->lexer;
+  syx_uint16 code_top = self->bytecode->code_top;
+  syx_uint16 literals_top = self->bytecode->literals_top;
+  syx_int32 stack_size = self->bytecode->stack_size;
+  syx_varsize limit, counter;
+  syx_uint16 loop_jump, jump, end_jump, limit_jump, start_jump = 0;
+  syx_bool captured;
+  syx_int16 fallback_state;
+
+  if (block_counter && self->_loops_top == SYX_PARSER_MAX_SCOPES)
+    return FALSE;
+
+  /* the limit of to:do:, or the receiver of timesRepeat: */
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  limit_jump = self->bytecode->code_top - 1;
+
+  /* the names are not valid identifiers, so they can't be referenced */
+  limit = _syx_parser_add_temporary (self, "to:do: limit");
+  syx_bytecode_assign_temporary (self->bytecode, limit);
+
+  if (block_counter)
+    {
+      /* the starting value is on the stack after the limit */
+      syx_bytecode_pop_top (self->bytecode);
+      syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH_IF_NOT_SMALL_INTEGER);
+      syx_bytecode_gen_code (self->bytecode, 0);
+      start_jump = self->bytecode->code_top - 1;
+      _syx_parser_parse_inlined_block_arguments (self, &counter, 1);
+      syx_bytecode_assign_temporary (self->bytecode, counter);
+
+      self->_loops[self->_loops_top].scope = self->_temporary_scopes_top;
+      self->_loops[self->_loops_top].index = scope->top - 1;
+      self->_loops[self->_loops_top].captured = FALSE;
+      self->_loops_top++;
     }
   else
     {
-      /* a variable or such has been used, like ifTrue: trueBlock */
-      _syx_parser_do_binary_continuation (self, _syx_parser_parse_term (self), FALSE);
-      syx_bytecode_gen_message (self->bytecode, FALSE, 0, "value");
+      counter = _syx_parser_add_temporary (self, "timesRepeat: counter");
+      syx_bytecode_push_literal (self->bytecode, syx_small_integer_new (1));
+      syx_bytecode_assign_temporary (self->bytecode, counter);
+      syx_bytecode_pop_top (self->bytecode);
+      _syx_parser_parse_inlined_block_arguments (self, NULL, 0);
     }
 
-  self->_in_block = block_state;
+  loop_jump = self->bytecode->code_top;
+  syx_bytecode_push_temporary (self->bytecode, counter);
+  syx_bytecode_push_temporary (self->bytecode, limit);
+  syx_bytecode_gen_message (self->bytecode, FALSE, 1, "<=");
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH_IF_TRUE);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  jump = self->bytecode->code_top - 1;
+
+  _syx_parser_parse_inlined_block_body (self, scope_top);
+  syx_bytecode_pop_top (self->bytecode);
+
+  if (block_counter)
+    {
+      self->_loops_top--;
+      captured = self->_loops[self->_loops_top].captured;
+      if (captured)
+        {
+          self->bytecode->code_top = code_top;
+          self->bytecode->literals_top = literals_top;
+          self->bytecode->stack_size = stack_size;
+          _syx_parser_rewind_to_block (self, &block_position);
+          return FALSE;
+        }
+    }
+
+  syx_bytecode_push_temporary (self->bytecode, counter);
+  syx_bytecode_push_literal (self->bytecode, syx_small_integer_new (1));
+  syx_bytecode_gen_message (self->bytecode, FALSE, 1, "+");
+  syx_bytecode_assign_temporary (self->bytecode, counter);
+  syx_bytecode_pop_top (self->bytecode);
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH);
+  syx_bytecode_gen_code (self->bytecode, loop_jump);
+
+  /* exit here, the branch pushed nil */
   self->bytecode->code[jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
-  return jump;
+  syx_bytecode_pop_top (self->bytecode);
+  syx_bytecode_do_special (self->bytecode, SYX_BYTECODE_BRANCH);
+  syx_bytecode_gen_code (self->bytecode, 0);
+  end_jump = self->bytecode->code_top - 1;
+
+  /* jump here if the starting value is not a SmallInteger, the limit is pushed back */
+  if (block_counter)
+    {
+      self->bytecode->code[start_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+      syx_bytecode_push_temporary (self->bytecode, limit);
+    }
+
+  /* jump here if the limit is not a SmallInteger, the block is parsed again as a real one */
+  self->bytecode->code[limit_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  _syx_parser_rewind_to_block (self, &block_position);
+  fallback_state = self->_fallback_loops_top;
+  self->_fallback_loops_top = self->_loops_top;
+  _syx_parser_parse_term (self);
+  self->_fallback_loops_top = fallback_state;
+  syx_bytecode_gen_message (self->bytecode, FALSE, block_counter ? 2 : 1,
+                            block_counter ? "to:do:" : "timesRepeat:");
+
+  self->bytecode->code[end_jump] = SYX_COMPAT_SWAP_16 (self->bytecode->code_top);
+  return TRUE;
+}
+
+/* Put in place the code of common messages whose last argument is a literal block.
+   Returns FALSE if the message must be sent */
+static syx_bool
+_syx_parser_parse_inlined_message (SyxParser *self, syx_symbol selector)
+{
+  if (!strcmp (selector, "and:") || !strcmp (selector, "or:"))
+    {
+      if (!_syx_parser_can_inline (self, 0, NULL))
+        return FALSE;
+      if (!strcmp (selector, "and:"))
+        _syx_parser_parse_inlined_condition (self, SYX_BYTECODE_BRANCH_IF_TRUE, SYX_BYTECODE_CONST_FALSE, selector);
+      else
+        _syx_parser_parse_inlined_condition (self, SYX_BYTECODE_BRANCH_IF_FALSE, SYX_BYTECODE_CONST_TRUE, selector);
+    }
+  else if (!strcmp (selector, "ifNil:"))
+    {
+      if (!_syx_parser_can_inline (self, 0, "ifNotNil:"))
+        return FALSE;
+      _syx_parser_parse_inlined_nil_test (self, "isNil", "ifNotNil:");
+    }
+  else if (!strcmp (selector, "ifNotNil:"))
+    {
+      if (!_syx_parser_can_inline (self, 0, "ifNil:"))
+        return FALSE;
+      _syx_parser_parse_inlined_nil_test (self, "notNil", "ifNil:");
+    }
+  else if (!strcmp (selector, "to:do:"))
+    {
+      if (!_syx_parser_can_inline (self, 1, NULL))
+        return FALSE;
+      return _syx_parser_parse_inlined_loop (self, TRUE);
+    }
+  else if (!strcmp (selector, "timesRepeat:"))
+    {
+      if (!_syx_parser_can_inline (self, 0, NULL))
+        return FALSE;
+      _syx_parser_parse_inlined_loop (self, FALSE);
+    }
+  else
+    return FALSE;
+
+  return TRUE;
 }
 
 static syx_bool
@@ -843,7 +1393,11 @@ _syx_parser_do_key_continuation (SyxParser *self, syx_bool super_receiver)
           strcat (selector, token.value.string);
           num_args++;
           syx_token_free (token);
-          syx_lexer_next_token (self->lexer);
+          token = syx_lexer_next_token (self->lexer);
+
+          if (!super_receiver && token.type == SYX_TOKEN_BINARY && !strcmp (token.value.string, "[")
+              && _syx_parser_parse_inlined_message (self, selector))
+            return FALSE;
 
           super_term = _syx_parser_parse_term (self);
           _syx_parser_do_binary_continuation (self, super_term, FALSE);
@@ -926,10 +1480,19 @@ _syx_parser_parse_block (SyxParser *self)
   self->_in_block = TRUE;
   self->_temporary_scopes_top++;
   self->_argument_scopes_top++;
+  self->_clean_scopes[self->_temporary_scopes_top] = TRUE;
 
   syx_parser_parse (self, FALSE);
 
   closure = syx_block_closure_new (self->method);
+  /* Clean blocks don't need the frame of their activation, so the closure
+     is created once here and shared by all the activations of the method */
+  if (self->_clean_scopes[self->_temporary_scopes_top])
+    {
+      if (SYX_IS_NIL (self->_home_frame))
+        self->_home_frame = syx_interp_clean_frame_new (self->_home_method);
+      SYX_BLOCK_CLOSURE_OUTER_FRAME(closure) = self->_home_frame;
+    }
   self->method = old_method;
   syx_bytecode_free (self->bytecode);
   self->bytecode = old_bytecode;
@@ -43,6 +43,17 @@ struct SyxParserScope
   syx_int8 top;
 };
 
+typedef struct SyxParserLoop SyxParserLoop;
+
+/*! The block argument of an inlined to:do: loop, declared as a temporary */
+struct SyxParserLoop
+{
+  syx_int8 scope;
+  syx_int8 index;
+  /* TRUE if a real block refers to the argument, so it can't be shared by the iterations */
+  syx_bool captured;
+};
+
 typedef struct SyxParser SyxParser;
 
 /*! Parses the grammar of Smalltalk code into bytecode-commands for creating CompiledMethods */
@@ -58,6 +69,19 @@ struct SyxParser
 
   syx_bool _in_block;
 
+  /* the method being parsed and the frame shared by its clean blocks */
+  SyxOop _home_method;
+  SyxOop _home_frame;
+  /* FALSE if the block at the given scope refers to its outer scopes */
+  syx_bool _clean_scopes[SYX_PARSER_MAX_SCOPES];
+
+  /* the inlined to:do: loops being parsed */
+  SyxParserLoop _loops[SYX_PARSER_MAX_SCOPES];
+  syx_int16 _loops_top;
+  /* while parsing the block sent by the fallback of an inlined message,
+     the loops being parsed outside of the block */
+  syx_int16 _fallback_loops_top;
+
   syx_int16 _duplicate_indexes[SYX_PARSER_MAX_CASCADES];
   syx_int8 _duplicate_indexes_top;
 
@@ -27,6 +27,11 @@
 
 #include "syx-config.h"
 
+/* vsnprintf is C99, request it before any system header is included */
+#ifndef _ISOC99_SOURCE
+#define _ISOC99_SOURCE 1
+#endif
+
 #define _SYX_XSTRINGIFY(s) #s
 #define SYX_STRINGIFY(s) _SYX_XSTRINGIFY(s)
 
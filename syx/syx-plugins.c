@@ -115,8 +115,9 @@ _syx_plugin_default_method (void)
   SyxOop method;
   SyxLexer *lexer;
   SyxParser *parser;
+  SyxMemoryHandleScope scope;
 
-  syx_memory_gc_begin ();
+  scope = syx_memory_handle_scope_open ();
 
   method = syx_method_new ();
   lexer = syx_lexer_new ("defaultPluginsFailMethod self primitiveFailed");
@@ -126,7 +127,7 @@ _syx_plugin_default_method (void)
   syx_lexer_free (lexer, FALSE);
   syx_parser_free (parser, FALSE);
 
-  syx_memory_gc_end ();
+  syx_memory_handle_scope_close (scope);
   return method;
 #endif /* WITH_PLUGINS */
 }
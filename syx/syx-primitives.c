@@ -124,6 +124,7 @@ SYX_FUNC_PRIMITIVE (Object_at_put)
 
   object = es->message_arguments[1];
   SYX_OBJECT_DATA(es->message_receiver)[index] = object;
+  syx_memory_write_barrier (es->message_receiver, object);
 
   SYX_PRIM_RETURN (object);
 }
@@ -183,7 +184,7 @@ SYX_FUNC_PRIMITIVE (Object_perform)
   SyxOop klass;
   SyxOop message_method;
   SyxOop selector;
-  SyxOop message_arguments[0xFF];
+  SyxOop *message_arguments;
   syx_varsize message_arguments_count;
   syx_int32 primitive;
   syx_bool ret = TRUE;
@@ -207,13 +208,12 @@ SYX_FUNC_PRIMITIVE (Object_perform)
     }
 
   /* save the real state */
-  memcpy (message_arguments, es->message_arguments, es->message_arguments_count * sizeof (SyxOop));
+  message_arguments = es->message_arguments;
   message_arguments_count = es->message_arguments_count;
 
+  /* Skip the selector, the only argument of #perform:with: follows */
+  es->message_arguments++;
   es->message_arguments_count--;
-  /* Check for #perform:with: then shift the only argument to the right by one */
-  if (es->message_arguments_count)
-    es->message_arguments[0] = es->message_arguments[1];
 
   primitive = SYX_SMALL_INTEGER (SYX_METHOD_PRIMITIVE (message_method));
   if (primitive >= 0 && primitive < SYX_PRIMITIVES_MAX)
@@ -224,7 +224,7 @@ SYX_FUNC_PRIMITIVE (Object_perform)
     _syx_interp_frame_prepare_new (es, message_method);
 
   /* restore the state */
-  memcpy (es->message_arguments, message_arguments, message_arguments_count * sizeof (SyxOop));
+  es->message_arguments = message_arguments;
   es->message_arguments_count = message_arguments_count;
 
   SYX_END_PROFILE(perform_message);
@@ -238,7 +238,7 @@ SYX_FUNC_PRIMITIVE (Object_performWithArguments)
   SyxOop message_method;
   SyxOop selector;
   SyxOop arguments;
-  SyxOop message_arguments[0xFF];
+  SyxOop *message_arguments;
   syx_varsize message_arguments_count;
   syx_int32 primitive;
   syx_bool ret = TRUE;
@@ -264,14 +264,14 @@ SYX_FUNC_PRIMITIVE (Object_performWithArguments)
     }
 
   /* save the real state */
-  memcpy (message_arguments, es->message_arguments, es->message_arguments_count * sizeof (SyxOop));
+  message_arguments = es->message_arguments;
   message_arguments_count = es->message_arguments_count;
   if (SYX_IS_NIL (arguments))
     es->message_arguments_count = 0;
   else
     {
       es->message_arguments_count = SYX_OBJECT_DATA_SIZE(arguments);
-      memcpy (es->message_arguments, SYX_OBJECT_DATA (arguments), es->message_arguments_count * sizeof (SyxOop));
+      es->message_arguments = SYX_OBJECT_DATA (arguments);
     }
 
   primitive = SYX_SMALL_INTEGER (SYX_METHOD_PRIMITIVE (message_method));
@@ -283,7 +283,7 @@ SYX_FUNC_PRIMITIVE (Object_performWithArguments)
     _syx_interp_frame_prepare_new (es, message_method);
 
   /* restore the state */
-  memcpy (es->message_arguments, message_arguments, message_arguments_count * sizeof (SyxOop));
+  es->message_arguments = message_arguments;
   es->message_arguments_count = message_arguments_count;
 
   SYX_END_PROFILE(perform_message);
@@ -325,8 +325,11 @@ SYX_FUNC_PRIMITIVE (ArrayedCollection_replaceFromToWithStartingAt)
   if (SYX_OBJECT_HAS_REFS (es->message_receiver))
     {
       if (SYX_OBJECT_HAS_REFS (coll))
-        memcpy (SYX_OBJECT_DATA (es->message_receiver) + start, SYX_OBJECT_DATA (coll) + collstart,
-                length * sizeof (SyxOop));
+        {
+          memcpy (SYX_OBJECT_DATA (es->message_receiver) + start, SYX_OBJECT_DATA (coll) + collstart,
+                  length * sizeof (SyxOop));
+          syx_memory_remember (es->message_receiver);
+        }
       else
         {
           SYX_PRIM_FAIL;
@@ -335,8 +338,11 @@ SYX_FUNC_PRIMITIVE (ArrayedCollection_replaceFromToWithStartingAt)
   else
     {
       if (!SYX_OBJECT_HAS_REFS (coll))
-        memcpy (SYX_OBJECT_BYTE_ARRAY (es->message_receiver) + start,
-                SYX_OBJECT_BYTE_ARRAY (coll) + collstart, length * sizeof (syx_int8));
+        {
+          memcpy (SYX_OBJECT_BYTE_ARRAY (es->message_receiver) + start,
+                  SYX_OBJECT_BYTE_ARRAY (coll) + collstart, length * sizeof (syx_int8));
+          SYX_OBJECT_IS_DIRTY(es->message_receiver) = TRUE;
+        }
       else
         {
           SYX_PRIM_FAIL;
@@ -382,6 +388,7 @@ SYX_FUNC_PRIMITIVE (ByteArray_at_put)
       SYX_PRIM_FAIL;
     }
   SYX_OBJECT_BYTE_ARRAY(es->message_receiver)[index] = SYX_SMALL_INTEGER (oop);
+  SYX_OBJECT_IS_DIRTY(es->message_receiver) = TRUE;
   SYX_PRIM_RETURN (oop);
 }
 
@@ -416,7 +423,7 @@ SYX_FUNC_PRIMITIVE (BlockClosure_valueWithArguments)
   SYX_PRIM_ARGS(1);
 
   es->message_arguments_count = SYX_OBJECT_DATA_SIZE (es->message_arguments[0]);
-  memcpy (es->message_arguments, SYX_OBJECT_DATA (es->message_arguments[0]), es->message_arguments_count * sizeof (SyxOop));
+  es->message_arguments = SYX_OBJECT_DATA (es->message_arguments[0]);
   _syx_interp_frame_prepare_new_closure (es, es->message_receiver);
   return TRUE;
 }
@@ -438,12 +445,13 @@ SYX_FUNC_PRIMITIVE (BlockClosure_newProcess)
 {
   SyxOop ctx;
   SyxOop proc;
+  SyxMemoryHandleScope scope;
 
-  syx_memory_gc_begin ();
+  scope = syx_memory_handle_scope_open ();
   proc = syx_process_new ();
   ctx = syx_block_context_new (es->message_receiver, syx_nil);
   syx_interp_enter_context (proc, ctx);
-  syx_memory_gc_end ();
+  syx_memory_handle_scope_close (scope);
 
   SYX_PRIM_RETURN (proc);
 }
@@ -465,6 +473,12 @@ SYX_FUNC_PRIMITIVE (ContextPart_receiver)
   SYX_PRIM_RETURN (frame->receiver);
 }
 
+SYX_FUNC_PRIMITIVE (ContextPart_isClean)
+{
+  SyxInterpFrame *frame = syx_interp_context_to_frame (es->message_receiver);
+  SYX_PRIM_RETURN (syx_boolean_new (SYX_INTERP_FRAME_IS_CLEAN (frame)));
+}
+
 SYX_FUNC_PRIMITIVE (BlockContext_outerContext)
 {
   SyxInterpFrame *frame = syx_interp_context_to_frame (es->message_receiver);
@@ -768,7 +782,7 @@ SYX_FUNC_PRIMITIVE (String_asSymbol)
 SYX_FUNC_PRIMITIVE (SmallInteger_plus)
 { 
   SyxOop first, second;
-  syx_int32 a, b, result;
+  syx_nint a, b, result;
   SYX_PRIM_ARGS(1);
 
   first = es->message_receiver;
@@ -797,7 +811,7 @@ SYX_FUNC_PRIMITIVE (SmallInteger_plus)
 SYX_FUNC_PRIMITIVE (SmallInteger_minus)
 { 
   SyxOop first, second;
-  syx_int32 a, b, result;
+  syx_nint a, b, result;
   SYX_PRIM_ARGS(1);
 
   first = es->message_receiver;
@@ -914,7 +928,7 @@ SYX_FUNC_PRIMITIVE (SmallInteger_ne)
 SYX_FUNC_PRIMITIVE (SmallInteger_div)
 {
   SyxOop second;
-  syx_int32 a, b;
+  syx_nint a, b;
   SYX_PRIM_ARGS(1);
 
   second = es->message_arguments[0];
@@ -944,7 +958,7 @@ SYX_FUNC_PRIMITIVE (SmallInteger_div)
 SYX_FUNC_PRIMITIVE (SmallInteger_mul)
 {
   SyxOop first, second;
-  syx_int32 a, b, result;
+  syx_nint a, b, result;
   SYX_PRIM_ARGS(1);
 
   first = es->message_receiver;
@@ -974,16 +988,24 @@ SYX_FUNC_PRIMITIVE (SmallInteger_mul)
 SYX_FUNC_PRIMITIVE (SmallInteger_mod)
 {
   SyxOop first, second;
+  syx_nint a, b, result;
   SYX_PRIM_ARGS(1);
 
   first = es->message_receiver;
   second = es->message_arguments[0];
-  if (!SYX_IS_SMALL_INTEGER (second))
+  if (!SYX_IS_SMALL_INTEGER (second) || !SYX_SMALL_INTEGER (second))
     {
       SYX_PRIM_FAIL;
     }
-  SYX_PRIM_RETURN (syx_small_integer_new (SYX_SMALL_INTEGER (first) %
-                                          SYX_SMALL_INTEGER (second)));
+
+  /* the sign of the result follows the divisor */
+  a = SYX_SMALL_INTEGER (first);
+  b = SYX_SMALL_INTEGER (second);
+  result = a % b;
+  if (result && ((result < 0) != (b < 0)))
+    result += b;
+
+  SYX_PRIM_RETURN (syx_small_integer_new (result));
 }
 
 SYX_FUNC_PRIMITIVE (SmallInteger_bitAnd)
@@ -1035,7 +1057,7 @@ SYX_FUNC_PRIMITIVE (SmallInteger_bitXor)
 SYX_FUNC_PRIMITIVE (SmallInteger_bitShift)
 {
   SyxOop arg;
-  syx_int32 val, shift;
+  syx_nint val, shift;
   SYX_PRIM_ARGS(1);
 
   val = SYX_SMALL_INTEGER(es->message_receiver);
@@ -1064,7 +1086,12 @@ SYX_FUNC_PRIMITIVE (SmallInteger_bitShift)
     }
   else
     {
-      SYX_PRIM_RETURN (syx_small_integer_new (val >> abs(shift)));
+      /* shifting by the width of the integer or more is undefined */
+      if (-shift >= (syx_nint) SYX_SMALL_INTEGER_BITS)
+        val = (val < 0 ? -1 : 0);
+      else
+        val >>= -shift;
+      SYX_PRIM_RETURN (syx_small_integer_new (val));
     }
 }
 
@@ -1088,12 +1115,12 @@ SYX_FUNC_PRIMITIVE (SmallInteger_asLargeInteger)
 
 #define _GET_Z mpz_t *z = (mpz_t *)SYX_OBJECT_DATA (es->message_receiver);
 #define _GET_Z2 mpz_t *op2; _GET_Z
-#define _GET_Z2R mpz_t *r; syx_int32 ret; _GET_Z2
-#define _GET_ZR mpz_t *r; syx_int32 ret; _GET_Z
+#define _GET_Z2R mpz_t *r; syx_nint ret; _GET_Z2
+#define _GET_ZR mpz_t *r; syx_nint ret; _GET_Z
 #define _GET_OP2 SYX_PRIM_ARGS(1); if (!SYX_OBJECT_IS_LARGE_INTEGER (es->message_arguments[0])) { SYX_PRIM_FAIL; } \
   op2 = (mpz_t *)SYX_OBJECT_DATA (es->message_arguments[0]);
 #define _NEW_R r = syx_calloc (1, sizeof (mpz_t)); mpz_init (*r)
-#define _RET_R if (mpz_fits_sint_p (*r) && SYX_SMALL_INTEGER_CAN_EMBED (mpz_get_si (*r))) \
+#define _RET_R if (mpz_fits_slong_p (*r) && SYX_SMALL_INTEGER_CAN_EMBED (mpz_get_si (*r))) \
     { ret = mpz_get_si (*r); mpz_clear (*r); syx_free (r);        \
       SYX_PRIM_RETURN (syx_small_integer_new (ret)); }                        \
   else                                                                        \
@@ -1254,17 +1281,6 @@ SYX_FUNC_PRIMITIVE(LargeInteger_asFloat)
 
 
 
-SYX_FUNC_PRIMITIVE(LargeInteger_clear)
-{
-#ifdef HAVE_LIBGMP
-  _GET_Z;
-  mpz_clear (*z);
-  SYX_PRIM_RETURN(syx_nil);
-#else
-  SYX_PRIM_FAIL;
-#endif /* HAVE_LIBGMP */
-}
-
 
 
 
@@ -1475,7 +1491,9 @@ SYX_FUNC_PRIMITIVE (Float_floor)
 
 SYX_FUNC_PRIMITIVE (Float_trunc)
 {
-  int ret = (int) SYX_OBJECT_FLOAT (es->message_receiver);
+  double ret = SYX_OBJECT_FLOAT (es->message_receiver);
+
+  ret = (ret < 0 ? ceil (ret) : floor (ret));
 
   if (!SYX_SMALL_INTEGER_CAN_EMBED (ret))
     {
@@ -1580,12 +1598,199 @@ SYX_FUNC_PRIMITIVE (ObjectMemory_snapshot)
   return FALSE;
 }
 
+SYX_FUNC_PRIMITIVE (ObjectMemory_backgroundSnapshot)
+{
+  SyxOop filename;
+  SyxOop semaphore;
+  syx_nint fd;
+  SYX_PRIM_ARGS(2);
+
+  filename = es->message_arguments[0];
+  semaphore = es->message_arguments[1];
+
+  /* a process resumed from the image finds false, the image has been written already */
+  syx_interp_stack_push (syx_false);
+
+  if (SYX_IS_NIL (filename))
+    fd = syx_memory_save_image_background (NULL);
+  else
+    fd = syx_memory_save_image_background (SYX_OBJECT_STRING (filename));
+
+  (void) syx_interp_stack_pop ();
+  if (fd < 0)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  /* resume once the child process reports the result */
+  syx_semaphore_wait (semaphore);
+  syx_scheduler_poll_read_register (fd, semaphore);
+  SYX_PRIM_YIELD (syx_true);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_waitBackgroundSnapshot)
+{
+  SYX_PRIM_RETURN (syx_boolean_new (syx_memory_wait_image_background ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_backgroundSnapshotInProgress)
+{
+  SYX_PRIM_RETURN (syx_boolean_new (syx_memory_is_saving_image_background ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_deltaSnapshot)
+{
+  SyxOop filename;
+  syx_bool ret;
+  SYX_PRIM_ARGS(1);
+  
+  filename = es->message_arguments[0];
+
+  /* store the returned object for this process before saving the image */
+  syx_interp_stack_push (es->message_receiver);
+
+  if (SYX_IS_NIL (filename))
+    ret = syx_memory_save_image_delta (NULL);
+  else
+    ret = syx_memory_save_image_delta (SYX_OBJECT_STRING (filename));
+
+  if (!ret)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  return FALSE;
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_externalizeSources)
+{
+  SyxOop filename;
+  SYX_PRIM_ARGS(1);
+
+  filename = es->message_arguments[0];
+  if (!SYX_OBJECT_IS_STRING (filename))
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  SYX_PRIM_RETURN (syx_boolean_new (syx_memory_externalize_sources (SYX_OBJECT_SYMBOL (filename))));
+}
+
+/* Answer an unsigned counter as a SmallInteger, or a LargeInteger if it doesn't fit */
+static SyxOop
+_syx_primitive_counter_new (syx_uint64 counter)
+{
+#ifdef HAVE_LIBGMP
+  mpz_t *z;
+#endif
+
+  if (counter <= (syx_uint64) SYX_SMALL_INTEGER_MAX)
+    return syx_small_integer_new ((syx_nint) counter);
+
+#ifdef HAVE_LIBGMP
+  z = syx_calloc (1, sizeof (mpz_t));
+  /* unsigned long might be 32 bits wide */
+  mpz_init_set_ui (*z, (unsigned long) (counter >> 32));
+  mpz_mul_2exp (*z, *z, 32);
+  mpz_add_ui (*z, *z, (unsigned long) (counter & 0xFFFFFFFF));
+  return syx_large_integer_new_mpz (z);
+#else
+  return syx_small_integer_new (SYX_SMALL_INTEGER_MAX);
+#endif
+}
+
 SYX_FUNC_PRIMITIVE (ObjectMemory_garbageCollect)
 {
   syx_memory_gc ();
   SYX_PRIM_RETURN (es->message_receiver);
 }
 
+/* Answer the counters of SyxMemoryStats in order, the pause histogram being an Array */
+SYX_FUNC_PRIMITIVE (ObjectMemory_statistics)
+{
+  SyxMemoryStats stats;
+  SyxMemoryHandleScope scope;
+  SyxOop result, pauses;
+  syx_int32 i;
+
+  syx_memory_get_stats (&stats);
+
+  scope = syx_memory_handle_scope_open ();
+  pauses = syx_array_new_size (SYX_MEMORY_PAUSE_BUCKETS);
+  for (i=0; i < SYX_MEMORY_PAUSE_BUCKETS; i++)
+    SYX_OBJECT_DATA(pauses)[i] = _syx_primitive_counter_new (stats.pauses[i]);
+
+  result = syx_array_new_size (13);
+  SYX_OBJECT_DATA(result)[0] = _syx_primitive_counter_new (stats.full_collections);
+  SYX_OBJECT_DATA(result)[1] = _syx_primitive_counter_new (stats.young_collections);
+  SYX_OBJECT_DATA(result)[2] = _syx_primitive_counter_new (stats.incremental_collections);
+  SYX_OBJECT_DATA(result)[3] = _syx_primitive_counter_new (stats.allocated_objects);
+  SYX_OBJECT_DATA(result)[4] = _syx_primitive_counter_new (stats.reclaimed_objects);
+  SYX_OBJECT_DATA(result)[5] = _syx_primitive_counter_new (stats.allocated_bytes);
+  SYX_OBJECT_DATA(result)[6] = _syx_primitive_counter_new (stats.freed_bytes);
+  SYX_OBJECT_DATA(result)[7] = _syx_primitive_counter_new (stats.finalized_objects);
+  SYX_OBJECT_DATA(result)[8] = pauses;
+  SYX_OBJECT_DATA(result)[9] = _syx_primitive_counter_new (stats.max_pause);
+  SYX_OBJECT_DATA(result)[10] = _syx_primitive_counter_new (stats.average_pause);
+  SYX_OBJECT_DATA(result)[11] = syx_small_integer_new (stats.size);
+  SYX_OBJECT_DATA(result)[12] = syx_small_integer_new (stats.used);
+  syx_memory_handle_scope_close (scope);
+
+  SYX_PRIM_RETURN (result);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_instanceCount)
+{
+  SYX_PRIM_ARGS(1);
+  SYX_PRIM_RETURN (syx_small_integer_new (syx_memory_count_instances (es->message_arguments[0])));
+}
+
+/* Answer an Array holding each class followed by the number of its instances */
+SYX_FUNC_PRIMITIVE (ObjectMemory_instanceCounts)
+{
+  syx_int32 *counts;
+  syx_int32 i, classes;
+  SyxOop result;
+
+  counts = syx_memory_count_all_instances ();
+  for (i=0, classes=0; i < syx_memory_get_size (); i++)
+    {
+      if (counts[i])
+        classes++;
+    }
+
+  result = syx_array_new_size (classes * 2);
+  for (i=0, classes=0; i < syx_memory_get_size (); i++)
+    {
+      if (counts[i])
+        {
+          SYX_OBJECT_DATA(result)[classes++] = (SyxOop) (syx_memory + i);
+          SYX_OBJECT_DATA(result)[classes++] = syx_small_integer_new (counts[i]);
+        }
+    }
+  syx_free (counts);
+
+  SYX_PRIM_RETURN (result);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_logTo)
+{
+  SyxOop path = es->message_arguments[0];
+  SYX_PRIM_ARGS(1);
+
+  if (!SYX_IS_NIL (path) && !SYX_OBJECT_IS_STRING (path))
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  if (!syx_memory_set_log (SYX_IS_NIL (path) ? NULL : SYX_OBJECT_SYMBOL (path)))
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
 SYX_FUNC_PRIMITIVE (ObjectMemory_atDataPut)
 {
   SyxOop source;
@@ -1601,14 +1806,17 @@ SYX_FUNC_PRIMITIVE (ObjectMemory_atDataPut)
     {
       SYX_PRIM_FAIL;
     }
-  syx_free (SYX_OBJECT_DATA(dest));
   if (has_refs)
-    SYX_OBJECT_DATA(dest) = (SyxOop *) syx_memdup (SYX_OBJECT_DATA(source),
-                                                   SYX_OBJECT_DATA_SIZE(source), sizeof (SyxOop));
+    {
+      syx_object_set_data (dest, (SyxOop *) syx_memdup (SYX_OBJECT_DATA(source),
+                                                        SYX_OBJECT_DATA_SIZE(source), sizeof (SyxOop)),
+                           SYX_OBJECT_DATA_SIZE(source));
+      syx_memory_remember (dest);
+    }
   else
-    SYX_OBJECT_DATA(dest) = (SyxOop *) syx_memdup (SYX_OBJECT_DATA(source),
-                                                   SYX_OBJECT_DATA_SIZE(source), sizeof (syx_int8));
-  SYX_OBJECT_DATA_SIZE(dest) = SYX_OBJECT_DATA_SIZE(source);
+    syx_object_set_data (dest, (SyxOop *) syx_memdup (SYX_OBJECT_DATA(source),
+                                                      SYX_OBJECT_DATA_SIZE(source), sizeof (syx_int8)),
+                         SYX_OBJECT_DATA_SIZE(source));
   SYX_PRIM_RETURN (es->message_receiver);
 }
 
@@ -1619,10 +1827,140 @@ SYX_FUNC_PRIMITIVE (ObjectMemory_setConstant)
   if (SYX_IS_OBJECT (oop))
     {
       SYX_OBJECT_IS_CONSTANT(oop) = TRUE;
+      SYX_OBJECT_IS_DIRTY(oop) = TRUE;
     }
   SYX_PRIM_RETURN(es->message_receiver);
 }
 
+SYX_FUNC_PRIMITIVE (ObjectMemory_flushMethodCache)
+{
+  syx_method_cache_invalidate ();
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_methodCacheHits)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new (_syx_method_cache_hits));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_methodCacheMisses)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new (_syx_method_cache_misses));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_quickMethodCalls)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new (_syx_interp_quick_method_calls));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_incremental)
+{
+  SYX_PRIM_RETURN (syx_boolean_new (syx_memory_gc_is_incremental ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_setIncremental)
+{
+  SYX_PRIM_ARGS(1);
+  syx_memory_gc_set_incremental (SYX_IS_TRUE (es->message_arguments[0]));
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_pauseBudget)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new (syx_memory_gc_get_pause_budget ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_setPauseBudget)
+{
+  SyxOop usecs = es->message_arguments[0];
+  SYX_PRIM_ARGS(1);
+
+  if (!SYX_IS_SMALL_INTEGER (usecs) || SYX_SMALL_INTEGER (usecs) <= 0)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  syx_memory_gc_set_pause_budget (SYX_SMALL_INTEGER (usecs));
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_maxPause)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new ((syx_uint32) syx_memory_gc_get_max_pause ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_averagePause)
+{
+  SYX_PRIM_RETURN (_syx_primitive_counter_new ((syx_uint32) syx_memory_gc_get_average_pause ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_nextFinalizable)
+{
+  SYX_PRIM_RETURN (syx_memory_finalization_next ());
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_size)
+{
+  SYX_PRIM_RETURN (syx_small_integer_new (syx_memory_get_size ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_maxSize)
+{
+  SYX_PRIM_RETURN (syx_small_integer_new (syx_memory_get_max_size ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_setMaxSize)
+{
+  SyxOop size = es->message_arguments[0];
+  SYX_PRIM_ARGS(1);
+
+  if (!SYX_IS_SMALL_INTEGER (size) || SYX_SMALL_INTEGER (size) <= 0)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  syx_memory_set_max_size (SYX_SMALL_INTEGER (size));
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_growThreshold)
+{
+  SYX_PRIM_RETURN (syx_small_integer_new (syx_memory_get_grow_threshold ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_setGrowThreshold)
+{
+  SyxOop percent = es->message_arguments[0];
+  SYX_PRIM_ARGS(1);
+
+  if (!SYX_IS_SMALL_INTEGER (percent) || SYX_SMALL_INTEGER (percent) < 0 || SYX_SMALL_INTEGER (percent) > 100)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  syx_memory_set_grow_threshold (SYX_SMALL_INTEGER (percent));
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_shrinkThreshold)
+{
+  SYX_PRIM_RETURN (syx_small_integer_new (syx_memory_get_shrink_threshold ()));
+}
+
+SYX_FUNC_PRIMITIVE (ObjectMemory_setShrinkThreshold)
+{
+  SyxOop percent = es->message_arguments[0];
+  SYX_PRIM_ARGS(1);
+
+  if (!SYX_IS_SMALL_INTEGER (percent) || SYX_SMALL_INTEGER (percent) < 0 || SYX_SMALL_INTEGER (percent) > 100)
+    {
+      SYX_PRIM_FAIL;
+    }
+
+  syx_memory_set_shrink_threshold (SYX_SMALL_INTEGER (percent));
+  SYX_PRIM_RETURN (es->message_receiver);
+}
+
 SYX_FUNC_PRIMITIVE (Smalltalk_quit)
 {
   syx_int32 status = SYX_SMALL_INTEGER (es->message_arguments[0]);
@@ -1633,7 +1971,7 @@ SYX_FUNC_PRIMITIVE (Smalltalk_quit)
 
 SYX_FUNC_PRIMITIVE (Smalltalk_pluginCall)
 {
-  SyxOop message_arguments[0xFF];
+  SyxOop *message_arguments;
   syx_varsize message_arguments_count;
   SyxOop plugin = es->message_arguments[0];
   syx_symbol plugin_name = NULL;
@@ -1650,15 +1988,15 @@ SYX_FUNC_PRIMITIVE (Smalltalk_pluginCall)
     plugin_name = SYX_OBJECT_SYMBOL (plugin);
 
   /* save the real state */
-  memcpy (message_arguments, es->message_arguments, es->message_arguments_count * sizeof (SyxOop));
+  message_arguments = es->message_arguments;
   message_arguments_count = es->message_arguments_count;
   es->message_arguments_count = SYX_OBJECT_DATA_SIZE(arguments);
-  memcpy (es->message_arguments, SYX_OBJECT_DATA (arguments), es->message_arguments_count * sizeof (SyxOop));
+  es->message_arguments = SYX_OBJECT_DATA (arguments);
 
   ret = syx_plugin_call (es, plugin_name, SYX_OBJECT_SYMBOL (func), method);
 
   /* restore the state */
-  memcpy (es->message_arguments, message_arguments, message_arguments_count * sizeof (SyxOop));
+  es->message_arguments = message_arguments;
   es->message_arguments_count = message_arguments_count;
 
   return ret;
@@ -1737,6 +2075,11 @@ SYX_FUNC_PRIMITIVE (CompiledMethod_runOn)
   return syx_interp_enter_context (syx_processor_active_process, context);
 }
 
+SYX_FUNC_PRIMITIVE (CompiledCode_text)
+{
+  SYX_PRIM_RETURN (syx_code_get_text (es->message_receiver));
+}
+
 SYX_FUNC_PRIMITIVE (Compiler_parse)
 {
   SyxLexer *lexer;
@@ -1802,6 +2145,7 @@ SYX_FUNC_PRIMITIVE (Compiler_parseChunk)
   /* get the next chunk */
   text = syx_lexer_next_chunk (lexer);
   SYX_OBJECT_DATA(pos)[0] = syx_small_integer_new (lexer->_current_text - lexer->text);
+  SYX_OBJECT_IS_DIRTY(pos) = TRUE;
   syx_lexer_free (lexer, FALSE);
 
   if (!text)
@@ -1903,6 +2247,7 @@ SYX_FUNC_PRIMITIVE (CStruct_on_type_at)
   SyxOop ret;
   char *handle;
   syx_int32 offset;
+  syx_nint value;
   SYX_PRIM_ARGS(2);
 
   _CStruct_initialize_types ();
@@ -1915,18 +2260,19 @@ SYX_FUNC_PRIMITIVE (CStruct_on_type_at)
     ret = syx_character_new (*(handle+offset));
   else if (SYX_OOP_EQ (type, type_short_int))
     ret = syx_small_integer_new (*(syx_int16 *)(handle+offset));
-  else if (SYX_OOP_EQ (type, type_int))
+  else if (SYX_OOP_EQ (type, type_int) || SYX_OOP_EQ (type, type_long))
     {
-      ret = syx_small_integer_new (*(syx_int32 *)(handle+offset));
-      if (!SYX_SMALL_INTEGER_CAN_EMBED (ret))
+      if (SYX_OOP_EQ (type, type_int))
+        value = *(syx_int32 *)(handle+offset);
+      else
+        value = *(syx_nint *)(handle+offset);
+
+      if (!SYX_SMALL_INTEGER_CAN_EMBED (value))
         {
           /* FIXME: turn into LargeInteger */
           SYX_PRIM_FAIL;
         }
-    }
-  else if (SYX_OOP_EQ (type, type_long))
-    {
-      SYX_PRIM_FAIL;
+      ret = syx_small_integer_new (value);
     }
   else if (SYX_OOP_EQ (type, type_pointer))
     ret = SYX_POINTER_CAST_OOP (*(syx_pointer *)(handle+offset));
@@ -1966,10 +2312,7 @@ SYX_FUNC_PRIMITIVE (CStruct_on_type_at_put)
   else if (SYX_OOP_EQ (type, type_int))
     *(syx_int32 *)(handle+offset) = SYX_SMALL_INTEGER (value);
   else if (SYX_OOP_EQ (type, type_long))
-    {
-      /* TODO */
-      SYX_PRIM_FAIL;
-    }
+    *(syx_nint *)(handle+offset) = SYX_SMALL_INTEGER (value);
   else if (SYX_OOP_EQ (type, type_pointer))
     *(syx_pointer *)(handle+offset) = SYX_OOP_CAST_POINTER (value);
   else if (SYX_OOP_EQ (type, type_float))
@@ -2036,6 +2379,7 @@ SyxPrimitiveEntry _syx_primitive_entries[] = {
   /* Contexts */
   { "ContextPart_parent", ContextPart_parent },
   { "ContextPart_receiver", ContextPart_receiver },
+  { "ContextPart_isClean", ContextPart_isClean },
   { "BlockContext_outerContext", BlockContext_outerContext },
 
   /* Interpreter */
@@ -2095,7 +2439,6 @@ SyxPrimitiveEntry _syx_primitive_entries[] = {
   { "LargeInteger_bitOr", LargeInteger_bitOr },
   { "LargeInteger_bitXor", LargeInteger_bitXor },
   { "LargeInteger_bitShift", LargeInteger_bitShift },
-  { "LargeInteger_clear", LargeInteger_clear },
   { "LargeInteger_asFloat", LargeInteger_asFloat },
 
   /* Floats */
@@ -2124,9 +2467,36 @@ SyxPrimitiveEntry _syx_primitive_entries[] = {
 
   /* Object memory */
   { "ObjectMemory_snapshot", ObjectMemory_snapshot },
+  { "ObjectMemory_backgroundSnapshot", ObjectMemory_backgroundSnapshot },
+  { "ObjectMemory_waitBackgroundSnapshot", ObjectMemory_waitBackgroundSnapshot },
+  { "ObjectMemory_backgroundSnapshotInProgress", ObjectMemory_backgroundSnapshotInProgress },
+  { "ObjectMemory_deltaSnapshot", ObjectMemory_deltaSnapshot },
+  { "ObjectMemory_externalizeSources", ObjectMemory_externalizeSources },
   { "ObjectMemory_garbageCollect", ObjectMemory_garbageCollect },
+  { "ObjectMemory_statistics", ObjectMemory_statistics },
+  { "ObjectMemory_instanceCount", ObjectMemory_instanceCount },
+  { "ObjectMemory_instanceCounts", ObjectMemory_instanceCounts },
+  { "ObjectMemory_logTo", ObjectMemory_logTo },
   { "ObjectMemory_atDataPut", ObjectMemory_atDataPut },
   { "ObjectMemory_setConstant", ObjectMemory_setConstant },
+  { "ObjectMemory_flushMethodCache", ObjectMemory_flushMethodCache },
+  { "ObjectMemory_methodCacheHits", ObjectMemory_methodCacheHits },
+  { "ObjectMemory_methodCacheMisses", ObjectMemory_methodCacheMisses },
+  { "ObjectMemory_quickMethodCalls", ObjectMemory_quickMethodCalls },
+  { "ObjectMemory_incremental", ObjectMemory_incremental },
+  { "ObjectMemory_setIncremental", ObjectMemory_setIncremental },
+  { "ObjectMemory_pauseBudget", ObjectMemory_pauseBudget },
+  { "ObjectMemory_setPauseBudget", ObjectMemory_setPauseBudget },
+  { "ObjectMemory_maxPause", ObjectMemory_maxPause },
+  { "ObjectMemory_averagePause", ObjectMemory_averagePause },
+  { "ObjectMemory_nextFinalizable", ObjectMemory_nextFinalizable },
+  { "ObjectMemory_size", ObjectMemory_size },
+  { "ObjectMemory_maxSize", ObjectMemory_maxSize },
+  { "ObjectMemory_setMaxSize", ObjectMemory_setMaxSize },
+  { "ObjectMemory_growThreshold", ObjectMemory_growThreshold },
+  { "ObjectMemory_setGrowThreshold", ObjectMemory_setGrowThreshold },
+  { "ObjectMemory_shrinkThreshold", ObjectMemory_shrinkThreshold },
+  { "ObjectMemory_setShrinkThreshold", ObjectMemory_setShrinkThreshold },
 
   /* Smalltalk environment */
   { "Smalltalk_quit", Smalltalk_quit },
@@ -2138,6 +2508,7 @@ SyxPrimitiveEntry _syx_primitive_entries[] = {
 
   /* Compiler */
   { "CompiledMethod_runOn", CompiledMethod_runOn },
+  { "CompiledCode_text", CompiledCode_text },
   { "Compiler_parse", Compiler_parse },
   { "Compiler_parseChunk", Compiler_parseChunk },
 
@@ -124,6 +124,7 @@ syx_scheduler_iterate (void)
 
   syx_processor_active_process = proc;
   syx_process_execute_scheduled (proc);
+  syx_memory_gc_step ();
   return TRUE;
 }
 
@@ -148,6 +149,7 @@ syx_scheduler_run (void)
 #endif
 
       syx_process_execute_scheduled (syx_processor_active_process);
+      syx_memory_gc_step ();
     }
 
   running = FALSE;
@@ -59,15 +59,29 @@ SYX_BEGIN_DECLS
 /*! Cast a pointer to a SyxOop */
 #define SYX_POINTER_CAST_OOP(ptr) ((SyxOop) (ptr))
 
-/*! TRUE if the number can be embedded */
-#define SYX_SMALL_INTEGER_CAN_EMBED(num) ((num) >= (-1 << 30) && (num) < (1 << 30))
+/*! Bits held by a SmallInteger, the remaining bit of the oop is the tag. 31 bits on 32-bit hosts, 63 bits on 64-bit hosts */
+#define SYX_SMALL_INTEGER_BITS (sizeof (SyxOop) * CHAR_BIT - 1)
+/*! The lowest SmallInteger */
+#define SYX_SMALL_INTEGER_MIN (-((syx_nint) 1 << (SYX_SMALL_INTEGER_BITS - 1)))
+/*! The highest SmallInteger */
+#define SYX_SMALL_INTEGER_MAX (((syx_nint) 1 << (SYX_SMALL_INTEGER_BITS - 1)) - 1)
+
+/*! TRUE if the number can be embedded. The upper bound is exclusive to hold for floating point numbers too */
+#define SYX_SMALL_INTEGER_CAN_EMBED(num) ((num) >= SYX_SMALL_INTEGER_MIN && (num) < -SYX_SMALL_INTEGER_MIN)
+/*! TRUE if a syx_int32 can be embedded. Any of them can be when SyxOop is wider than 32 bits,
+  so the range isn't compared with types which can't exceed it */
+#if LONG_MAX > 0x7FFFFFFFL
+#define SYX_SMALL_INTEGER_CAN_EMBED_INT32(num) TRUE
+#else
+#define SYX_SMALL_INTEGER_CAN_EMBED_INT32(num) SYX_SMALL_INTEGER_CAN_EMBED (num)
+#endif
 /*! TRUE if an overflow occurs when doing the sum of a and b */
-#define SYX_SMALL_INTEGER_SUM_OVERFLOW(a,b) (((a ^ b) | (((a ^ (~(a ^ b) & (1 << (sizeof(syx_int32) * CHAR_BIT - 1)))) + b) ^ b)) >= 0)
+#define SYX_SMALL_INTEGER_SUM_OVERFLOW(a,b) (((a ^ b) | (((a ^ (~(a ^ b) & ((syx_nint) 1 << (sizeof(syx_nint) * CHAR_BIT - 1)))) + b) ^ b)) >= 0)
 /*! TRUE if an overflow occurs when doing the difference between a and b */
-#define SYX_SMALL_INTEGER_DIFF_OVERFLOW(a,b) (((a ^ b) & (((a ^ ((a ^ b) & (1 << (sizeof(syx_int32) * CHAR_BIT - 1)))) - b) ^ b)) < 0)
+#define SYX_SMALL_INTEGER_DIFF_OVERFLOW(a,b) (((a ^ b) & (((a ^ ((a ^ b) & ((syx_nint) 1 << (sizeof(syx_nint) * CHAR_BIT - 1)))) - b) ^ b)) < 0)
 /*! TRUE if an overflow occurs when doing division between a and b */
-#define SYX_SMALL_INTEGER_DIV_OVERFLOW(a,b) ((b == 0) || ((a == INT_MIN) && (b == -1)))
-/*! Force the embedding of an integer */
+#define SYX_SMALL_INTEGER_DIV_OVERFLOW(a,b) ((b == 0) || ((a == LONG_MIN) && (b == -1)))
+/*! Force the embedding of an integer. The result is the same on 32-bit and 64-bit hosts, used for hashes */
 #define SYX_SMALL_INTEGER_EMBED(num) ((syx_int32)(num) & ~(3 << 30))
 
 #if !defined FALSE || !defined TRUE
@@ -142,16 +156,16 @@ typedef syx_nint SyxOop;
 /*! Create a new Character */
 #define syx_character_new(ch) (((SyxOop)(ch) << 2) + SYX_TYPE_CHARACTER)
 
-/*! Retrieve a syx_int32 from a SyxOop */
-#define SYX_SMALL_INTEGER(oop) ((syx_int32)(oop) >> 1)
+/*! Retrieve a syx_nint from a SyxOop */
+#define SYX_SMALL_INTEGER(oop) ((syx_nint)(oop) >> 1)
 /*! Retrieve a syx_uchar from a SyxOop */
 #define SYX_CHARACTER(oop) ((syx_uchar)((oop) >> 2))
 
 
 /*! TRUE if an overflow occurs when doing b times a */
-EXPORT syx_bool SYX_SMALL_INTEGER_MUL_OVERFLOW (syx_int32 a, syx_int32 b);
+EXPORT syx_bool SYX_SMALL_INTEGER_MUL_OVERFLOW (syx_nint a, syx_nint b);
 /*! TRUE if an overflow occurs when shifting a on the left by b */
-EXPORT syx_bool SYX_SMALL_INTEGER_SHIFT_OVERFLOW (syx_int32 a, syx_int32 b);
+EXPORT syx_bool SYX_SMALL_INTEGER_SHIFT_OVERFLOW (syx_nint a, syx_nint b);
 
 
 
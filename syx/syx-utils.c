@@ -178,6 +178,7 @@ _syx_cold_parse_class (SyxLexer *lexer)
               SYX_CLASS_SUPERCLASS(syx_object_get_class (subclass)) = syx_object_get_class (superclass);
               syx_array_add (SYX_CLASS_SUBCLASSES (syx_object_get_class (superclass)),
                              syx_object_get_class (subclass), TRUE);
+              syx_method_cache_invalidate ();
             }
         }
     }
@@ -259,6 +260,9 @@ _syx_cold_parse_class (SyxLexer *lexer)
   for (i=0; i < SYX_OBJECT_DATA_SIZE(class_vars); i++)
     syx_dictionary_at_symbol_put (SYX_CLASS_CLASS_VARIABLES(subclass),
                                   SYX_OBJECT_DATA(class_vars)[i], syx_nil);
+  /* an existing class may be old while its new variables are young */
+  syx_memory_remember (subclass);
+  syx_memory_remember (syx_object_get_class (subclass));
   /* get rid of this */
   syx_object_free (class_vars);
 
@@ -325,6 +329,7 @@ syx_cold_parse_methods (SyxLexer *lexer)
   if (SYX_IS_NIL (SYX_CLASS_METHODS (klass)))
     {
       SYX_CLASS_METHODS(klass) = syx_dictionary_new (50);
+      syx_memory_write_barrier (klass, SYX_CLASS_METHODS(klass));
     }
 
   while (TRUE)
@@ -343,7 +348,8 @@ syx_cold_parse_methods (SyxLexer *lexer)
 
       syx_parser_free (parser, TRUE);
     }
-  
+
+  syx_method_cache_invalidate ();
   return TRUE;
 }
 
@@ -623,7 +629,7 @@ syx_show_traceback (void)
   syx_symbol traceformat;
   SyxOop classname;
   syx_symbol extraclass;
-  SyxOop receiver;
+  SyxOop klass;
 
   if (!syx_memory)
     {
@@ -637,10 +643,10 @@ syx_show_traceback (void)
   puts ("Memory state:");
   printf("Memory size: %d\n", _syx_memory_size);
   printf("Freed memory top: %d\n", _syx_freed_memory_top);
-  if (!_syx_memory_gc_trans_running)
-    puts ("No GC transaction");
+  if (!_syx_memory_handle_scopes)
+    puts ("No handle scope");
   else
-    printf("GC transaction top: %d\n", _syx_memory_gc_trans_top);
+    printf("Handle scopes: %d\n", _syx_memory_handle_scopes);
 
   if (!es)
     {
@@ -694,11 +700,15 @@ syx_show_traceback (void)
           traceformat = "%s%s>>%s\n";
         }
 
-      receiver = frame->receiver;
-      classname = SYX_CLASS_NAME(syx_object_get_class(receiver));
+      /* clean blocks have no receiver */
+      if (SYX_INTERP_FRAME_IS_CLEAN (homeframe))
+        klass = SYX_CODE_CLASS(homeframe->method);
+      else
+        klass = syx_object_get_class(frame->receiver);
+      classname = SYX_CLASS_NAME(klass);
       if (SYX_IS_NIL (classname))
         {
-          classname = SYX_CLASS_NAME(SYX_METACLASS_INSTANCE_CLASS(syx_object_get_class(receiver)));
+          classname = SYX_CLASS_NAME(SYX_METACLASS_INSTANCE_CLASS(klass));
           extraclass = " class";
         }
       else
@@ -29,12 +29,10 @@
 
 #ifdef HAVE_STDARG_H
 #ifdef __APPLE__
-#define _ISOC99_SOURCE 1
 #define _C99_SOURCE 1
 #include <stdio.h>
 #include <stdarg.h>
 #else
-#define _ISOC99_SOURCE 1
 #include <stdarg.h>
 #endif
 #endif
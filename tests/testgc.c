@@ -0,0 +1,350 @@
+/*
+   Copyright (c) 2007-2008 Luca Bruno
+
+   This file is part of Smalltalk YX.
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+#include "../syx/syx.h"
+
+#include <assert.h>
+#include <stdio.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+/* Long enough to overflow the C stack with a recursive marking */
+#define LIST_SIZE 10000000
+
+/* More than the 256 objects of the old GC transactions */
+#define HANDLES_SIZE 10000
+
+static SyxOop _object_class;
+
+/* Collect the whole memory, either at once or in slices of an incremental collection */
+static void
+_collect (syx_bool incremental)
+{
+  SyxMemoryStats stats;
+  syx_uint32 collections;
+
+  if (!incremental)
+    {
+      syx_memory_gc ();
+      return;
+    }
+
+  /* slices start once free objects are running out, so allocate garbage until the collection ends */
+  syx_memory_get_stats (&stats);
+  collections = stats.incremental_collections;
+  while (stats.incremental_collections == collections)
+    {
+      if (!_syx_memory_gc_marking)
+        syx_object_new (_object_class);
+      syx_memory_gc_step ();
+      syx_memory_get_stats (&stats);
+    }
+}
+
+static void
+_test_weak_references (syx_bool incremental)
+{
+  SyxOop weak, ephemeron, live_ephemeron, live, klass;
+  SyxMemoryStats stats;
+  syx_uint64 finalized;
+
+  syx_memory_gc_set_incremental (incremental);
+
+  live = syx_object_new (_object_class);
+  weak = syx_object_new_size (syx_weak_array_class, TRUE, 2);
+  SYX_OBJECT_DATA(weak)[0] = syx_object_new (_object_class);
+  SYX_OBJECT_DATA(weak)[1] = live;
+
+  ephemeron = syx_object_new (syx_ephemeron_class);
+  SYX_ASSOCIATION_KEY(ephemeron) = syx_object_new (_object_class);
+  SYX_ASSOCIATION_VALUE(ephemeron) = syx_object_new (_object_class);
+  live_ephemeron = syx_object_new (syx_ephemeron_class);
+  SYX_ASSOCIATION_KEY(live_ephemeron) = live;
+  SYX_ASSOCIATION_VALUE(live_ephemeron) = syx_object_new (_object_class);
+
+  /* the class is reachable from the subclasses of Object */
+  klass = syx_class_new (_object_class);
+  SYX_CLASS_FINALIZATION(klass) = syx_true;
+  syx_object_new (klass);
+
+  syx_memory_root_add (&live);
+  syx_memory_root_add (&weak);
+  syx_memory_root_add (&ephemeron);
+  syx_memory_root_add (&live_ephemeron);
+  syx_memory_get_stats (&stats);
+  finalized = stats.finalized_objects;
+  _collect (incremental);
+
+  /* collected objects are cleared from weak arrays */
+  assert (SYX_IS_NIL (SYX_OBJECT_DATA(weak)[0]));
+  assert (SYX_OOP_EQ (SYX_OBJECT_DATA(weak)[1], live));
+
+  /* values are released once keys die */
+  assert (SYX_IS_NIL (SYX_ASSOCIATION_KEY(ephemeron)));
+  assert (SYX_IS_NIL (SYX_ASSOCIATION_VALUE(ephemeron)));
+  assert (SYX_OOP_EQ (SYX_ASSOCIATION_KEY(live_ephemeron), live));
+  assert (!SYX_IS_NIL (syx_object_get_class (SYX_ASSOCIATION_VALUE(live_ephemeron))));
+
+  /* the finalizer process drains the queue */
+  syx_memory_gc_step ();
+  syx_scheduler_run ();
+  assert (SYX_IS_NIL (syx_memory_finalization_next ()));
+  syx_memory_get_stats (&stats);
+  assert (stats.finalized_objects == finalized + 1);
+
+  syx_memory_root_remove (&live);
+  syx_memory_root_remove (&weak);
+  syx_memory_root_remove (&ephemeron);
+  syx_memory_root_remove (&live_ephemeron);
+  syx_memory_gc_set_incremental (FALSE);
+}
+
+static void
+_test_young_collection (void)
+{
+  SyxOop old, young, garbage;
+  SyxMemoryStats stats;
+  syx_uint32 collections;
+
+  /* survivors of a young collection become old */
+  old = syx_array_new_size (1);
+  syx_memory_root_add (&old);
+  syx_memory_gc_young ();
+  assert (!SYX_OBJECT_IS_YOUNG (old));
+
+  /* the old array is remembered once it refers to a young object */
+  young = syx_object_new (_object_class);
+  garbage = syx_object_new (_object_class);
+  assert (SYX_OBJECT_IS_YOUNG (young));
+  SYX_OBJECT_DATA(old)[0] = young;
+  syx_memory_write_barrier (old, young);
+  assert (SYX_OBJECT_IS_REMEMBERED (old));
+
+  syx_memory_get_stats (&stats);
+  collections = stats.young_collections;
+  syx_memory_gc_young ();
+  syx_memory_get_stats (&stats);
+  assert (stats.young_collections == collections + 1);
+
+  assert (!SYX_IS_NIL (syx_object_get_class (young)));
+  assert (!SYX_OBJECT_IS_YOUNG (young));
+  assert (SYX_IS_NIL (syx_object_get_class (garbage)));
+
+  syx_memory_root_remove (&old);
+}
+
+/* More links than marked by the shortest slice */
+#define CHAIN_SIZE 100000
+
+static void
+_test_incremental_collection (void)
+{
+  SyxOop chain, link, holder, hider, hidden, garbage;
+  SyxMemoryStats stats;
+  syx_uint32 collections, budget;
+  syx_int32 i;
+
+  /* the shortest slices, so that the objects are moved in the middle of the marking */
+  syx_memory_gc_set_incremental (TRUE);
+  budget = syx_memory_gc_get_pause_budget ();
+  syx_memory_gc_set_pause_budget (1);
+
+  /* the holder is marked first, the hider is at the end of a chain marked later */
+  holder = syx_array_new_size (1);
+  hider = syx_array_new_size (1);
+  hidden = syx_object_new (_object_class);
+  SYX_OBJECT_DATA(hider)[0] = hidden;
+  chain = hider;
+  syx_memory_root_add (&chain);
+  syx_memory_root_add (&holder);
+  for (i=0; i < CHAIN_SIZE; i++)
+    {
+      link = syx_array_new_size (1);
+      SYX_OBJECT_DATA(link)[0] = chain;
+      chain = link;
+    }
+  garbage = syx_object_new (_object_class);
+
+  /* young objects are left to young collections, make them old */
+  syx_memory_root_add (&garbage);
+  syx_memory_gc_young ();
+  syx_memory_root_remove (&garbage);
+
+  syx_memory_get_stats (&stats);
+  collections = stats.incremental_collections;
+  while (!_syx_memory_gc_marking)
+    {
+      syx_object_new (_object_class);
+      syx_memory_gc_step ();
+    }
+
+  /* move the only reference while marking, the barrier must keep the object alive */
+  SYX_OBJECT_DATA(holder)[0] = hidden;
+  syx_memory_write_barrier (holder, hidden);
+  SYX_OBJECT_DATA(hider)[0] = syx_nil;
+  syx_memory_write_barrier (hider, syx_nil);
+
+  while (stats.incremental_collections == collections)
+    {
+      syx_memory_gc_step ();
+      syx_memory_get_stats (&stats);
+    }
+
+  assert (!SYX_IS_NIL (syx_object_get_class (hidden)));
+  assert (SYX_OOP_EQ (SYX_OBJECT_DATA(holder)[0], hidden));
+  assert (SYX_IS_NIL (syx_object_get_class (garbage)));
+
+  syx_memory_root_remove (&chain);
+  syx_memory_root_remove (&holder);
+  syx_memory_gc_set_pause_budget (budget);
+  syx_memory_gc_set_incremental (FALSE);
+}
+
+int SYX_CDECL
+main (int argc, char *argv[])
+{
+  SyxOop klass, head, link;
+  syx_int32 i, freed, size, max_size;
+  syx_uint64 start, end;
+  SyxMemoryHandleScope scope;
+  SyxMemoryStats stats;
+
+  syx_init (0, NULL, "..");
+
+  puts ("- Test the size of the object header");
+  /* the body pointers followed by the class index with the flags, and the data size */
+  assert (sizeof (SyxObject) == 2 * sizeof (SyxOop *) + 2 * sizeof (syx_int32));
+
+  /* The system image doesn't fit such a list, so build a raw memory with a class for links */
+  syx_memory_init (LIST_SIZE + 100);
+  syx_nil = syx_memory_alloc ();
+  syx_true = syx_memory_alloc ();
+  syx_false = syx_memory_alloc ();
+  syx_symbols = syx_nil;
+  klass = syx_object_new_vars (syx_nil, SYX_VARS_CLASS_CLASS_ALL);
+  SYX_CLASS_INSTANCE_SIZE(klass) = syx_small_integer_new (0);
+  SYX_CLASS_FINALIZATION(klass) = syx_false;
+
+  puts ("- Test building a long linked list");
+  head = syx_nil;
+  for (i=0; i < LIST_SIZE; i++)
+    {
+      link = syx_object_new_size (klass, TRUE, 1);
+      SYX_OBJECT_DATA(link)[0] = head;
+      head = link;
+    }
+  syx_globals = head;
+  assert (SYX_OOP_EQ (syx_object_get_class (head), klass));
+
+  puts ("- Test marking the list");
+  start = syx_nanotime ();
+  syx_memory_gc ();
+  end = syx_nanotime ();
+  printf ("Time elapsed: %lu nanoseconds\n\n", (unsigned long) (end - start));
+
+  for (i=0, link=syx_globals; !SYX_IS_NIL (link); i++)
+    link = SYX_OBJECT_DATA(link)[0];
+  assert (i == LIST_SIZE);
+
+  puts ("- Test collecting the list");
+  syx_globals = syx_nil;
+  freed = _syx_freed_memory_top;
+  syx_memory_gc ();
+  assert (_syx_freed_memory_top - freed == LIST_SIZE);
+
+  puts ("- Test handle scopes");
+  scope = syx_memory_handle_scope_open ();
+  head = syx_memory_handle (syx_object_new_size (klass, TRUE, 1));
+  for (i=0; i < HANDLES_SIZE; i++)
+    syx_object_new_size (klass, TRUE, 1);
+  syx_memory_gc ();
+  assert (!SYX_IS_NIL (syx_object_get_class (head)));
+  syx_memory_handle_scope_close (scope);
+  freed = _syx_freed_memory_top;
+  syx_memory_gc ();
+  assert (_syx_freed_memory_top - freed == HANDLES_SIZE + 1);
+
+  puts ("- Test extra roots");
+  head = syx_object_new_size (klass, TRUE, 1);
+  syx_memory_root_add (&head);
+  syx_memory_gc ();
+  assert (!SYX_IS_NIL (syx_object_get_class (head)));
+  syx_memory_root_remove (&head);
+  freed = _syx_freed_memory_top;
+  syx_memory_gc ();
+  assert (_syx_freed_memory_top - freed == 1);
+
+  /* The table is reserved for the objects of the image, not for the memory it replaces */
+  puts ("- Test loading an image bigger than the memory");
+  syx_memory_clear ();
+  max_size = syx_memory_get_max_size ();
+  syx_memory_set_max_size (1000);
+  syx_memory_init (1000);
+  assert (syx_memory_load_image ("test.sim"));
+  syx_memory_get_stats (&stats);
+  assert (stats.size > 1000);
+  syx_memory_clear ();
+  syx_memory_set_max_size (max_size);
+
+  /* Weak references and finalization need the classes of the system image */
+  syx_memory_clear ();
+  syx_memory_load_image ("test.sim");
+  syx_scheduler_init ();
+  _object_class = syx_globals_at ("Object");
+
+  puts ("- Test growing and shrinking the memory");
+  syx_memory_get_stats (&stats);
+  size = stats.size;
+  head = syx_nil;
+  syx_memory_root_add (&head);
+  for (i=0; i < size; i++)
+    {
+      link = syx_array_new_size (1);
+      SYX_OBJECT_DATA(link)[0] = head;
+      head = link;
+    }
+  syx_memory_get_stats (&stats);
+  assert (stats.size > size);
+  syx_memory_root_remove (&head);
+  syx_memory_gc ();
+  syx_memory_get_stats (&stats);
+  assert (stats.size == size);
+
+  puts ("- Test collecting young objects");
+  _test_young_collection ();
+
+  puts ("- Test incremental collections");
+  _test_incremental_collection ();
+
+  puts ("- Test weak references and finalization");
+  _test_weak_references (FALSE);
+
+  puts ("- Test weak references and finalization with incremental collections");
+  _test_weak_references (TRUE);
+
+  syx_quit ();
+
+  return 0;
+}
@@ -29,27 +29,164 @@
 #endif
 #include "../syx/syx.h"
 
+/* Print the time elapsed and how fast the image has been transferred */
+static void
+_print_throughput (syx_symbol path, syx_uint64 elapsed)
+{
+  FILE *file = fopen (path, "rb");
+  long size;
+
+  assert (file != NULL);
+  fseek (file, 0, SEEK_END);
+  size = ftell (file);
+  fclose (file);
+
+  printf ("Time elapsed: %ld nanoseconds\n", (long) elapsed);
+  printf ("Throughput: %.1f MB/s (%ld bytes)\n\n",
+          elapsed ? (size / 1048576.0) / (elapsed / 1e9) : 0.0, size);
+}
+
+#ifdef HAVE_LIBGMP
+static void
+_check_large_integer (void)
+{
+  SyxOop large;
+  mpz_t expected;
+
+  mpz_init_set_si (expected, -1234567);
+  mpz_pow_ui (expected, expected, 5);
+  large = syx_globals_at ("TestLargeInteger");
+  assert (mpz_cmp (SYX_OBJECT_LARGE_INTEGER (large), expected) == 0);
+  mpz_clear (expected);
+}
+#endif
+
 int SYX_CDECL
 main (int argc, char *argv[])
 {
   syx_uint64 start, end;
   syx_bool saved, loaded;
+  syx_nint fd;
+  SyxOop klass, array, method, sources_name;
+  syx_string text;
+  FILE *sources;
+#ifdef HAVE_LIBGMP
+  SyxOop large;
+#endif
   syx_init (0, NULL, "..");
+  syx_build_basic ();
+
+#ifdef HAVE_LIBGMP
+  /* a large integer is saved in the format of GMP, and keeps its limbs outside of the object */
+  large = syx_large_integer_new_integer (-1234567);
+  mpz_pow_ui (SYX_OBJECT_LARGE_INTEGER (large), SYX_OBJECT_LARGE_INTEGER (large), 5);
+  syx_globals_at_put (syx_symbol_new ("TestLargeInteger"), large);
+#endif
 
   puts ("- Test saving image");
   start = syx_nanotime ();
-  syx_build_basic ();
   saved = syx_memory_save_image ("test.sim");
   assert (saved == TRUE);
   end = syx_nanotime ();
-  printf ("Time elapsed: %ld nanoseconds\n\n", end - start);
+  _print_throughput ("test.sim", end - start);
 
   puts ("- Test loading image");
   start = syx_nanotime ();
   loaded = syx_memory_load_image ("test.sim");
   assert (loaded == TRUE);
   end = syx_nanotime ();
-  printf ("Time elapsed: %ld nanoseconds\n\n", end - start);
+  _print_throughput ("test.sim", end - start);
+#ifdef HAVE_LIBGMP
+  _check_large_integer ();
+#endif
+
+  puts ("- Test saving mapped image");
+  syx_memory_set_image_format (SYX_MEMORY_IMAGE_MAPPED);
+  start = syx_nanotime ();
+  saved = syx_memory_save_image ("test-mapped.sim");
+  assert (saved == TRUE);
+  end = syx_nanotime ();
+  syx_memory_set_image_format (SYX_MEMORY_IMAGE_PORTABLE);
+  _print_throughput ("test-mapped.sim", end - start);
+
+  puts ("- Test loading mapped image");
+  start = syx_nanotime ();
+  loaded = syx_memory_load_image ("test-mapped.sim");
+  assert (loaded == TRUE);
+  end = syx_nanotime ();
+  _print_throughput ("test-mapped.sim", end - start);
+
+  klass = syx_globals_at ("Object");
+  assert (SYX_OOP_EQ (syx_object_get_class (syx_object_get_class (klass)), syx_metaclass_class));
+  assert (!strcmp (SYX_OBJECT_SYMBOL (SYX_CLASS_NAME (klass)), "Object"));
+#ifdef HAVE_LIBGMP
+  _check_large_integer ();
+#endif
+
+  puts ("- Test saving image in background");
+  start = syx_nanotime ();
+  fd = syx_memory_save_image_background ("test-background.sim");
+  end = syx_nanotime ();
+  /* the interpreter is stopped only for the fork */
+  printf ("Time elapsed: %lu nanoseconds\n\n", (unsigned long) (end - start));
+  if (fd >= 0)
+    {
+      /* changes made while the child writes the image are left to the next delta */
+      array = syx_array_new_size (1);
+      SYX_OBJECT_DATA(array)[0] = syx_small_integer_new (7);
+      syx_globals_at_put (syx_symbol_new ("TestBackground"), array);
+      assert (syx_memory_wait_image_background () == TRUE);
+      saved = syx_memory_save_image_delta ("test-background.sim");
+      assert (saved == TRUE);
+      loaded = syx_memory_load_image ("test-background.sim");
+      assert (loaded == TRUE);
+      klass = syx_globals_at ("Object");
+      assert (!strcmp (SYX_OBJECT_SYMBOL (SYX_CLASS_NAME (klass)), "Object"));
+      array = syx_globals_at ("TestBackground");
+      assert (SYX_SMALL_INTEGER (SYX_OBJECT_DATA(array)[0]) == 7);
+    }
+
+  puts ("- Test saving image delta");
+  saved = syx_memory_save_image ("test-delta.sim");
+  assert (saved == TRUE);
+  /* only the changed objects are appended to the image */
+  array = syx_array_new_size (2);
+  SYX_OBJECT_DATA(array)[0] = syx_small_integer_new (42);
+  SYX_OBJECT_DATA(array)[1] = syx_symbol_new ("delta");
+  syx_globals_at_put (syx_symbol_new ("TestDelta"), array);
+  saved = syx_memory_save_image_delta ("test-delta.sim");
+  assert (saved == TRUE);
+  loaded = syx_memory_load_image ("test-delta.sim");
+  assert (loaded == TRUE);
+  array = syx_globals_at ("TestDelta");
+  assert (SYX_SMALL_INTEGER (SYX_OBJECT_DATA(array)[0]) == 42);
+  assert (!strcmp (SYX_OBJECT_SYMBOL (SYX_OBJECT_DATA(array)[1]), "delta"));
+
+  puts ("- Test externalizing sources");
+  method = syx_class_lookup_method (syx_globals_at ("Object"), "printNl");
+  text = syx_strdup (SYX_OBJECT_SYMBOL (SYX_CODE_TEXT (method)));
+  remove ("test.sources");
+
+  /* writes to /dev/full fail, the code keeps its source then */
+  sources = fopen ("/dev/full", "ab");
+  if (sources)
+    {
+      fclose (sources);
+      sources_name = syx_globals_at_if_absent ("SourcesFileName", syx_nil);
+      assert (syx_memory_externalize_sources ("/dev/full") == FALSE);
+      assert (!strcmp (SYX_OBJECT_SYMBOL (SYX_CODE_TEXT (method)), text));
+      assert (SYX_OOP_EQ (syx_globals_at_if_absent ("SourcesFileName", syx_nil), sources_name));
+    }
+
+  assert (syx_memory_externalize_sources ("test.sources") == TRUE);
+  assert (SYX_IS_SMALL_INTEGER (SYX_CODE_TEXT (method)));
+  saved = syx_memory_save_image ("test-delta.sim");
+  assert (saved == TRUE);
+  loaded = syx_memory_load_image ("test-delta.sim");
+  assert (loaded == TRUE);
+  method = syx_class_lookup_method (syx_globals_at ("Object"), "printNl");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (syx_code_get_text (method)), text));
+  syx_free (text);
 
   syx_quit ();
 
@@ -45,7 +45,7 @@ main (int argc, char *argv[])
 
 #ifdef HAVE_LIBGMP
   obj = syx_large_integer_new_integer (0xFFFFFFFF);
-  assert (mpz_cmp_si (SYX_OBJECT_LARGE_INTEGER(obj), 0xFFFFFFFF));
+  assert (mpz_cmp_si (SYX_OBJECT_LARGE_INTEGER(obj), 0xFFFFFFFF) == 0);
 #endif
 
   obj = syx_character_new ('c');
@@ -64,6 +64,10 @@ main (int argc, char *argv[])
   SyxOop ret_obj;
   SyxLexer *lexer;
   syx_bool ok;
+  syx_uint32 calls;
+  SyxObject *object;
+  syx_varsize i;
+  syx_int32 sites;
 
   syx_init (0, NULL, "..");
   syx_memory_load_image ("test.sim");
@@ -84,6 +88,13 @@ main (int argc, char *argv[])
   /* 30 bits + 30 bits */
   ret_obj = _interpret ("method ^2r1111111111111111111111111111111 + 2r1111111111111111111111111111111 = 4294967294");
   assert (SYX_IS_TRUE (ret_obj));
+  /* SmallIntegers hold 63 bits on 64-bit hosts */
+  ret_obj = _interpret ("method ^(1073741823 + 1) class == SmallInteger");
+  assert (SYX_IS_TRUE (ret_obj) == (sizeof (SyxOop) > 4));
+  ret_obj = _interpret ("method ^(4611686018427387903 + 1) class == LargeInteger");
+  assert (SYX_IS_TRUE (ret_obj));
+  ret_obj = _interpret ("method ^(16r7FFFFFFF * 16r7FFFFFFF) printString");
+  assert (!strcmp (SYX_OBJECT_STRING (ret_obj), "4611686014132420609"));
 #endif  
 
   puts ("- Test class variables");
@@ -99,6 +110,73 @@ main (int argc, char *argv[])
   ret_obj = _interpret ("method TestClass initialize. ^TestClass testVar + TestClass new testVar");
   assert (SYX_SMALL_INTEGER(ret_obj) == 123 + 123);
 
+  puts ("- Test inline caches after redefining methods");
+  lexer = syx_lexer_new ("Object subclass: #TestCache instanceVariableNames: '' classVariableNames: ''!"
+			 "TestCache subclass: #TestCacheOverride instanceVariableNames: '' classVariableNames: ''!"
+			 "!TestCache methodsFor: 'testing'!"
+			 "cached ^1 ! !");
+  ok = syx_cold_parse (lexer);
+  assert (ok == TRUE);
+  syx_lexer_free (lexer, FALSE);
+
+  ret_obj = _interpret ("method | r | r := OrderedCollection new. "
+			"1 to: 2 do: [ :i | r add: TestCache new cached. TestCache compile: 'cached ^2' ]. "
+			"^(r at: 1) * 10 + (r at: 2)");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 12);
+
+  ret_obj = _interpret ("method | r | r := OrderedCollection new. "
+			"1 to: 2 do: [ :i | r add: TestCacheOverride new cached. TestCacheOverride compile: 'cached ^3' ]. "
+			"^(r at: 1) * 10 + (r at: 2)");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 23);
+
+  /* invalidation must not leave replaced methods referenced by send sites */
+  syx_method_cache_invalidate ();
+  for (sites=0, object=syx_memory; object < syx_memory + _syx_memory_size; object++)
+    {
+      if (SYX_OBJECT_CLASS (object) == syx_variable_binding_class
+          && object->data_size == SYX_INLINE_CACHE_SIZE)
+        {
+          for (i=0; i < SYX_INLINE_CACHE_SIZE; i++)
+            assert (SYX_IS_NIL (object->data[i]));
+          sites++;
+        }
+    }
+  assert (sites > 0);
+
+  /* More receiver classes than the entries of a send site */
+  puts ("- Test megamorphic send sites");
+  lexer = syx_lexer_new ("Object subclass: #TestMegamorphic instanceVariableNames: '' classVariableNames: ''!"
+			 "TestMegamorphic subclass: #TestMegamorphic1 instanceVariableNames: '' classVariableNames: ''!"
+			 "TestMegamorphic subclass: #TestMegamorphic2 instanceVariableNames: '' classVariableNames: ''!"
+			 "TestMegamorphic subclass: #TestMegamorphic3 instanceVariableNames: '' classVariableNames: ''!");
+  ok = syx_cold_parse (lexer);
+  assert (ok == TRUE);
+  syx_lexer_free (lexer, FALSE);
+
+  lexer = syx_lexer_new ("TestMegamorphic subclass: #TestMegamorphic4 instanceVariableNames: '' classVariableNames: ''!"
+			 "TestMegamorphic subclass: #TestMegamorphic5 instanceVariableNames: '' classVariableNames: ''!"
+			 "TestMegamorphic subclass: #TestMegamorphic6 instanceVariableNames: '' classVariableNames: ''!");
+  ok = syx_cold_parse (lexer);
+  assert (ok == TRUE);
+  syx_lexer_free (lexer, FALSE);
+
+  lexer = syx_lexer_new ("!TestMegamorphic1 methodsFor: 'testing'! cached ^1 ! !"
+			 "!TestMegamorphic2 methodsFor: 'testing'! cached ^2 ! !"
+			 "!TestMegamorphic3 methodsFor: 'testing'! cached ^3 ! !"
+			 "!TestMegamorphic4 methodsFor: 'testing'! cached ^4 ! !"
+			 "!TestMegamorphic5 methodsFor: 'testing'! cached ^5 ! !"
+			 "!TestMegamorphic6 methodsFor: 'testing'! cached ^6 ! !");
+  ok = syx_cold_parse (lexer);
+  assert (ok == TRUE);
+  syx_lexer_free (lexer, FALSE);
+
+  ret_obj = _interpret ("method | sum | sum := 0. "
+			"1 to: 2 do: [ :i | "
+			"  TestMegamorphic subclasses do: [ :class | sum := sum + class new cached ]. "
+			"  TestMegamorphic6 compile: 'cached ^10' ]. "
+			"^sum");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 21 + 25);
+
   puts ("- Test evaluating a simple block");
   ret_obj = _interpret ("method ^[321] value");
   assert (SYX_SMALL_INTEGER(ret_obj) == 321);
@@ -132,6 +210,26 @@ main (int argc, char *argv[])
 			"] value: b");
   assert (SYX_SMALL_INTEGER(ret_obj) == 126);
 
+  puts ("- Test outer variables from nested blocks");
+  ret_obj = _interpret ("method | a | a := 5. ^[ :x | | t | t := a."
+                        "true ifTrue: [ | u | u := 7. t := [ :y | t + u + y + a ] value: x ]. t ] value: 1");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 5 + 7 + 1 + 5);
+
+  puts ("- Test clean blocks");
+  ret_obj = _interpret ("method | b c | #(1 2) do: [ :i | c := b. b := [ :x | [ :y | x * y ] ] ]."
+                        "^b == c and: [ ((b value: 6) value: 7) = 42 ]");
+  assert (SYX_IS_TRUE (ret_obj));
+
+  /* clean blocks have no receiver, their class is taken from the method */
+  lexer = syx_lexer_new ("!TestClass methodsFor: 'testing'!"
+			 "callerContext ^thisContext parent !"
+			 "cleanBlockTraceback ^[ TestClass new callerContext tracebackString ] value ! !");
+  ok = syx_cold_parse (lexer);
+  assert (ok == TRUE);
+  syx_lexer_free (lexer, FALSE);
+  ret_obj = _interpret ("method ^TestClass new cleanBlockTraceback");
+  assert (!strcmp (SYX_OBJECT_STRING (ret_obj), "TestClass>>#cleanBlockTraceback[]"));
+
   puts ("- Recursive blocks");
   ret_obj = _interpret ("method | b i | i := 0. b := [ :b | (i := i + 1) = 10 ifFalse: [ b value: b ] ]."
 			"b value: b. ^i");
@@ -189,6 +287,62 @@ main (int argc, char *argv[])
   ret_obj = _interpret ("method | var | 1 to: 1000 do: [ :i | var := i. 'test' print ]. ^var");
   assert (SYX_SMALL_INTEGER(ret_obj) == 1000);
 
+  puts ("- Test quick methods");
+  calls = _syx_interp_quick_method_calls;
+  ret_obj = _interpret ("method | a | a := Association key: 3 value: 4. a value: a key. ^a value");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 3);
+  assert (_syx_interp_quick_method_calls - calls >= 3);
+
+  puts ("- Test inlined control messages");
+  ret_obj = _interpret ("method | sum | sum := 0. 3 timesRepeat: [ 1 to: 4 do: [ :i |"
+                        "(i > 1 and: [ i odd or: [ nil ifNil: [ false ] ] ]) ifTrue: [ sum := sum + i ] ] ]."
+                        "^(nil ifNotNil: [ 0 ] ifNil: [ sum ])");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 9);
+
+  /* blocks with other arguments are sent with the real messages */
+  ret_obj = _interpret ("method ^1 to: 3 do: [ 3 ]");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 1);
+  ret_obj = _interpret ("method ^3 ifNotNil: [ :v | 4 ]");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 4);
+  ret_obj = _interpret ("method ^(nil perform: #ifNil:ifNotNil: with: [ 1 ] with: [ 2 ]) * 10 "
+                        "+ (3 perform: #ifNotNil:ifNil: with: [ 4 ] with: [ 5 ])");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 14);
+
+  puts ("- Test closures capturing the argument of to:do:");
+  ret_obj = _interpret ("method | b | b := OrderedCollection new. 1 to: 3 do: [ :i | b add: [ i ] ]."
+                        "^(b at: 1) value * 100 + ((b at: 2) value * 10) + (b at: 3) value");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 123);
+
+  puts ("- Test keywords following an inlined block");
+  ret_obj = _interpret ("method ^[ nil ifNil: [ 1 ] foo: 2 ] on: MessageNotUnderstood do: [ :ex | ex message ]");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (ret_obj), "ifNil:foo:"));
+
+  puts ("- Test and: and or: sent to non-Boolean receivers");
+  ret_obj = _interpret ("method ^[ 3 and: [ 4 ] ] on: MessageNotUnderstood do: [ :ex | ex message ]");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (ret_obj), "and:"));
+  ret_obj = _interpret ("method ^[ 3 or: [ 4 ] ] on: MessageNotUnderstood do: [ :ex | ex message ]");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (ret_obj), "or:"));
+
+  puts ("- Test to:do: and timesRepeat: sent to non-SmallInteger receivers");
+  ret_obj = _interpret ("method | n | n := 0. "
+                        "^[ 2.5 timesRepeat: [ n := n + 1 ]. n ] on: MessageNotUnderstood do: [ :ex | ex message ]");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (ret_obj), "timesRepeat:"));
+  ret_obj = _interpret ("method | n | n := 0. "
+                        "^[ $a to: $c do: [ :c | n := n + 1 ]. n ] on: MessageNotUnderstood do: [ :ex | ex message ]");
+  assert (!strcmp (SYX_OBJECT_SYMBOL (ret_obj), "to:do:"));
+  ret_obj = _interpret ("method | sum | sum := 0. 1 to: 3.5 do: [ :i | sum := sum + i ]. "
+                        "1.5 to: 3 do: [ :i | sum := sum + (i * 2) ]. ^sum = 14");
+  assert (ret_obj == syx_true);
+
+  puts ("- Loop with arithmetic, comparison and bitwise sends");
+  ret_obj = _interpret ("method | i sum | i := 0. sum := 0."
+                        "[ i < 3000 ] whileTrue: ["
+                        "  sum := sum + (i bitAnd: 7)."
+                        "  (i \\\\ 3) = 0 ifTrue: [ sum := sum - 1 ]."
+                        "  i := i + 1 ]."
+                        "^sum");
+  assert (SYX_SMALL_INTEGER(ret_obj) == 3000 / 8 * 28 - 1000);
+
   syx_quit ();
 
   return 0;